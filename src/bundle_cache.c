@@ -0,0 +1,75 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Bundle Cache Records (bundle_cache.c)
+ *
+ * The record is a short text file, so a stale or damaged one simply fails
+ * to parse and the bundle is rebuilt.
+ */
+
+#include "bundle_cache.h"
+#include "content_hash.h"
+#include "util.h"
+
+#include <string.h>
+
+uint64_t bundle_cache_key(const BundleKeyInputs* inputs) {
+    ContentHash hash;
+    content_hash_init(&hash);
+    content_hash_update(&hash, &inputs->sf2_hash, sizeof(inputs->sf2_hash));
+    content_hash_update(&hash, &inputs->inputs_hash, sizeof(inputs->inputs_hash));
+    content_hash_update(&hash, &inputs->binary_hash, sizeof(inputs->binary_hash));
+    content_hash_update(&hash, &inputs->layout, sizeof(inputs->layout));
+    content_hash_update(&hash, &inputs->bank, sizeof(inputs->bank));
+    content_hash_update(&hash, &inputs->lazy_samples, sizeof(inputs->lazy_samples));
+    content_hash_update(&hash, &inputs->watch_soundfont, sizeof(inputs->watch_soundfont));
+    if (inputs->watch_soundfont && inputs->watch_source) {
+        // The configuration names the source file to watch
+        content_hash_update(&hash, inputs->watch_source, strlen(inputs->watch_source) + 1);
+    }
+    content_hash_update(&hash, &inputs->deadline, sizeof(inputs->deadline));
+    if (inputs->recordings_dir) {
+        content_hash_update(&hash, inputs->recordings_dir, strlen(inputs->recordings_dir) + 1);
+    }
+    if (inputs->preset_filter) {
+        content_hash_update(&hash, inputs->preset_filter, strlen(inputs->preset_filter) + 1);
+    }
+    content_hash_update(&hash, &inputs->reduce, sizeof(inputs->reduce));
+    content_hash_update(&hash, &inputs->profile, sizeof(inputs->profile));
+    if (inputs->profile) {
+        content_hash_update(&hash, &inputs->profile_scale, sizeof(inputs->profile_scale));
+    }
+    content_hash_update(&hash, inputs->plugin_name, strlen(inputs->plugin_name));
+    return content_hash_final(&hash);
+}
+
+void cache_record_read(const char* path, CacheRecord* record) {
+    memset(record, 0, sizeof(*record));
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return;
+    }
+
+    unsigned long long key, sf2_hash;
+    if (fscanf(f, " key %llx sf2 %llx %lld %lld %ld presets %d",
+               &key, &sf2_hash, &record->sf2_size, &record->sf2_mtime_s,
+               &record->sf2_mtime_ns, &record->preset_count) == 6) {
+        record->key = key;
+        record->sf2_hash = sf2_hash;
+        record->valid = 1;
+    }
+    fclose(f);
+}
+
+int cache_record_write(const char* path, const CacheRecord* record, FILE* log) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        log_errno(log, "Failed to write cache record", NULL);
+        return -1;
+    }
+    fprintf(f, "key %016llx\nsf2 %016llx %lld %lld %ld\npresets %d\n",
+            (unsigned long long)record->key, (unsigned long long)record->sf2_hash,
+            record->sf2_size, record->sf2_mtime_s, record->sf2_mtime_ns,
+            record->preset_count);
+    return fclose(f) == 0 ? 0 : -1;
+}
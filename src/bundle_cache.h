@@ -0,0 +1,61 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Bundle Cache Records (bundle_cache.h)
+ *
+ * Every bundle keeps a small record of what it was built from: a key that
+ * hashes every input of the bundle, and the SoundFont's content hash with
+ * the size and modification time it was taken at, so an untouched file is
+ * not hashed again. A bundle whose key is unchanged is reused as it is.
+ */
+
+#ifndef BUNDLE_CACHE_H
+#define BUNDLE_CACHE_H
+
+#include "sf2_writer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Contents of a bundle's cache record */
+typedef struct {
+    int valid;              // Non-zero if a record was read
+    uint64_t key;           // Combined hash of every input of the bundle
+    uint64_t sf2_hash;      // Content hash of the SoundFont
+    long long sf2_size;     // SoundFont size when it was hashed
+    long long sf2_mtime_s;  // SoundFont modification time (seconds)
+    long sf2_mtime_ns;      // SoundFont modification time (nanoseconds)
+    int preset_count;       // Number of presets in the bundle
+} CacheRecord;
+
+/* Everything a bundle is built from, as far as its cache key is concerned */
+typedef struct {
+    uint64_t sf2_hash;          // Content hash of the SoundFont
+    uint64_t inputs_hash;       // Hash of the generator/plugin sources and build flags
+    uint64_t binary_hash;       // Content hash of the plugin binary
+    int layout;                 // Where preset names are described
+    int bank;                   // Whether a sample bank is written
+    int lazy_samples;           // Whether plugins load samples lazily
+    int watch_soundfont;        // Whether plugins watch their SoundFont
+    const char* watch_source;   // Source file the configuration names for the watch (optional)
+    double deadline;            // Deadline fraction written to the configuration
+    const char* recordings_dir; // Directory for flight recordings (optional)
+    const char* preset_filter;  // Preset filter of the shipped SoundFont (optional)
+    SF2WriteOptions reduce;     // Sample data reductions of the shipped SoundFont
+    int profile;                // Whether presets are profiled
+    double profile_scale;       // Profile scale, only a key input when profiling
+    const char* plugin_name;    // Plugin name, which names the bundle's files
+} BundleKeyInputs;
+
+/*
+ * Combine the inputs of a bundle into its cache key. The watched source
+ * only counts when watching, and the profile scale only when profiling.
+ */
+uint64_t bundle_cache_key(const BundleKeyInputs* inputs);
+
+/* Read a cache record, leaving record->valid at 0 if there is none or it is malformed */
+void cache_record_read(const char* path, CacheRecord* record);
+
+/* Write a cache record. Returns 0 on success, -1 on failure */
+int cache_record_write(const char* path, const CacheRecord* record, FILE* log);
+
+#endif
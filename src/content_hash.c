@@ -0,0 +1,120 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Content Hashing (content_hash.c)
+ *
+ * The input is consumed in 64 bit little endian words. Each word is mixed
+ * with a multiply/rotate step before being folded into the state, and the
+ * final value goes through the splitmix64 finalizer.
+ */
+
+#include "content_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size of the read buffer used when hashing files
+#define HASH_READ_SIZE (1 << 20)
+
+#define HASH_SEED   0x9E3779B97F4A7C15ULL
+#define HASH_MUL_1  0xBF58476D1CE4E5B9ULL
+#define HASH_MUL_2  0x94D049BB133111EBULL
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/* Fold one 64 bit word into the state */
+static uint64_t mix_word(uint64_t state, uint64_t word) {
+    word *= HASH_MUL_1;
+    word = rotl64(word, 31);
+    word *= HASH_MUL_2;
+    state ^= word;
+    return rotl64(state, 27) * 5 + 0x52DCE729;
+}
+
+/* Load 8 bytes as a little endian word */
+static uint64_t load_le64(const uint8_t* p) {
+    uint64_t word = 0;
+    for (int i = 7; i >= 0; i--) {
+        word = (word << 8) | p[i];
+    }
+    return word;
+}
+
+void content_hash_init(ContentHash* hash) {
+    hash->state = HASH_SEED;
+    hash->length = 0;
+    hash->tail_len = 0;
+}
+
+void content_hash_update(ContentHash* hash, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    hash->length += size;
+
+    // Complete a partially filled word first
+    while (hash->tail_len > 0 && size > 0) {
+        hash->tail[hash->tail_len++] = *p++;
+        size--;
+        if (hash->tail_len == 8) {
+            hash->state = mix_word(hash->state, load_le64(hash->tail));
+            hash->tail_len = 0;
+        }
+    }
+
+    // Hash whole words directly from the input
+    while (size >= 8) {
+        hash->state = mix_word(hash->state, load_le64(p));
+        p += 8;
+        size -= 8;
+    }
+
+    // Keep the remainder for the next update
+    memcpy(hash->tail, p, size);
+    hash->tail_len += size;
+}
+
+uint64_t content_hash_final(ContentHash* hash) {
+    // Pad the last partial word with zeros; the length below disambiguates it
+    if (hash->tail_len > 0) {
+        memset(hash->tail + hash->tail_len, 0, 8 - hash->tail_len);
+        hash->state = mix_word(hash->state, load_le64(hash->tail));
+        hash->tail_len = 0;
+    }
+
+    // splitmix64 finalizer
+    uint64_t h = hash->state ^ hash->length;
+    h = (h ^ (h >> 30)) * HASH_MUL_1;
+    h = (h ^ (h >> 27)) * HASH_MUL_2;
+    return h ^ (h >> 31);
+}
+
+int content_hash_file(const char* path, uint64_t* hash_out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    uint8_t* buffer = (uint8_t*)malloc(HASH_READ_SIZE);
+    if (!buffer) {
+        fclose(f);
+        return -1;
+    }
+
+    ContentHash hash;
+    content_hash_init(&hash);
+    size_t bytes;
+    while ((bytes = fread(buffer, 1, HASH_READ_SIZE, f)) > 0) {
+        content_hash_update(&hash, buffer, bytes);
+    }
+
+    int failed = ferror(f);
+    free(buffer);
+    fclose(f);
+    if (failed) {
+        return -1;
+    }
+
+    *hash_out = content_hash_final(&hash);
+    return 0;
+}
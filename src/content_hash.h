@@ -0,0 +1,38 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Content Hashing (content_hash.h)
+ *
+ * A fast, streaming, non-cryptographic 64 bit hash used to detect whether
+ * the inputs of a bundle (SoundFont, sources, build flags) have changed.
+ */
+
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Incremental hash state */
+typedef struct {
+    uint64_t state;     // Running hash value
+    uint64_t length;    // Total number of bytes hashed
+    uint8_t tail[8];    // Bytes waiting for a full 64 bit word
+    size_t tail_len;    // Number of valid bytes in tail
+} ContentHash;
+
+/* Start a new hash */
+void content_hash_init(ContentHash* hash);
+
+/* Add a block of bytes to the hash */
+void content_hash_update(ContentHash* hash, const void* data, size_t size);
+
+/* Finish the hash and return its value */
+uint64_t content_hash_final(ContentHash* hash);
+
+/*
+ * Hash the full contents of a file.
+ * Returns 0 on success, -1 if the file cannot be read.
+ */
+int content_hash_file(const char* path, uint64_t* hash_out);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Content-Addressed File Store (content_store.c)
+ *
+ * Store objects are named <hash>-<size><ext> and are written to a temporary
+ * name first, then renamed, so concurrent batch jobs adding the same file
+ * never observe a partial object.
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "content_store.h"
+#include "util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+// Buffer size for the plain copy fallback
+#define COPY_BUFFER_SIZE (1 << 20)
+
+/* Copy with a read/write loop. Returns 0 on success */
+static int buffer_copy(int src, int dst) {
+    char* buffer = (char*)malloc(COPY_BUFFER_SIZE);
+    if (!buffer) {
+        return -1;
+    }
+
+    ssize_t bytes;
+    while ((bytes = read(src, buffer, COPY_BUFFER_SIZE)) > 0) {
+        char* p = buffer;
+        while (bytes > 0) {
+            ssize_t written = write(dst, p, bytes);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                free(buffer);
+                return -1;
+            }
+            p += written;
+            bytes -= written;
+        }
+    }
+
+    free(buffer);
+    return bytes < 0 ? -1 : 0;
+}
+
+/*
+ * Clone or copy src into dst (both open file descriptors).
+ * Reflink is tried first so copy-on-write filesystems share blocks, then
+ * copy_file_range() which stays in the kernel, then a plain copy.
+ */
+static int clone_or_copy(int src, int dst, StoreMethod* method) {
+#ifdef FICLONE
+    if (ioctl(dst, FICLONE, src) == 0) {
+        *method = STORE_REFLINK;
+        return 0;
+    }
+#endif
+
+    struct stat st;
+    if (fstat(src, &st) != 0) {
+        return -1;
+    }
+
+    // copy_file_range() may stop short; keep going until the whole file is copied
+    off_t remaining = st.st_size;
+    int kernel_copy = 1;
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(src, NULL, dst, NULL, (size_t)remaining, 0);
+        if (copied <= 0) {
+            kernel_copy = 0;
+            break;
+        }
+        remaining -= copied;
+    }
+    if (kernel_copy) {
+        *method = STORE_KERNEL_COPY;
+        return 0;
+    }
+
+    // Restart from the beginning with a plain copy
+    if (lseek(src, 0, SEEK_SET) < 0 || lseek(dst, 0, SEEK_SET) < 0 || ftruncate(dst, 0) != 0) {
+        return -1;
+    }
+    *method = STORE_BUFFER_COPY;
+    return buffer_copy(src, dst);
+}
+
+/* Clone or copy a file by path into a newly created destination */
+static int copy_path(const char* src_path, const char* dst_path, StoreMethod* method, FILE* log) {
+    int src = open(src_path, O_RDONLY);
+    if (src < 0) {
+        log_errno(log, "Failed to open", src_path);
+        return -1;
+    }
+
+    int dst = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst < 0) {
+        log_errno(log, "Failed to create", dst_path);
+        close(src);
+        return -1;
+    }
+
+    int result = clone_or_copy(src, dst, method);
+    if (result != 0) {
+        log_errno(log, "Failed to copy into", dst_path);
+    }
+    close(src);
+    if (close(dst) != 0 && result == 0) {
+        log_errno(log, "Failed to write", dst_path);
+        result = -1;
+    }
+    if (result != 0) {
+        unlink(dst_path);
+    }
+    return result;
+}
+
+int store_add(const char* store_dir, const char* src_path, uint64_t hash,
+              char* object_path, size_t object_path_size, FILE* log) {
+    struct stat st;
+    if (stat(src_path, &st) != 0) {
+        log_errno(log, "Failed to open", src_path);
+        return -1;
+    }
+
+    if (mkdir(store_dir, 0777) != 0 && errno != EEXIST) {
+        log_errno(log, "Failed to create store directory", store_dir);
+        return -1;
+    }
+
+    // Keep the extension so the object is still recognisable as a SoundFont
+    const char* ext = strrchr(src_path, '.');
+    if (!ext || strchr(ext, '/')) ext = "";
+    if (snprintf(object_path, object_path_size, "%s/%016llx-%lld%s", store_dir,
+                 (unsigned long long)hash, (long long)st.st_size, ext) >= (int)object_path_size) {
+        fprintf(log, "Store path too long for %s\n", src_path);
+        return -1;
+    }
+
+    // Already stored by an earlier run or another job
+    struct stat object_st;
+    if (stat(object_path, &object_st) == 0 && object_st.st_size == st.st_size) {
+        return 0;
+    }
+
+    // Write under a private temporary name, then publish it atomically
+    static unsigned long temp_counter = 0;
+    unsigned long temp_id = __atomic_fetch_add(&temp_counter, 1, __ATOMIC_RELAXED);
+    char temp_path[4096];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.tmp.%ld.%lu", object_path,
+                 (long)getpid(), temp_id) >= (int)sizeof(temp_path)) {
+        return -1;
+    }
+    StoreMethod method;
+    if (copy_path(src_path, temp_path, &method, log) != 0) {
+        return -1;
+    }
+
+    // Store objects are shared by many bundles and must not be edited in place
+    chmod(temp_path, 0444);
+    if (rename(temp_path, object_path) != 0) {
+        log_errno(log, "Failed to add to store", object_path);
+        unlink(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int store_place(const char* object_path, const char* dst_path, StoreMethod* method, FILE* log) {
+    // Replace whatever the bundle held before
+    if (unlink(dst_path) != 0 && errno != ENOENT) {
+        log_errno(log, "Failed to replace", dst_path);
+        return -1;
+    }
+
+    if (link(object_path, dst_path) == 0) {
+        *method = STORE_HARDLINK;
+        return 0;
+    }
+
+    // Cross-device or unsupported hardlink: fall back to a clone or copy
+    return copy_path(object_path, dst_path, method, log);
+}
+
+const char* store_method_name(StoreMethod method) {
+    switch (method) {
+        case STORE_HARDLINK: return "hardlink";
+        case STORE_REFLINK: return "reflink";
+        case STORE_KERNEL_COPY: return "copy_file_range";
+        case STORE_BUFFER_COPY: return "copy";
+    }
+    return "unknown";
+}
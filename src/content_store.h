@@ -0,0 +1,44 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Content-Addressed File Store (content_store.h)
+ *
+ * Bundles do not get their own copy of the SoundFont. Each distinct file is
+ * kept once in a store directory under a name derived from its content hash,
+ * and bundles reference it through a hardlink, a reflink clone or, as a last
+ * resort, a kernel-side copy. Identical SoundFonts therefore share disk blocks
+ * and page cache.
+ */
+
+#ifndef CONTENT_STORE_H
+#define CONTENT_STORE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* How a file was placed at its destination */
+typedef enum {
+    STORE_HARDLINK = 0,     // Hardlink to the store object (shared inode)
+    STORE_REFLINK,          // Copy-on-write clone (shared blocks)
+    STORE_KERNEL_COPY,      // copy_file_range() copy
+    STORE_BUFFER_COPY       // Plain read/write copy
+} StoreMethod;
+
+/*
+ * Ensure the store holds the file with the given content hash, adding it if
+ * needed. The object path is written to object_path.
+ * Returns 0 on success, -1 on failure.
+ */
+int store_add(const char* store_dir, const char* src_path, uint64_t hash,
+              char* object_path, size_t object_path_size, FILE* log);
+
+/*
+ * Place a store object at dst_path, replacing any existing file.
+ * Tries a hardlink, then a reflink clone, then copy_file_range(), then a
+ * buffered copy. Returns 0 on success and stores the method used.
+ */
+int store_place(const char* object_path, const char* dst_path, StoreMethod* method, FILE* log);
+
+/* Human readable name of a placement method */
+const char* store_method_name(StoreMethod method);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Flight Recorder (flight_recorder.c)
+ *
+ * This module:
+ * 1. Keeps the last FLIGHT_RING_SIZE cycle summaries of run() in a ring
+ * 2. Marks the window around the first cycle that misses its deadline
+ * 3. Copies the window out and writes it to a CSV file on its own thread
+ */
+
+#include "flight_recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Cycles the ring holds; a power of two, several times the window so the
+// thread has seconds to copy a window before run() overwrites it
+#define FLIGHT_RING_SIZE 1024
+
+// Cycles recorded before and after the one that missed its deadline
+#define FLIGHT_BEFORE 192
+#define FLIGHT_AFTER 32
+#define FLIGHT_WINDOW (FLIGHT_BEFORE + 1 + FLIGHT_AFTER)
+
+// Recordings written per instance, so a host that keeps overrunning does
+// not fill the disk
+#define FLIGHT_MAX_RECORDINGS 32
+
+struct FlightRecorder {
+    // Ring written by run()
+    FlightCycle ring[FLIGHT_RING_SIZE];
+    atomic_ullong head;             // Cycles recorded; the next one goes to head % size
+    int armed;                      // Whether run() is waiting for the cycles after a miss
+    uint64_t trigger;               // Cycle that missed its deadline, while armed
+    atomic_ullong pending;          // Trigger cycle + 1 of the window to write, 0 if none
+    sem_t wake;                     // Posted when a window is complete
+    atomic_int stop;                // Tells the thread to exit
+    pthread_t thread;               // Writer thread
+
+    // Used only by the thread
+    FlightCycle window[FLIGHT_WINDOW];  // Copy of the window being written
+    atomic_int recordings;              // Files written
+    char directory[4096];               // Where recordings go
+    char name[256];                     // Plugin name, used in file names
+};
+
+/* Write a copied window of count cycles, the trigger at index trigger */
+static void write_recording(FlightRecorder* recorder, int count, int trigger, uint64_t first_cycle) {
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    char path[4096 + 512];
+    snprintf(path, sizeof(path), "%s/%s-%d-%s-%d.csv", recorder->directory, recorder->name,
+             (int)getpid(), stamp, atomic_load(&recorder->recordings) + 1);
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write flight recording %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    const FlightCycle* missed = &recorder->window[trigger];
+    fprintf(file, "# SF2LV2 flight recording of %s\n", recorder->name);
+    fprintf(file, "# Cycle %llu took %.1f us of %.1f us allowed\n",
+            (unsigned long long)(first_cycle + trigger),
+            missed->phase_ns[RUN_PHASE_TOTAL] / 1000.0, missed->deadline_ns / 1000.0);
+    fprintf(file, "cycle,time_ms,sample_count,note_ons,note_offs,controllers,pitch_bends,others,"
+                  "program,program_changed,voices,controls_us,events_us,render_us,copy_us,total_us,missed\n");
+    for (int i = 0; i < count; i++) {
+        const FlightCycle* cycle = &recorder->window[i];
+        fprintf(file, "%llu,%.3f,%u,%u,%u,%u,%u,%u,%d,%u,%u",
+                (unsigned long long)(first_cycle + i),
+                (cycle->start_ns - missed->start_ns) / 1e6, cycle->sample_count,
+                cycle->note_ons, cycle->note_offs, cycle->controllers, cycle->pitch_bends,
+                cycle->others, cycle->program, cycle->program_changed, cycle->voices);
+        for (int phase = 0; phase < RUN_PHASES; phase++) {
+            fprintf(file, ",%.1f", cycle->phase_ns[phase] / 1000.0);
+        }
+        fprintf(file, ",%d\n", cycle->phase_ns[RUN_PHASE_TOTAL] > cycle->deadline_ns);
+    }
+    fclose(file);
+
+    atomic_fetch_add(&recorder->recordings, 1);
+    fprintf(stderr, "Flight recording written: %s\n", path);
+}
+
+/* Thread writing the windows run() marks */
+static void* flight_thread(void* data) {
+    FlightRecorder* recorder = (FlightRecorder*)data;
+    for (;;) {
+        if (sem_wait(&recorder->wake) != 0) {
+            continue;   // Interrupted by a signal
+        }
+        if (atomic_load(&recorder->stop)) {
+            break;
+        }
+        uint64_t pending = atomic_load_explicit(&recorder->pending, memory_order_acquire);
+        if (pending == 0) {
+            continue;
+        }
+        uint64_t trigger = pending - 1;
+        uint64_t first = trigger >= FLIGHT_BEFORE ? trigger - FLIGHT_BEFORE : 0;
+        int count = (int)(trigger + FLIGHT_AFTER + 1 - first);
+        for (int i = 0; i < count; i++) {
+            recorder->window[i] = recorder->ring[(first + i) % FLIGHT_RING_SIZE];
+        }
+
+        // The copy is only whole if run() has not come back round to the window
+        uint64_t head = atomic_load_explicit(&recorder->head, memory_order_acquire);
+        if (head - first < FLIGHT_RING_SIZE) {
+            write_recording(recorder, count, (int)(trigger - first), first);
+        } else {
+            fprintf(stderr, "Flight recording of %s overwritten before it was saved\n", recorder->name);
+        }
+
+        // Let run() mark the next window, unless enough have been written
+        if (atomic_load(&recorder->recordings) < FLIGHT_MAX_RECORDINGS) {
+            atomic_store_explicit(&recorder->pending, 0, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+FlightRecorder* flight_recorder_start(const char* directory, const char* name) {
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Flight recorder disabled, cannot create %s: %s\n", directory, strerror(errno));
+        return NULL;
+    }
+    FlightRecorder* recorder = (FlightRecorder*)calloc(1, sizeof(FlightRecorder));
+    if (!recorder) {
+        return NULL;
+    }
+    snprintf(recorder->directory, sizeof(recorder->directory), "%s", directory);
+    snprintf(recorder->name, sizeof(recorder->name), "%s", name);
+
+    if (sem_init(&recorder->wake, 0, 0) != 0) {
+        free(recorder);
+        return NULL;
+    }
+    if (pthread_create(&recorder->thread, NULL, flight_thread, recorder) != 0) {
+        fprintf(stderr, "Flight recorder disabled, cannot start thread\n");
+        sem_destroy(&recorder->wake);
+        free(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+void flight_recorder_stop(FlightRecorder* recorder) {
+    if (!recorder) {
+        return;
+    }
+    atomic_store(&recorder->stop, 1);
+    sem_post(&recorder->wake);
+    pthread_join(recorder->thread, NULL);
+    sem_destroy(&recorder->wake);
+    free(recorder);
+}
+
+void flight_recorder_record(FlightRecorder* recorder, const FlightCycle* cycle) {
+    uint64_t index = atomic_load_explicit(&recorder->head, memory_order_relaxed);
+    recorder->ring[index % FLIGHT_RING_SIZE] = *cycle;
+    atomic_store_explicit(&recorder->head, index + 1, memory_order_release);
+
+    // A miss arms a recording if the thread is not still busy with the last one
+    if (!recorder->armed && cycle->phase_ns[RUN_PHASE_TOTAL] > cycle->deadline_ns &&
+        atomic_load_explicit(&recorder->pending, memory_order_acquire) == 0) {
+        recorder->armed = 1;
+        recorder->trigger = index;
+    }
+    if (recorder->armed && index == recorder->trigger + FLIGHT_AFTER) {
+        recorder->armed = 0;
+        atomic_store_explicit(&recorder->pending, recorder->trigger + 1, memory_order_release);
+        sem_post(&recorder->wake);
+    }
+}
+
+int flight_recorder_count(FlightRecorder* recorder) {
+    return atomic_load(&recorder->recordings);
+}
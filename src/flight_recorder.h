@@ -0,0 +1,59 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Flight Recorder (flight_recorder.h)
+ *
+ * Keeps a summary of each of the last run() cycles in a preallocated ring:
+ * the block size, the events dispatched by type, program changes, active
+ * voices and the time of every phase. When a cycle misses its deadline, the
+ * cycles before it and a few after it are written by a separate thread to a
+ * CSV file, so a glitch on stage can be examined afterwards.
+ *
+ * Recording from run() is a copy into the ring and, once per recording, a
+ * sem_post(); it never blocks, allocates or touches the file system. The
+ * thread checks that run() did not overwrite the window while it was copied.
+ */
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdint.h>
+
+#include "run_timing.h"
+
+typedef struct FlightRecorder FlightRecorder;
+
+/* Summary of one run() cycle */
+typedef struct {
+    int64_t start_ns;               // Monotonic time the cycle started
+    int64_t phase_ns[RUN_PHASES];   // Time of each phase
+    int64_t deadline_ns;            // Time the cycle could take without a miss
+    uint32_t sample_count;          // Frames rendered
+    uint16_t note_ons;              // Note-on events
+    uint16_t note_offs;             // Note-off events, including note-ons of velocity 0
+    uint16_t controllers;           // Control change events
+    uint16_t pitch_bends;           // Pitch bend events
+    uint16_t others;                // Other MIDI events and patch messages
+    uint16_t voices;                // Voices active before rendering
+    int32_t program;                // Program selected at the end of the cycle
+    uint8_t program_changed;        // Whether the cycle selected another program
+} FlightCycle;
+
+/*
+ * Create the directory if needed and start the thread writing recordings
+ * into it; files are named after name. Returns NULL on failure.
+ */
+FlightRecorder* flight_recorder_start(const char* directory, const char* name);
+
+/* Stop the thread and free the recorder */
+void flight_recorder_stop(FlightRecorder* recorder);
+
+/*
+ * Record a cycle from run(). A cycle longer than its deadline starts a
+ * recording unless one is already being made.
+ */
+void flight_recorder_record(FlightRecorder* recorder, const FlightCycle* cycle);
+
+/* Recordings written so far; safe from any thread */
+int flight_recorder_count(FlightRecorder* recorder);
+
+#endif
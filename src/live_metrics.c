@@ -0,0 +1,213 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Live Metrics Segment (live_metrics.c)
+ *
+ * This module:
+ * 1. Creates this copy's shared memory segment exclusively with its first
+ *    instance, replacing segments of dead processes, and removes it with
+ *    the last
+ * 2. Hands out slots to plugin instances
+ * 3. Writes and reads slots with the seqlock protocol
+ */
+
+#include "live_metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Attempts a reader makes before giving up on a slot that keeps changing
+#define READ_ATTEMPTS 100
+
+// This copy's segment, shared by its plugin instances
+static pthread_mutex_t segment_lock = PTHREAD_MUTEX_INITIALIZER;
+static LiveMetricsSegment* segment = NULL;
+static int segment_users = 0;
+static char segment_path[64];
+
+uint64_t live_metrics_start_time(int pid) {
+    char path[64], stat[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+    size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[length] = '\0';
+
+    // The command name may hold spaces and parentheses; fields resume after the last ')'
+    char* field = strrchr(stat, ')');
+    if (!field) {
+        return 0;
+    }
+    // starttime is field 22; the state after the name is field 3
+    for (int i = 3; i <= 22 && field; i++) {
+        field = strchr(field + 1, ' ');
+    }
+    return field ? strtoull(field + 1, NULL, 10) : 0;
+}
+
+int live_metrics_owner_alive(const LiveMetricsSegment* checked) {
+    if (kill(checked->pid, 0) != 0 && errno != EPERM) {
+        return 0;
+    }
+    uint64_t start_time = live_metrics_start_time(checked->pid);
+    return start_time == 0 || start_time == checked->start_time;
+}
+
+/*
+ * Check whether the segment at name was left by a process that no longer
+ * runs. A segment still being created, or of another layout, is not.
+ */
+static int segment_stale(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return errno == ENOENT;     // Removed meanwhile: the name is free again
+    }
+    struct stat st;
+    int stale = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(LiveMetricsSegment)) {
+        const LiveMetricsSegment* existing = (const LiveMetricsSegment*)mmap(NULL, sizeof(LiveMetricsSegment),
+                                                                             PROT_READ, MAP_SHARED, fd, 0);
+        if (existing != MAP_FAILED) {
+            stale = existing->magic == LIVE_METRICS_MAGIC && existing->version == LIVE_METRICS_VERSION &&
+                    !live_metrics_owner_alive(existing);
+            munmap((void*)existing, sizeof(LiveMetricsSegment));
+        }
+    }
+    close(fd);
+    return stale;
+}
+
+/*
+ * Create and map a new segment for this copy of the plugin binary, under
+ * the first free name /sf2lv2-<pid>-<n>. A name taken by a segment of a
+ * dead process is freed and tried again; one taken by a live owner, such
+ * as another copy of the binary in this process, is left alone.
+ * Returns NULL on failure.
+ */
+static LiveMetricsSegment* create_segment(void) {
+    int fd = -1;
+    for (int n = 0; n < LIVE_METRICS_SEGMENTS && fd < 0; n++) {
+        snprintf(segment_path, sizeof(segment_path), "/" LIVE_METRICS_PREFIX "%d-%d", (int)getpid(), n);
+        fd = shm_open(segment_path, O_CREAT | O_EXCL | O_RDWR, 0644);
+        int error = errno;
+        if (fd < 0 && error == EEXIST && segment_stale(segment_path)) {
+            shm_unlink(segment_path);
+            fd = shm_open(segment_path, O_CREAT | O_EXCL | O_RDWR, 0644);
+            error = errno;
+        }
+        if (fd < 0 && error != EEXIST) {
+            perror("Live metrics disabled, cannot create shared memory");
+            return NULL;
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Live metrics disabled, all %d segment names are in use\n", LIVE_METRICS_SEGMENTS);
+        return NULL;
+    }
+
+    // A new segment is sized and zero filled here, and only ever by its creator
+    if (ftruncate(fd, sizeof(LiveMetricsSegment)) != 0) {
+        perror("Live metrics disabled, cannot size shared memory");
+        close(fd);
+        shm_unlink(segment_path);
+        return NULL;
+    }
+    LiveMetricsSegment* mapped = (LiveMetricsSegment*)mmap(NULL, sizeof(LiveMetricsSegment),
+                                                           PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        perror("Live metrics disabled, cannot map shared memory");
+        shm_unlink(segment_path);
+        return NULL;
+    }
+
+    mapped->version = LIVE_METRICS_VERSION;
+    mapped->pid = (int32_t)getpid();
+    mapped->start_time = live_metrics_start_time((int)getpid());
+    atomic_thread_fence(memory_order_release);
+    mapped->magic = LIVE_METRICS_MAGIC;
+    return mapped;
+}
+
+LiveMetricsSlot* live_metrics_claim(const char* name) {
+    pthread_mutex_lock(&segment_lock);
+    if (!segment) {
+        segment = create_segment();
+    }
+    LiveMetricsSlot* claimed = NULL;
+    for (int i = 0; segment && i < LIVE_METRICS_SLOTS && !claimed; i++) {
+        int unused = 0;
+        if (atomic_compare_exchange_strong(&segment->slots[i].in_use, &unused, 1)) {
+            claimed = &segment->slots[i];
+        }
+    }
+    if (claimed) {
+        segment_users++;
+        LiveMetrics values;
+        memset(&values, 0, sizeof(values));
+        values.program = -1;
+
+        unsigned seq = atomic_load_explicit(&claimed->seq, memory_order_relaxed);
+        atomic_store_explicit(&claimed->seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        snprintf(claimed->name, sizeof(claimed->name), "%s", name);
+        claimed->values = values;
+        atomic_store_explicit(&claimed->seq, seq + 2, memory_order_release);
+    } else if (segment) {
+        fprintf(stderr, "Live metrics disabled for %s, all %d slots are in use\n", name, LIVE_METRICS_SLOTS);
+    }
+    pthread_mutex_unlock(&segment_lock);
+    return claimed;
+}
+
+void live_metrics_release(LiveMetricsSlot* slot) {
+    if (!slot) {
+        return;
+    }
+    pthread_mutex_lock(&segment_lock);
+    atomic_store(&slot->in_use, 0);
+    if (--segment_users == 0) {
+        munmap(segment, sizeof(LiveMetricsSegment));
+        shm_unlink(segment_path);
+        segment = NULL;
+    }
+    pthread_mutex_unlock(&segment_lock);
+}
+
+void live_metrics_publish(LiveMetricsSlot* slot, const LiveMetrics* values) {
+    unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->values = *values;
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+int live_metrics_read(const LiveMetricsSlot* slot, char name[64], LiveMetrics* values) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        if (!atomic_load_explicit(&slot->in_use, memory_order_acquire)) {
+            return -1;
+        }
+        unsigned before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(name, slot->name, 64);
+        *values = slot->values;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == before) {
+            name[63] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
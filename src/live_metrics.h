@@ -0,0 +1,101 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Live Metrics Segment (live_metrics.h)
+ *
+ * Every copy of the plugin binary loaded in a process gets one POSIX shared
+ * memory segment, /sf2lv2-<pid>-<n>, with a slot per plugin instance; hosts
+ * that load several bundles' binaries hold several segments, numbered from
+ * 0. A segment is only ever created exclusively, so two copies never share
+ * or reset each other's. Its header records the owner's process ID and
+ * start time, so a segment left by a crashed process is recognised even if
+ * the ID was reused. run() publishes the instance's counters into its slot
+ * after every cycle, and sf2lv2_top reads the segments of all processes on
+ * the machine.
+ *
+ * A slot has a single writer, the instance's run(), which updates it like a
+ * seqlock: the sequence number is odd while the values change, and readers
+ * retry until they copy the values between two equal, even sequence
+ * numbers. Publishing never blocks; readers never slow down the writer.
+ */
+
+#ifndef LIVE_METRICS_H
+#define LIVE_METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Segment name prefix; the host's process ID and the segment number follow
+#define LIVE_METRICS_PREFIX "sf2lv2-"
+
+// Segments one process can hold
+#define LIVE_METRICS_SEGMENTS 16
+
+// Identifies a metrics segment and its layout version
+#define LIVE_METRICS_MAGIC 0x534632544F50u   // "SF2TOP"
+#define LIVE_METRICS_VERSION 2
+
+// Plugin instances one process can publish
+#define LIVE_METRICS_SLOTS 64
+
+/* Counters of one plugin instance */
+typedef struct {
+    uint64_t cycles;            // run() calls
+    uint64_t deadline_misses;   // run() calls over their deadline
+    int64_t memory;             // Bytes held, as on the Memory port
+    int64_t updated_ns;         // CLOCK_MONOTONIC time of the last run()
+    float load;                 // Smoothed DSP load, 1.0 = the whole block duration
+    uint32_t voices;            // Active voices
+    uint32_t peak_voices;       // Most active voices since activation
+    uint32_t full_polyphony_notes; // Note-ons that found every voice in use and ended one
+    int32_t program;            // Selected program, -1 before the first
+} LiveMetrics;
+
+/* One instance's slot */
+typedef struct {
+    atomic_uint seq;            // Odd while the slot is being written
+    atomic_int in_use;          // Whether an instance owns the slot
+    char name[64];              // Plugin name
+    LiveMetrics values;         // Latest counters
+} LiveMetricsSlot;
+
+/* A process's segment */
+typedef struct {
+    uint64_t magic;             // LIVE_METRICS_MAGIC
+    uint32_t version;           // LIVE_METRICS_VERSION
+    int32_t pid;                // Process the segment belongs to
+    uint64_t start_time;        // Its start time, in clock ticks after boot
+    LiveMetricsSlot slots[LIVE_METRICS_SLOTS];
+} LiveMetricsSegment;
+
+/*
+ * Start time of a process in clock ticks after boot, from /proc/<pid>/stat.
+ * Returns 0 if it cannot be read.
+ */
+uint64_t live_metrics_start_time(int pid);
+
+/*
+ * Check whether the process that created a segment still runs: its ID must
+ * exist and, if its start time can be read, match the recorded one.
+ */
+int live_metrics_owner_alive(const LiveMetricsSegment* segment);
+
+/*
+ * Claim a slot for a plugin instance, creating this copy's segment with
+ * the first one. Returns NULL if shared memory is unavailable or every slot
+ * is taken.
+ */
+LiveMetricsSlot* live_metrics_claim(const char* name);
+
+/* Give a slot back; the segment is removed with the last one */
+void live_metrics_release(LiveMetricsSlot* slot);
+
+/* Publish an instance's counters from run() */
+void live_metrics_publish(LiveMetricsSlot* slot, const LiveMetrics* values);
+
+/*
+ * Copy a slot's name and counters consistently, from any process.
+ * Returns 0 on success, -1 if the slot is unused or kept changing.
+ */
+int live_metrics_read(const LiveMetricsSlot* slot, char name[64], LiveMetrics* values);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Plugin State Encoding (plugin_state.c)
+ *
+ * Restored values come from whatever a host saved, possibly by another
+ * version of the plugin, so decoding clamps counts and skips what it
+ * cannot match instead of failing.
+ */
+
+#include "plugin_state.h"
+
+#include <string.h>
+
+int state_hot_programs(const uint32_t* counts, int program_count, int* out, int max) {
+    int count = 0;
+    for (int p = 0; p < program_count; p++) {
+        if (counts[p] == 0) {
+            continue;
+        }
+        // Insert into the sorted list, dropping the least played past max
+        int at = count < max ? count++ : max;
+        while (at > 0 && counts[out[at - 1]] < counts[p]) {
+            if (at < max) out[at] = out[at - 1];
+            at--;
+        }
+        if (at < max) out[at] = p;
+    }
+    return count;
+}
+
+void state_encode_counts(const uint32_t* counts, int count, int32_t* values) {
+    for (int i = 0; i < count; i++) {
+        values[i] = (int32_t)counts[i];
+    }
+}
+
+void state_decode_counts(const int32_t* values, int value_count, uint32_t* counts, int count) {
+    for (int i = 0; values && i < value_count && i < count; i++) {
+        counts[i] = values[i] > 0 ? (uint32_t)values[i] : 0;
+    }
+}
+
+int state_encode_presets(const BankProgram* programs, const uint32_t* counts,
+                         const int* hot, int hot_count, int32_t* values) {
+    for (int i = 0; i < hot_count; i++) {
+        values[i * 3] = programs[hot[i]].bank;
+        values[i * 3 + 1] = programs[hot[i]].prog;
+        values[i * 3 + 2] = (int32_t)counts[hot[i]];
+    }
+    return hot_count * 3;
+}
+
+int state_decode_presets(const int32_t* values, int value_count,
+                         const BankProgram* programs, int program_count,
+                         int* hot, uint32_t* hot_counts, int max) {
+    int count = 0;
+    for (int i = 0; values && i + 2 < value_count && count < max; i += 3) {
+        for (int p = 0; p < program_count; p++) {
+            if (programs[p].bank == values[i] && programs[p].prog == values[i + 1]) {
+                hot[count] = p;
+                hot_counts[count++] = values[i + 2] > 0 ? (uint32_t)values[i + 2] : 0;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+void state_encode_controllers(const int* values, uint8_t* chunk) {
+    for (int cc = 0; cc < STATE_CONTROLLERS; cc++) {
+        chunk[cc] = (uint8_t)(values[cc] & 0x7F);
+    }
+}
+
+int state_decode_controllers(const void* chunk, size_t size, uint8_t* controllers) {
+    if (!chunk || size != STATE_CONTROLLERS) {
+        return 0;
+    }
+    memcpy(controllers, chunk, STATE_CONTROLLERS);
+    return 1;
+}
+
+int state_controller_restorable(int cc) {
+    return cc != 0 && cc != 32 && cc != 6 && cc != 38 && !(cc >= 96 && cc <= 101) && cc < 120;
+}
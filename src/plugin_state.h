@@ -0,0 +1,81 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Plugin State Encoding (plugin_state.h)
+ *
+ * Converts what the plugin keeps in its LV2 state to and from the plain
+ * values stored there: usage counts as integer vectors, the most played
+ * presets as bank, program and count triples, and the controllers of
+ * channel 0 as one byte each. The plugin wraps these in atoms and checks
+ * the atom types; nothing here needs an LV2 host or FluidSynth.
+ */
+
+#ifndef PLUGIN_STATE_H
+#define PLUGIN_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes of the controller chunk: one per controller of channel 0
+#define STATE_CONTROLLERS 128
+
+/* Structure to store bank/program pairs for SoundFont presets.
+   Each preset in a SoundFont is identified by a bank and program number */
+typedef struct {
+    int bank;   // MIDI bank number (0-128)
+    int prog;   // MIDI program number (0-127)
+} BankProgram;
+
+/*
+ * Find the most played of program_count programs from their note-on
+ * counts, most played first; programs never played are left out.
+ * Returns the number of programs written to out (at most max).
+ */
+int state_hot_programs(const uint32_t* counts, int program_count, int* out, int max);
+
+/* Store count note-on counts as vector elements */
+void state_encode_counts(const uint32_t* counts, int count, int32_t* values);
+
+/*
+ * Take count note-on counts from value_count restored elements. Negative
+ * elements count as 0, elements past count are ignored and counts without
+ * an element, or all of them if values is NULL, are left unchanged.
+ */
+void state_decode_counts(const int32_t* values, int value_count, uint32_t* counts, int count);
+
+/*
+ * Store the hot programs as bank, program and count triples, so they still
+ * apply if the SoundFont's preset list changes.
+ * Returns the number of elements written to values (3 per program).
+ */
+int state_encode_presets(const BankProgram* programs, const uint32_t* counts,
+                         const int* hot, int hot_count, int32_t* values);
+
+/*
+ * Match restored triples against the program table by bank and program
+ * number. Each match writes its program index to hot and its count, at
+ * least 0, to hot_counts; triples without a match and an incomplete last
+ * triple are skipped.
+ * Returns the number of programs written (at most max).
+ */
+int state_decode_presets(const int32_t* values, int value_count,
+                         const BankProgram* programs, int program_count,
+                         int* hot, uint32_t* hot_counts, int max);
+
+/* Store the 7 bit values of the STATE_CONTROLLERS controllers */
+void state_encode_controllers(const int* values, uint8_t* chunk);
+
+/*
+ * Take the controller values from a restored chunk of size bytes.
+ * Returns 1 if the chunk has one byte per controller, 0 otherwise, in
+ * which case controllers is left unchanged.
+ */
+int state_decode_controllers(const void* chunk, size_t size, uint8_t* controllers);
+
+/*
+ * Check whether a controller value can be restored by sending it again.
+ * Bank select is part of the program, and data entry, RPN/NRPN selection
+ * and channel mode messages act when sent instead of holding a value.
+ */
+int state_controller_restorable(int cc);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Preset CPU Profiler (preset_profiler.c)
+ *
+ * This module:
+ * 1. Builds the stress pattern (stress_pattern.c) at the profiling rate
+ * 2. Loads the SoundFont into a synthesizer configured like the plugin's
+ * 3. Plays the pattern through every preset, timing each rendered block
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "preset_profiler.h"
+#include "stress_pattern.h"
+#include "synth_settings.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Play the pattern through the selected preset and time every block */
+static void profile_one(fluid_synth_t* synth, const StressPattern* pattern, double scale,
+                        float* left, float* right, PresetProfile* profile) {
+    const double deadline_ns = 1e9 * SYNTH_BLOCK_SIZE / PROFILE_RATE;
+    int64_t total_ns = 0;
+    int next = 0;
+
+    memset(profile, 0, sizeof(*profile));
+    for (uint32_t frame = 0; frame < pattern->length; frame += SYNTH_BLOCK_SIZE) {
+        // Events are sent at the start of the block they fall in, as run() does
+        for (; next < pattern->count && pattern->events[next].frame < frame + SYNTH_BLOCK_SIZE; next++) {
+            const StressEvent* event = &pattern->events[next];
+            if (event->status == STRESS_NOTE_ON) {
+                fluid_synth_noteon(synth, 0, event->data1, event->data2);
+            } else if (event->status == STRESS_NOTE_OFF) {
+                fluid_synth_noteoff(synth, 0, event->data1);
+            } else {
+                fluid_synth_cc(synth, 0, event->data1, event->data2);
+            }
+        }
+
+        int64_t start = now_ns();
+        fluid_synth_write_float(synth, SYNTH_BLOCK_SIZE, left, 0, 1, right, 0, 1);
+        double elapsed = (double)(now_ns() - start) * scale;
+
+        total_ns += (int64_t)elapsed;
+        if (elapsed > profile->worst_block_ns) profile->worst_block_ns = elapsed;
+        if (elapsed > deadline_ns) profile->late_blocks++;
+        int voices = fluid_synth_get_active_voice_count(synth);
+        if (voices > profile->peak_voices) profile->peak_voices = voices;
+        profile->blocks++;
+    }
+
+    profile->ns_per_sample = profile->blocks > 0
+        ? (double)total_ns / ((double)profile->blocks * SYNTH_BLOCK_SIZE) : 0.0;
+}
+
+int preset_profile(const char* sf2_path, const SF2Preset* presets, int preset_count,
+                   double scale, PresetProfile** profiles_out, FILE* log) {
+    *profiles_out = NULL;
+
+    StressPattern* pattern = (StressPattern*)malloc(sizeof(StressPattern));
+    PresetProfile* profiles = (PresetProfile*)calloc(preset_count > 0 ? preset_count : 1, sizeof(PresetProfile));
+    if (!pattern || !profiles) {
+        fprintf(log, "Failed to allocate preset profiles\n");
+        free(pattern);
+        free(profiles);
+        return -1;
+    }
+    stress_pattern_build(pattern, STRESS_ALL, PROFILE_RATE);
+
+    float left[SYNTH_BLOCK_SIZE], right[SYNTH_BLOCK_SIZE];
+    fluid_settings_t* settings = new_fluid_settings();
+    fluid_synth_t* synth = NULL;
+    if (settings) {
+        synth_configure(settings, PROFILE_RATE);
+        synth = new_fluid_synth(settings);
+    }
+    if (!synth || fluid_synth_sfload(synth, sf2_path, 1) == FLUID_FAILED) {
+        fprintf(log, "Failed to load SoundFont for profiling: %s\n", sf2_path);
+        if (synth) delete_fluid_synth(synth);
+        if (settings) delete_fluid_settings(settings);
+        free(pattern);
+        free(profiles);
+        return -1;
+    }
+
+    for (int i = 0; i < preset_count; i++) {
+        // Start every preset from silence with its CCs reset
+        fluid_synth_system_reset(synth);
+        if (synth_select_program(synth, presets[i].bank, presets[i].prog) != FLUID_OK) {
+            fprintf(log, "Failed to select preset %d:%d for profiling\n", presets[i].bank, presets[i].prog);
+            continue;
+        }
+        profile_one(synth, pattern, scale, left, right, &profiles[i]);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    free(pattern);
+    *profiles_out = profiles;
+    return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Preset CPU Profiler (preset_profiler.h)
+ *
+ * Renders a fixed stress pattern (chords, fast repeated notes and notes
+ * held by the sustain pedal) through each preset offline, with the FluidSynth
+ * settings the plugin uses, and measures what rendering costs. The results
+ * tell whether a preset keeps up with a SYNTH_BLOCK_SIZE frame deadline.
+ */
+
+#ifndef PRESET_PROFILER_H
+#define PRESET_PROFILER_H
+
+#include "sf2_parser.h"
+
+#include <stdio.h>
+
+// Sample rate the stress pattern is rendered at
+#define PROFILE_RATE 48000
+
+/* Measured cost of one preset */
+typedef struct {
+    double ns_per_sample;       // Mean render time per output frame
+    double worst_block_ns;      // Render time of the slowest block
+    int peak_voices;            // Most voices active after any block
+    int late_blocks;            // Blocks that took longer than the audio they produced
+    int blocks;                 // Blocks rendered
+} PresetProfile;
+
+/*
+ * Profile the given presets of a SoundFont, one after another on one thread.
+ * scale multiplies every measured time to estimate a slower target machine
+ * (1.0 reports this machine) before late blocks are counted.
+ * The returned array has one entry per preset and must be released with free().
+ * Returns 0 on success, -1 on failure.
+ */
+int preset_profile(const char* sf2_path, const SF2Preset* presets, int preset_count,
+                   double scale, PresetProfile** profiles_out, FILE* log);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Static Tracepoints (probes.h)
+ *
+ * USDT probes of the plugin runtime under the provider name sf2lv2, for
+ * perf and bpftrace. They are compiled in only with -DSF2LV2_USDT (make
+ * USDT=1), which needs <sys/sdt.h> from systemtap-sdt-dev. An unattached
+ * probe is a single nop instruction; its arguments are only described in
+ * an ELF note, so the probes survive rebuilds where symbol offsets do not.
+ *
+ * Probes and arguments:
+ *   instantiate_start(name)               instantiate_end(name, ok)
+ *   load_start(path)                      load_end(path, program_count or -1)
+ *   program_change(program, bank, prog)
+ *   midi_event(status, data1, data2)
+ *   run_start(sample_count)               run_end(sample_count)
+ *   render_start(frames)                  render_end(frames)
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#ifdef SF2LV2_USDT
+#include <sys/sdt.h>
+
+#define PROBE1(name, a) DTRACE_PROBE1(sf2lv2, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(sf2lv2, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(sf2lv2, name, a, b, c)
+#else
+#define PROBE1(name, a) do { } while (0)
+#define PROBE2(name, a, b) do { } while (0)
+#define PROBE3(name, a, b, c) do { } while (0)
+#endif
+
+#endif
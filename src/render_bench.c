@@ -0,0 +1,328 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Offline Render Benchmark (render_bench.c)
+ *
+ * A minimal LV2 host that loads one or more builds of the generic plugin
+ * binary for the same bundle, plays each stress pattern workload through
+ * them for a fixed amount of audio and reports the render time per sample.
+ * The first binary is the baseline; every other one is reported with its
+ * speedup over it. The makefile's pgo target also uses it as the training
+ * workload for profile-guided optimization.
+ *
+ * With -l it instead measures how long loading each binary takes: dlopen()
+ * with immediate binding, which resolves every relocation, and dlclose().
+ * With -m it only instantiates the plugin and reports how much the resident
+ * set grew, which is dominated by the sample data FluidSynth loads.
+ *
+ * Usage: render_bench [-s seconds] [-p program] <bundle> <plugin.so>...
+ *        render_bench -l <iterations> <plugin.so>...
+ *        render_bench -m <bundle> <plugin.so>...
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <lv2/core/lv2.h>
+#include <lv2/atom/atom.h>
+#include <lv2/midi/midi.h>
+#include <lv2/urid/urid.h>
+
+#include "stress_pattern.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Rendering setup of the benchmark host
+#define BENCH_RATE 48000
+#define HOST_BLOCK 256
+
+// Most binaries compared in one run
+#define MAX_BINARIES 8
+
+// Capacity of the MIDI input sequence for one host block
+#define SEQUENCE_CAPACITY 8192
+
+// Plugin port indices, matching synth_plugin.c
+enum {
+    PORT_EVENTS = 0, PORT_AUDIO_OUT_L, PORT_AUDIO_OUT_R, PORT_LEVEL, PORT_PROGRAM,
+    PORT_CUTOFF, PORT_RESONANCE, PORT_ATTACK, PORT_DECAY, PORT_SUSTAIN, PORT_RELEASE,
+    PORT_REPORT, PORT_MEMORY, PORT_LOAD, PORT_VOICES, PORT_PEAK_VOICES, PORT_FULL_POLYPHONY_NOTES,
+    PORT_COUNT
+};
+
+/* URIs mapped for the plugin, in URID order starting at 1 */
+static char* mapped_uris[64];
+static int mapped_count = 0;
+
+static LV2_URID map_uri(LV2_URID_Map_Handle handle, const char* uri) {
+    (void)handle;
+    for (int i = 0; i < mapped_count; i++) {
+        if (!strcmp(mapped_uris[i], uri)) {
+            return (LV2_URID)(i + 1);
+        }
+    }
+    if (mapped_count == (int)(sizeof(mapped_uris) / sizeof(mapped_uris[0]))) {
+        return 0;
+    }
+    mapped_uris[mapped_count] = strdup(uri);
+    return mapped_uris[mapped_count] ? (LV2_URID)++mapped_count : 0;
+}
+
+/* Resident set size of this process in KB, -1 if unknown */
+static long resident_kb(void) {
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) {
+        return -1;
+    }
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), status)) {
+        if (sscanf(line, "VmRSS: %ld", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Append a three byte MIDI event to a sequence */
+static void sequence_append(LV2_Atom_Sequence* sequence, uint32_t frame, LV2_URID midi_event,
+                            const StressEvent* event) {
+    uint32_t needed = (uint32_t)sizeof(LV2_Atom_Event) + lv2_atom_pad_size(3);
+    if (sizeof(LV2_Atom) + sequence->atom.size + needed > SEQUENCE_CAPACITY) {
+        return;
+    }
+    LV2_Atom_Event* out = (LV2_Atom_Event*)((uint8_t*)&sequence->body + sequence->atom.size);
+    out->time.frames = frame;
+    out->body.size = 3;
+    out->body.type = midi_event;
+    uint8_t* msg = (uint8_t*)(out + 1);
+    msg[0] = event->status;
+    msg[1] = event->data1;
+    msg[2] = event->data2;
+    sequence->atom.size += needed;
+}
+
+/*
+ * Render at least seconds of audio of one workload, repeating the pattern,
+ * and return the mean time run() took per sample in nanoseconds (-1 on failure).
+ */
+static double bench_workload(const LV2_Descriptor* descriptor, LV2_Handle instance,
+                             const StressPattern* pattern, double seconds,
+                             LV2_Atom_Sequence* sequence, LV2_URID sequence_type, LV2_URID midi_event) {
+    if (pattern->length == 0) {
+        return -1.0;
+    }
+    uint64_t total_frames = (uint64_t)(seconds * BENCH_RATE);
+    uint64_t rendered = 0;
+    int64_t elapsed = 0;
+
+    descriptor->activate(instance);
+    while (rendered < total_frames) {
+        int next = 0;
+        for (uint32_t frame = 0; frame < pattern->length; frame += HOST_BLOCK) {
+            uint32_t count = pattern->length - frame < HOST_BLOCK ? pattern->length - frame : HOST_BLOCK;
+
+            sequence->atom.type = sequence_type;
+            sequence->atom.size = sizeof(LV2_Atom_Sequence_Body);
+            sequence->body.unit = 0;
+            sequence->body.pad = 0;
+            for (; next < pattern->count && pattern->events[next].frame < frame + count; next++) {
+                sequence_append(sequence, pattern->events[next].frame - frame, midi_event, &pattern->events[next]);
+            }
+
+            int64_t start = now_ns();
+            descriptor->run(instance, count);
+            elapsed += now_ns() - start;
+            rendered += count;
+        }
+    }
+    descriptor->deactivate(instance);
+
+    return (double)elapsed / (double)rendered;
+}
+
+/*
+ * Load and unload each binary iterations times and print the mean time of
+ * dlopen(RTLD_NOW) plus dlclose(). A binary must export lv2_lib_descriptor
+ * or, like dedicated builds and older binaries, lv2_descriptor.
+ * Returns 0 on success, 1 on failure.
+ */
+static int bench_load(char** paths, int count, int iterations) {
+    printf("%-10s  %12s  %s\n", "binary", "load (us)", "path");
+    for (int b = 0; b < count; b++) {
+        int64_t elapsed = 0;
+        for (int i = 0; i < iterations; i++) {
+            int64_t start = now_ns();
+            void* library = dlopen(paths[b], RTLD_NOW | RTLD_LOCAL);
+            if (!library || (!dlsym(library, "lv2_lib_descriptor") && !dlsym(library, "lv2_descriptor"))) {
+                fprintf(stderr, "Failed to load %s: %s\n", paths[b], dlerror());
+                if (library) dlclose(library);
+                return 1;
+            }
+            dlclose(library);
+            elapsed += now_ns() - start;
+        }
+        printf("%-10d  %12.1f  %s\n", b + 1, (double)elapsed / iterations / 1000.0, paths[b]);
+    }
+    return 0;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [-s seconds] [-p program] <bundle> <plugin.so>...\n"
+            "       %s -l <iterations> <plugin.so>...\n"
+            "       %s -m <bundle> <plugin.so>...\n"
+            "  -s <seconds>     Audio rendered per workload and binary (default: 10)\n"
+            "  -p <program>     Program port value to play (default: 0)\n"
+            "  -l <iterations>  Only time loading and unloading each binary\n"
+            "  -m               Only report the memory an instance takes\n"
+            "The first binary is the baseline the others are compared with.\n",
+            program, program, program);
+}
+
+int main(int argc, char** argv) {
+    double seconds = 10.0;
+    float program = 0.0f;
+    int load_iterations = 0;
+    int memory_only = 0;
+
+    int first = 1;
+    while (first < argc && argv[first][0] == '-') {
+        if (!strcmp(argv[first], "-s") && first + 1 < argc) {
+            seconds = atof(argv[++first]);
+        } else if (!strcmp(argv[first], "-p") && first + 1 < argc) {
+            program = (float)atoi(argv[++first]);
+        } else if (!strcmp(argv[first], "-l") && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            load_iterations = atoi(argv[++first]);
+        } else if (!strcmp(argv[first], "-m")) {
+            memory_only = 1;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+        first++;
+    }
+    if (load_iterations > 0) {
+        if (first >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return bench_load(argv + first, argc - first, load_iterations);
+    }
+
+    int binary_count = argc - first - 1;
+    if (binary_count < 1 || binary_count > MAX_BINARIES || seconds <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // The plugin expects the bundle path with a trailing slash, as hosts pass it
+    char bundle[4096];
+    const char* bundle_arg = argv[first];
+    size_t length = strlen(bundle_arg);
+    snprintf(bundle, sizeof(bundle), "%s%s", bundle_arg, length > 0 && bundle_arg[length - 1] == '/' ? "" : "/");
+
+    LV2_URID_Map map = { NULL, map_uri };
+    LV2_Feature map_feature = { LV2_URID__map, &map };
+    const LV2_Feature* features[] = { &map_feature, NULL };
+    LV2_URID sequence_type = map_uri(NULL, LV2_ATOM__Sequence);
+    LV2_URID midi_event = map_uri(NULL, LV2_MIDI__MidiEvent);
+
+    static float left[HOST_BLOCK], right[HOST_BLOCK];
+    float controls[PORT_COUNT] = { 0 };
+    controls[PORT_LEVEL] = 1.0f;
+    controls[PORT_PROGRAM] = program;
+    controls[PORT_CUTOFF] = 1.0f;
+    LV2_Atom_Sequence* sequence = (LV2_Atom_Sequence*)aligned_alloc(8, SEQUENCE_CAPACITY);
+    if (!sequence) {
+        return 1;
+    }
+
+    double results[MAX_BINARIES][STRESS_WORKLOAD_COUNT];
+    if (memory_only) {
+        printf("%-10s  %12s  %s\n", "binary", "memory (KB)", "path");
+    }
+    for (int b = 0; b < binary_count; b++) {
+        const char* path = argv[first + 1 + b];
+        void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+        LV2_Lib_Descriptor_Function get_library = library
+            ? (LV2_Lib_Descriptor_Function)dlsym(library, "lv2_lib_descriptor") : NULL;
+        const LV2_Lib_Descriptor* lib = get_library ? get_library(bundle, features) : NULL;
+        const LV2_Descriptor* descriptor = lib ? lib->get_plugin(lib->handle, 0) : NULL;
+        long resident_before = resident_kb();
+        LV2_Handle instance = descriptor ? descriptor->instantiate(descriptor, BENCH_RATE, bundle, features) : NULL;
+        if (!instance) {
+            if (!library) {
+                fprintf(stderr, "Failed to open %s: %s\n", path, dlerror());
+            } else {
+                fprintf(stderr, "Failed to instantiate %s for bundle %s\n", path, bundle);
+            }
+            if (lib && lib->cleanup) lib->cleanup(lib->handle);
+            if (library) dlclose(library);
+            free(sequence);
+            return 1;
+        }
+
+        descriptor->connect_port(instance, PORT_EVENTS, sequence);
+        descriptor->connect_port(instance, PORT_AUDIO_OUT_L, left);
+        descriptor->connect_port(instance, PORT_AUDIO_OUT_R, right);
+        for (uint32_t port = PORT_LEVEL; port < PORT_COUNT; port++) {
+            descriptor->connect_port(instance, port, &controls[port]);
+        }
+
+        if (memory_only) {
+            printf("%-10d  %12ld  %s\n", b + 1, resident_kb() - resident_before, path);
+            descriptor->cleanup(instance);
+            if (lib->cleanup) lib->cleanup(lib->handle);
+            dlclose(library);
+            continue;
+        }
+
+        for (int w = 0; w < STRESS_WORKLOAD_COUNT; w++) {
+            StressPattern pattern;
+            stress_pattern_build(&pattern, 1u << w, BENCH_RATE);
+            results[b][w] = bench_workload(descriptor, instance, &pattern, seconds,
+                                           sequence, sequence_type, midi_event);
+        }
+
+        descriptor->cleanup(instance);
+        if (lib->cleanup) lib->cleanup(lib->handle);
+        dlclose(library);
+    }
+
+    // One row per workload, one column per binary, speedups relative to the first
+    if (!memory_only) {
+        printf("%-10s", "workload");
+        for (int b = 0; b < binary_count; b++) {
+            printf("  %9s %d", "ns/sample", b + 1);
+            if (b > 0) printf("  %7s", "speedup");
+        }
+        printf("\n");
+        for (int w = 0; w < STRESS_WORKLOAD_COUNT; w++) {
+            printf("%-10s", stress_workload_name((StressWorkload)w));
+            for (int b = 0; b < binary_count; b++) {
+                printf("  %11.1f", results[b][w]);
+                if (b > 0) printf("  %6.2fx", results[b][w] > 0 ? results[0][w] / results[b][w] : 0.0);
+            }
+            printf("\n");
+        }
+        for (int b = 0; b < binary_count; b++) {
+            printf("%d: %s\n", b + 1, argv[first + 1 + b]);
+        }
+    }
+
+    free(sequence);
+    for (int i = 0; i < mapped_count; i++) {
+        free(mapped_uris[i]);
+    }
+    return 0;
+}
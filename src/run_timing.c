@@ -0,0 +1,102 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * run() Timing Histogram (run_timing.c)
+ *
+ * This module:
+ * 1. Sorts the phase times of every run() call into log-scale buckets
+ * 2. Counts the calls that overran their deadline
+ * 3. Reports the percentiles of each phase
+ */
+
+#include "run_timing.h"
+
+// Bucket 1 starts at 2^RUN_TIMING_FIRST_SHIFT ns, about 1 us
+#define RUN_TIMING_FIRST_SHIFT 10
+
+static const char* const phase_names[RUN_PHASES] = {
+    "controls", "events", "render", "copy", "total"
+};
+
+/* Bucket of a duration in ns */
+static int bucket_of(int64_t ns) {
+    if (ns < (1 << RUN_TIMING_FIRST_SHIFT)) {
+        return 0;
+    }
+    int octave = 63 - __builtin_clzll((unsigned long long)ns) - RUN_TIMING_FIRST_SHIFT;
+    if (octave >= RUN_TIMING_OCTAVES) {
+        return RUN_TIMING_BUCKETS - 1;
+    }
+    // The two bits below the leading one pick the step within the octave
+    int step = (int)((ns >> (octave + RUN_TIMING_FIRST_SHIFT - 2)) & (RUN_TIMING_STEPS - 1));
+    return 1 + octave * RUN_TIMING_STEPS + step;
+}
+
+/* Upper end of a bucket in ns */
+static int64_t bucket_limit(int bucket) {
+    if (bucket == 0) {
+        return 1 << RUN_TIMING_FIRST_SHIFT;
+    }
+    int octave = (bucket - 1) / RUN_TIMING_STEPS;
+    int step = (bucket - 1) % RUN_TIMING_STEPS;
+    return ((int64_t)1 << (octave + RUN_TIMING_FIRST_SHIFT)) * (RUN_TIMING_STEPS + step + 1) / RUN_TIMING_STEPS;
+}
+
+void run_timing_record(RunTiming* timing, const int64_t phase_ns[RUN_PHASES], int64_t deadline_ns) {
+    for (int phase = 0; phase < RUN_PHASES; phase++) {
+        int64_t ns = phase_ns[phase] > 0 ? phase_ns[phase] : 0;
+        atomic_fetch_add_explicit(&timing->counts[phase][bucket_of(ns)], 1, memory_order_relaxed);
+        if (ns > atomic_load_explicit(&timing->max[phase], memory_order_relaxed)) {
+            atomic_store_explicit(&timing->max[phase], ns, memory_order_relaxed);
+        }
+    }
+    if (phase_ns[RUN_PHASE_TOTAL] > deadline_ns) {
+        atomic_fetch_add_explicit(&timing->misses, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&timing->cycles, 1, memory_order_relaxed);
+}
+
+/*
+ * Time below which a share of the cycles of one phase fall, from a copy of
+ * its buckets. Bucket limits overstate it, so it is capped at the maximum.
+ */
+static double percentile_us(const uint64_t* counts, uint64_t total, double share, int64_t max_ns) {
+    uint64_t rank = (uint64_t)(share * total);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < RUN_TIMING_BUCKETS; bucket++) {
+        seen += counts[bucket];
+        if (seen > rank) {
+            int64_t limit = bucket_limit(bucket);
+            return (limit < max_ns ? limit : max_ns) / 1000.0;
+        }
+    }
+    return max_ns / 1000.0;
+}
+
+void run_timing_report(RunTiming* timing, double deadline, FILE* out) {
+    static const double shares[] = { 0.5, 0.9, 0.99, 0.999 };
+    uint64_t cycles = atomic_load_explicit(&timing->cycles, memory_order_relaxed);
+    uint64_t misses = atomic_load_explicit(&timing->misses, memory_order_relaxed);
+    fprintf(out, "  %llu cycles, %llu over %.0f%% of the block duration\n",
+            (unsigned long long)cycles, (unsigned long long)misses, deadline * 100.0);
+    if (cycles == 0) {
+        return;
+    }
+
+    fprintf(out, "  %-10s %9s %9s %9s %9s %9s  (us)\n", "phase", "p50", "p90", "p99", "p99.9", "max");
+    for (int phase = 0; phase < RUN_PHASES; phase++) {
+        // Copy the buckets first; run() may add cycles while the report is written
+        uint64_t counts[RUN_TIMING_BUCKETS];
+        uint64_t total = 0;
+        for (int bucket = 0; bucket < RUN_TIMING_BUCKETS; bucket++) {
+            counts[bucket] = atomic_load_explicit(&timing->counts[phase][bucket], memory_order_relaxed);
+            total += counts[bucket];
+        }
+        int64_t max_ns = atomic_load_explicit(&timing->max[phase], memory_order_relaxed);
+
+        fprintf(out, "  %-10s", phase_names[phase]);
+        for (size_t i = 0; i < sizeof(shares) / sizeof(shares[0]); i++) {
+            fprintf(out, " %9.1f", percentile_us(counts, total, shares[i], max_ns));
+        }
+        fprintf(out, " %9.1f\n", max_ns / 1000.0);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * run() Timing Histogram (run_timing.h)
+ *
+ * Averages hide the cycles that cause xruns, so run() records how long each
+ * of its phases took in a fixed histogram: four buckets per power of two
+ * from 1 us to about 1 s, which bounds every percentile to within 25%.
+ * Cycles that take longer than a set fraction of the block duration are
+ * counted as deadline misses.
+ *
+ * Only run() writes the histogram, with relaxed atomic updates, so it never
+ * blocks; the report can be written from any other thread at any time.
+ */
+
+#ifndef RUN_TIMING_H
+#define RUN_TIMING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Powers of two covered above 1 us, and buckets in each
+#define RUN_TIMING_OCTAVES 20
+#define RUN_TIMING_STEPS 4
+
+// Buckets of each histogram: below 1 us, then RUN_TIMING_STEPS per octave;
+// the last one also takes everything longer
+#define RUN_TIMING_BUCKETS (1 + RUN_TIMING_OCTAVES * RUN_TIMING_STEPS)
+
+/* Phases of one run() call */
+typedef enum {
+    RUN_PHASE_CONTROLS = 0,     // Restored state, reloads, program and control ports
+    RUN_PHASE_EVENTS,           // MIDI and patch event dispatch
+    RUN_PHASE_RENDER,           // fluid_synth_write_float()
+    RUN_PHASE_COPY,             // Copying the rendered audio to the output ports
+    RUN_PHASE_TOTAL,            // The whole call
+    RUN_PHASES
+} RunPhase;
+
+/* Histograms of one plugin instance, zeroed before the first cycle */
+typedef struct {
+    atomic_ullong counts[RUN_PHASES][RUN_TIMING_BUCKETS];  // Cycles per bucket
+    atomic_llong max[RUN_PHASES];                          // Longest time in ns
+    atomic_ullong cycles;                                  // Cycles recorded
+    atomic_ullong misses;                                  // Cycles over their deadline
+} RunTiming;
+
+/*
+ * Record one cycle from run(): the time of each phase in ns, and the
+ * longest the whole call may take before it counts as a deadline miss.
+ */
+void run_timing_record(RunTiming* timing, const int64_t phase_ns[RUN_PHASES], int64_t deadline_ns);
+
+/*
+ * Write the percentiles of every phase and the deadline misses.
+ * deadline is the fraction of the block duration a miss exceeds.
+ */
+void run_timing_report(RunTiming* timing, double deadline, FILE* out);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Memory Accounting (sample_memory.c)
+ *
+ * This module:
+ * 1. Reads the size of a SoundFont's sample data chunks
+ * 2. Lists the distinct samples each program uses, with the bytes
+ *    FluidSynth loads for each, from the bank's zone table or the
+ *    SoundFont's preset data
+ * 3. Counts the samples of the programs selected on each channel, as
+ *    FluidSynth's lazy loading does, and the bytes they hold
+ */
+
+#include "sample_memory.h"
+#include "sf2_bank.h"
+#include "sf2_parser.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+struct SampleMemory {
+    int program_count;
+    uint32_t sample_count;
+    uint32_t* sample_bytes;     // Bytes FluidSynth loads for each sample
+    uint32_t* program_start;    // First entry of each program in samples, plus the end
+    uint32_t* samples;          // Distinct samples of each program
+    uint32_t* refs;             // Selected channels using each sample
+    int channel_program[SAMPLE_MEMORY_CHANNELS]; // Program selected on each channel, -1 for none
+    atomic_llong loaded;        // Bytes of the samples with references
+    int64_t size;               // Bytes of the arrays above
+};
+
+int64_t sample_memory_chunk_size(const char* sf2_path, const char* bank_path) {
+    if (bank_path) {
+        size_t bank_size;
+        void* bank_map = map_file(bank_path, &bank_size);
+        if (bank_map != MAP_FAILED) {
+            const SF2BankHeader* bank = sf2_bank_validate(bank_map, bank_size);
+            int64_t size = bank ? (int64_t)bank->sample_data_size : -1;
+            munmap(bank_map, bank_size);
+            if (size >= 0) {
+                return size;
+            }
+        }
+    }
+
+    SF2File sf;
+    if (sf2_open(&sf, sf2_path) != 0) {
+        return -1;
+    }
+    int64_t size = (int64_t)sf.smpl.size + sf.sm24.size;
+    sf2_close(&sf);
+    return size;
+}
+
+/* Allocate the table for the given programs, samples and zones */
+static SampleMemory* allocate(int program_count, uint32_t sample_count, uint32_t zone_count) {
+    SampleMemory* memory = (SampleMemory*)calloc(1, sizeof(SampleMemory));
+    if (!memory) {
+        return NULL;
+    }
+    memory->program_count = program_count;
+    memory->sample_count = sample_count;
+    memory->sample_bytes = (uint32_t*)calloc(sample_count + 1, sizeof(uint32_t));
+    memory->program_start = (uint32_t*)calloc((size_t)program_count + 1, sizeof(uint32_t));
+    memory->samples = (uint32_t*)calloc(zone_count + 1, sizeof(uint32_t));
+    memory->refs = (uint32_t*)calloc(sample_count + 1, sizeof(uint32_t));
+    if (!memory->sample_bytes || !memory->program_start || !memory->samples || !memory->refs) {
+        sample_memory_free(memory);
+        return NULL;
+    }
+    for (int i = 0; i < SAMPLE_MEMORY_CHANNELS; i++) {
+        memory->channel_program[i] = -1;
+    }
+    memory->size = sizeof(SampleMemory) + (int64_t)(2 * (sample_count + 1) + zone_count + 1) * sizeof(uint32_t) +
+                   ((int64_t)program_count + 1) * sizeof(uint32_t);
+    return memory;
+}
+
+/*
+ * Add a zone's sample to the samples of a program. Zones must come in
+ * program order; seen holds, for each sample, one more than the last
+ * program it was added to.
+ */
+static void add_zone(SampleMemory* memory, uint32_t* seen, uint32_t* count,
+                     int program, uint32_t sample, uint32_t bytes) {
+    if (sample >= memory->sample_count) {
+        return;
+    }
+    memory->sample_bytes[sample] = bytes;
+    if (seen[sample] != (uint32_t)program + 1) {
+        seen[sample] = (uint32_t)program + 1;
+        memory->samples[(*count)++] = sample;
+    }
+}
+
+/* Build the table from a sample bank */
+static SampleMemory* open_bank(const char* bank_path, int program_count) {
+    size_t bank_size;
+    void* bank_map = map_file(bank_path, &bank_size);
+    if (bank_map == MAP_FAILED) {
+        return NULL;
+    }
+    const SF2BankHeader* bank = sf2_bank_validate(bank_map, bank_size);
+    if (!bank || bank->preset_count != (uint32_t)program_count) {
+        munmap(bank_map, bank_size);
+        return NULL;
+    }
+
+    SampleMemory* memory = allocate(program_count, bank->sample_count, bank->zone_count);
+    uint32_t* seen = memory ? (uint32_t*)calloc(bank->sample_count + 1, sizeof(uint32_t)) : NULL;
+    if (!seen) {
+        sample_memory_free(memory);
+        munmap(bank_map, bank_size);
+        return NULL;
+    }
+
+    // The 24 bit low bytes add half the 16 bit size of each sample
+    int sm24 = (bank->flags & SF2_BANK_SM24) != 0;
+    const SF2BankPreset* presets = sf2_bank_presets(bank);
+    const SF2BankZone* zones = sf2_bank_zones(bank);
+    uint32_t count = 0;
+    for (int p = 0; p < program_count; p++) {
+        memory->program_start[p] = count;
+        for (uint32_t z = presets[p].zone_start; z < presets[p].zone_start + presets[p].zone_count; z++) {
+            uint32_t bytes = zones[z].data_size + (sm24 ? zones[z].data_size / 2 : 0);
+            add_zone(memory, seen, &count, p, zones[z].sample, bytes);
+        }
+    }
+    memory->program_start[program_count] = count;
+
+    free(seen);
+    munmap(bank_map, bank_size);
+    return memory;
+}
+
+/* Build the table from the SoundFont's preset data */
+static SampleMemory* open_soundfont(const char* sf2_path, int program_count) {
+    SF2File sf;
+    if (sf2_open(&sf, sf2_path) != 0) {
+        return NULL;
+    }
+    SF2Preset* presets = NULL;
+    SF2Sample* samples = NULL;
+    SF2Zone* zones = NULL;
+    SampleMemory* memory = NULL;
+    uint32_t* seen = NULL;
+    int preset_count = sf2_read_presets(&sf, &presets);
+    int sample_count = preset_count == program_count ? sf2_read_samples(&sf, &samples) : -1;
+    int zone_count = sample_count >= 0 ? sf2_read_zones(&sf, presets, preset_count, &zones) : -1;
+    if (zone_count >= 0) {
+        memory = allocate(program_count, (uint32_t)sample_count, (uint32_t)zone_count);
+        seen = (uint32_t*)calloc((size_t)sample_count + 1, sizeof(uint32_t));
+    }
+
+    if (memory && seen) {
+        // 2 bytes per sample point, and 1 more with 24 bit sample data
+        uint32_t point_bytes = sf.sm24.size > 0 ? 3 : 2;
+        uint32_t count = 0;
+        int next_program = 0;
+        for (int z = 0; z < zone_count; z++) {
+            while (next_program <= zones[z].preset && next_program < program_count) {
+                memory->program_start[next_program++] = count;
+            }
+            const SF2Sample* sample = &samples[zones[z].sample];
+            uint32_t points = sample->end > sample->start ? sample->end - sample->start : 0;
+            add_zone(memory, seen, &count, zones[z].preset, (uint32_t)zones[z].sample, points * point_bytes);
+        }
+        while (next_program <= program_count) {
+            memory->program_start[next_program++] = count;
+        }
+    } else {
+        sample_memory_free(memory);
+        memory = NULL;
+    }
+
+    free(seen);
+    free(zones);
+    free(samples);
+    free(presets);
+    sf2_close(&sf);
+    return memory;
+}
+
+SampleMemory* sample_memory_open(const char* sf2_path, const char* bank_path, int program_count) {
+    SampleMemory* memory = bank_path ? open_bank(bank_path, program_count) : open_soundfont(sf2_path, program_count);
+    if (!memory) {
+        fprintf(stderr, "Cannot read the sample table of %s, sample memory not counted\n", sf2_path);
+    }
+    return memory;
+}
+
+void sample_memory_free(SampleMemory* memory) {
+    if (!memory) {
+        return;
+    }
+    free(memory->sample_bytes);
+    free(memory->program_start);
+    free(memory->samples);
+    free(memory->refs);
+    free(memory);
+}
+
+void sample_memory_select(SampleMemory* memory, int channel, int program) {
+    if (channel < 0 || channel >= SAMPLE_MEMORY_CHANNELS) {
+        return;
+    }
+    if (program < 0 || program >= memory->program_count) {
+        program = -1;
+    }
+    int old = memory->channel_program[channel];
+    if (old == program) {
+        return;
+    }
+    memory->channel_program[channel] = program;
+
+    // Count the new program first, so samples both use are never released
+    int64_t loaded = atomic_load_explicit(&memory->loaded, memory_order_relaxed);
+    if (program >= 0) {
+        for (uint32_t i = memory->program_start[program]; i < memory->program_start[program + 1]; i++) {
+            uint32_t sample = memory->samples[i];
+            if (memory->refs[sample]++ == 0) {
+                loaded += memory->sample_bytes[sample];
+            }
+        }
+    }
+    if (old >= 0) {
+        for (uint32_t i = memory->program_start[old]; i < memory->program_start[old + 1]; i++) {
+            uint32_t sample = memory->samples[i];
+            if (--memory->refs[sample] == 0) {
+                loaded -= memory->sample_bytes[sample];
+            }
+        }
+    }
+    atomic_store_explicit(&memory->loaded, loaded, memory_order_relaxed);
+}
+
+int64_t sample_memory_loaded(const SampleMemory* memory) {
+    return atomic_load_explicit(&((SampleMemory*)memory)->loaded, memory_order_relaxed);
+}
+
+int64_t sample_memory_size(const SampleMemory* memory) {
+    return memory->size;
+}
@@ -0,0 +1,60 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Memory Accounting (sample_memory.h)
+ *
+ * FluidSynth does not report what it allocates for samples, so the plugin
+ * computes it from the SoundFont's sample tables. Without lazy loading
+ * FluidSynth loads the whole sample data chunk. With lazy loading it loads
+ * every sample used by a preset selected on a channel, once, and frees it
+ * when no selected preset uses it any more; this module keeps the same
+ * reference counts per sample. The samples each program uses come from the
+ * sample bank if the SoundFont has one, or from its preset data.
+ *
+ * Selecting a program never blocks or allocates, so it can follow the
+ * program changes of run(). Only one thread may select at a time.
+ */
+
+#ifndef SAMPLE_MEMORY_H
+#define SAMPLE_MEMORY_H
+
+#include <stdint.h>
+
+// Channels of a synth, plus the staging synth the worker loads programs on
+#define SAMPLE_MEMORY_CHANNELS 17
+#define SAMPLE_MEMORY_STAGING 16
+
+typedef struct SampleMemory SampleMemory;
+
+/*
+ * Size of the SoundFont's sample data chunks (smpl and sm24), which is what
+ * FluidSynth loads without lazy loading. Taken from the bank if bank_path is
+ * not NULL, else from the SoundFont's chunk headers.
+ * Returns -1 if neither can be read.
+ */
+int64_t sample_memory_chunk_size(const char* sf2_path, const char* bank_path);
+
+/*
+ * Build the table of the samples each program uses and their sizes, from
+ * the bank if bank_path is not NULL, else from the SoundFont. Programs are
+ * numbered in Program port order; program_count must match the SoundFont's.
+ * Returns NULL on failure.
+ */
+SampleMemory* sample_memory_open(const char* sf2_path, const char* bank_path, int program_count);
+
+/* Free the table */
+void sample_memory_free(SampleMemory* memory);
+
+/*
+ * Follow the selection of a program on a channel, -1 to unset it: the
+ * samples of the program it replaces are released, those of the new one
+ * are counted.
+ */
+void sample_memory_select(SampleMemory* memory, int channel, int program);
+
+/* Bytes of the samples used by the programs selected on any channel */
+int64_t sample_memory_loaded(const SampleMemory* memory);
+
+/* Bytes the table itself holds */
+int64_t sample_memory_size(const SampleMemory* memory);
+
+#endif
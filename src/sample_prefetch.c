@@ -0,0 +1,311 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Predictive Sample Prefetch (sample_prefetch.c)
+ *
+ * This module:
+ * 1. Passes program and bank events from run() to a thread through a
+ *    lock-free ring
+ * 2. Predicts the presets that will be selected next
+ * 3. Reads their sample data ahead with madvise(MADV_WILLNEED)
+ * 4. Measures its allocation, how much of the mapped SoundFont is resident
+ *    and how much of a preset's sample data is
+ */
+
+#include "sample_prefetch.h"
+#include "sf2_bank.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Events the ring holds; a power of two
+#define PREFETCH_RING_SIZE 256
+
+// Presets remembered as read ahead completely
+#define PREFETCH_RECENT_PRESETS 8
+
+/* Kinds of events posted by run() */
+enum {
+    EVENT_PROGRAM = 0,  // The Program port selected a program
+    EVENT_BANK          // A MIDI bank select
+};
+
+/* One event in the ring */
+typedef struct {
+    uint8_t type;       // EVENT_PROGRAM or EVENT_BANK
+    int32_t value;      // Program, or bank number
+} PrefetchEvent;
+
+struct SamplePrefetcher {
+    // Ring written by run() and read by the thread
+    PrefetchEvent ring[PREFETCH_RING_SIZE];
+    atomic_uint head;               // Next slot run() writes
+    atomic_uint tail;               // Next slot the thread reads
+    unsigned woken_head;            // head when run() last woke the thread
+    sem_t wake;                     // Posted by sample_prefetch_wake()
+    atomic_int stop;                // Tells the thread to exit
+    pthread_t thread;               // Prefetch thread
+
+    // Counters
+    atomic_ullong dropped;
+
+    // Mapped bank tables and the SoundFont they describe, only read after start
+    void* bank_map;
+    size_t bank_size;
+    void* map;
+    size_t map_size;
+    const SF2BankHeader* bank;
+    const SF2BankPreset* presets;
+    const SF2BankZone* zones;
+    uint64_t page_mask;
+
+    // Prediction state, used only by the thread
+    int program;                                // Program of the last event, -1 before any
+    int recent[PREFETCH_RECENT_PRESETS];        // Programs read ahead
+    int recent_next;                            // Slot of recent to replace next
+};
+
+/* Read ahead the sample data of one zone */
+static void prefetch_zone(SamplePrefetcher* prefetcher, const SF2BankZone* zone) {
+    uint64_t start = zone->data_offset & prefetcher->page_mask;
+    uint64_t end = zone->data_offset + zone->data_size;
+    if (end <= prefetcher->map_size) {
+        madvise((uint8_t*)prefetcher->map + start, end - start, MADV_WILLNEED);
+    }
+}
+
+/* Check whether a program was read ahead */
+static int recently_prefetched(const SamplePrefetcher* prefetcher, int program) {
+    for (int i = 0; i < PREFETCH_RECENT_PRESETS; i++) {
+        if (prefetcher->recent[i] == program) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Read ahead every zone of a program */
+static void prefetch_preset(SamplePrefetcher* prefetcher, int program) {
+    if (program < 0 || (uint32_t)program >= prefetcher->bank->preset_count ||
+        recently_prefetched(prefetcher, program)) {
+        return;
+    }
+    const SF2BankPreset* preset = &prefetcher->presets[program];
+    for (uint32_t z = preset->zone_start; z < preset->zone_start + preset->zone_count; z++) {
+        prefetch_zone(prefetcher, &prefetcher->zones[z]);
+    }
+    prefetcher->recent[prefetcher->recent_next] = program;
+    prefetcher->recent_next = (prefetcher->recent_next + 1) % PREFETCH_RECENT_PRESETS;
+}
+
+/*
+ * Follow a program change: its neighbours in Program port order, the
+ * likely next choices, are read ahead. The program itself is loaded as
+ * it is selected.
+ */
+static void set_program(SamplePrefetcher* prefetcher, int program) {
+    if (program < 0 || (uint32_t)program >= prefetcher->bank->preset_count ||
+        program == prefetcher->program) {
+        return;
+    }
+    prefetcher->program = program;
+    prefetch_preset(prefetcher, program - 1);
+    prefetch_preset(prefetcher, program + 1);
+}
+
+/* Follow a bank select: read ahead the current program number in that bank */
+static void handle_bank(SamplePrefetcher* prefetcher, int bank) {
+    if (prefetcher->program < 0) {
+        return;
+    }
+    int prog = prefetcher->presets[prefetcher->program].prog;
+    for (uint32_t p = 0; p < prefetcher->bank->preset_count; p++) {
+        if (prefetcher->presets[p].bank == bank && prefetcher->presets[p].prog == prog) {
+            prefetch_preset(prefetcher, (int)p);
+            break;
+        }
+    }
+}
+
+/* Prefetch thread: handle the posted events each time run() wakes it */
+static void* prefetch_thread(void* data) {
+    SamplePrefetcher* prefetcher = (SamplePrefetcher*)data;
+    for (;;) {
+        if (sem_wait(&prefetcher->wake) != 0) {
+            continue;   // Interrupted by a signal
+        }
+        if (atomic_load(&prefetcher->stop)) {
+            break;
+        }
+        unsigned tail = atomic_load_explicit(&prefetcher->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&prefetcher->head, memory_order_acquire);
+        for (; tail != head; tail++) {
+            const PrefetchEvent* event = &prefetcher->ring[tail % PREFETCH_RING_SIZE];
+            switch (event->type) {
+                case EVENT_PROGRAM:
+                    set_program(prefetcher, event->value);
+                    break;
+                case EVENT_BANK:
+                    handle_bank(prefetcher, event->value);
+                    break;
+            }
+            atomic_store_explicit(&prefetcher->tail, tail + 1, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+/* Put an event into the ring, or count it as dropped if the ring is full */
+static void post_event(SamplePrefetcher* prefetcher, PrefetchEvent event) {
+    unsigned head = atomic_load_explicit(&prefetcher->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&prefetcher->tail, memory_order_acquire);
+    if (head - tail >= PREFETCH_RING_SIZE) {
+        atomic_fetch_add_explicit(&prefetcher->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    prefetcher->ring[head % PREFETCH_RING_SIZE] = event;
+    atomic_store_explicit(&prefetcher->head, head + 1, memory_order_release);
+}
+
+/* Unmap the bank and the SoundFont and free the prefetcher */
+static void release(SamplePrefetcher* prefetcher) {
+    if (prefetcher->bank_map != MAP_FAILED) munmap(prefetcher->bank_map, prefetcher->bank_size);
+    if (prefetcher->map != MAP_FAILED) munmap(prefetcher->map, prefetcher->map_size);
+    free(prefetcher);
+}
+
+SamplePrefetcher* sample_prefetch_start(const char* bank_path, const char* sf2_path) {
+    SamplePrefetcher* prefetcher = (SamplePrefetcher*)calloc(1, sizeof(SamplePrefetcher));
+    if (!prefetcher) {
+        return NULL;
+    }
+    prefetcher->program = -1;
+    for (int i = 0; i < PREFETCH_RECENT_PRESETS; i++) {
+        prefetcher->recent[i] = -1;
+    }
+    prefetcher->page_mask = ~(uint64_t)(sysconf(_SC_PAGESIZE) - 1);
+
+    prefetcher->bank_map = map_file(bank_path, &prefetcher->bank_size);
+    prefetcher->map = map_file(sf2_path, &prefetcher->map_size);
+    prefetcher->bank = prefetcher->bank_map != MAP_FAILED ?
+        sf2_bank_validate(prefetcher->bank_map, prefetcher->bank_size) : NULL;
+    if (!prefetcher->bank || prefetcher->map == MAP_FAILED ||
+        prefetcher->map_size != prefetcher->bank->source_size) {
+        fprintf(stderr, "Sample prefetch disabled, cannot map bank: %s\n", bank_path);
+        release(prefetcher);
+        return NULL;
+    }
+    prefetcher->presets = sf2_bank_presets(prefetcher->bank);
+    prefetcher->zones = sf2_bank_zones(prefetcher->bank);
+
+    if (sem_init(&prefetcher->wake, 0, 0) != 0) {
+        release(prefetcher);
+        return NULL;
+    }
+    if (pthread_create(&prefetcher->thread, NULL, prefetch_thread, prefetcher) != 0) {
+        fprintf(stderr, "Sample prefetch disabled, cannot start thread\n");
+        sem_destroy(&prefetcher->wake);
+        release(prefetcher);
+        return NULL;
+    }
+    return prefetcher;
+}
+
+void sample_prefetch_stop(SamplePrefetcher* prefetcher) {
+    if (!prefetcher) {
+        return;
+    }
+    atomic_store(&prefetcher->stop, 1);
+    sem_post(&prefetcher->wake);
+    pthread_join(prefetcher->thread, NULL);
+    sem_destroy(&prefetcher->wake);
+    release(prefetcher);
+}
+
+void sample_prefetch_program(SamplePrefetcher* prefetcher, int program) {
+    PrefetchEvent event = { EVENT_PROGRAM, program };
+    post_event(prefetcher, event);
+}
+
+void sample_prefetch_bank(SamplePrefetcher* prefetcher, int bank) {
+    PrefetchEvent event = { EVENT_BANK, bank };
+    post_event(prefetcher, event);
+}
+
+void sample_prefetch_wake(SamplePrefetcher* prefetcher) {
+    unsigned head = atomic_load_explicit(&prefetcher->head, memory_order_relaxed);
+    if (head != prefetcher->woken_head) {
+        prefetcher->woken_head = head;
+        sem_post(&prefetcher->wake);
+    }
+}
+
+void sample_prefetch_stats(SamplePrefetcher* prefetcher, SamplePrefetchStats* stats) {
+    stats->dropped = atomic_load_explicit(&prefetcher->dropped, memory_order_relaxed);
+}
+
+void sample_prefetch_memory(SamplePrefetcher* prefetcher, SamplePrefetchMemory* memory) {
+    memory->allocated = sizeof(SamplePrefetcher);
+    memory->mapped = prefetcher->map_size;
+    memory->resident = 0;
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pages = (prefetcher->map_size + page_size - 1) / page_size;
+    unsigned char* vector = (unsigned char*)malloc(pages > 0 ? pages : 1);
+    if (vector && mincore(prefetcher->map, prefetcher->map_size, vector) == 0) {
+        for (size_t i = 0; i < pages; i++) {
+            memory->resident += (vector[i] & 1) ? page_size : 0;
+        }
+    }
+    free(vector);
+    if (memory->resident > memory->mapped) {
+        memory->resident = memory->mapped;  // The last page is partly past the end
+    }
+}
+
+int sample_prefetch_residency(SamplePrefetcher* prefetcher, int program,
+                              uint64_t* resident, uint64_t* missing) {
+    *resident = 0;
+    *missing = 0;
+    if (program < 0 || (uint32_t)program >= prefetcher->bank->preset_count) {
+        return -1;
+    }
+
+    // Zones share samples, so each page is counted once
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pages = (prefetcher->map_size + page_size - 1) / page_size;
+    unsigned char* vector = (unsigned char*)malloc(pages);
+    unsigned char* counted = (unsigned char*)calloc(pages, 1);
+    if (!vector || !counted || mincore(prefetcher->map, prefetcher->map_size, vector) != 0) {
+        free(vector);
+        free(counted);
+        return -1;
+    }
+    const SF2BankPreset* preset = &prefetcher->presets[program];
+    for (uint32_t z = preset->zone_start; z < preset->zone_start + preset->zone_count; z++) {
+        const SF2BankZone* zone = &prefetcher->zones[z];
+        uint64_t end = zone->data_offset + zone->data_size;
+        if (zone->data_size == 0 || end > prefetcher->map_size) {
+            continue;
+        }
+        for (size_t page = zone->data_offset / page_size; page <= (end - 1) / page_size; page++) {
+            if (!counted[page]) {
+                counted[page] = 1;
+                if (vector[page] & 1) {
+                    *resident += page_size;
+                } else {
+                    *missing += page_size;
+                }
+            }
+        }
+    }
+    free(vector);
+    free(counted);
+    return 0;
+}
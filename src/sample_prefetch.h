@@ -0,0 +1,75 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Predictive Sample Prefetch (sample_prefetch.h)
+ *
+ * With lazy sample loading the worker thread loads a preset's samples when
+ * the Program port selects it, reading them from the mapped SoundFont; data
+ * that is not in the page cache is read from disk while the selection
+ * waits. The prefetcher follows what run() selects and reads ahead, on its
+ * own thread, the presets that are likely to be chosen next: the presets
+ * next to the current one and the preset a MIDI bank select points at. It
+ * also tells how much of a preset's sample data is in the page cache.
+ * Notes are not followed: FluidSynth copies every sample of a selected
+ * preset into its own memory, so playing never reads the SoundFont.
+ *
+ * run() posts events into a single-producer, single-consumer ring and wakes
+ * the thread once per cycle. Posting never blocks or allocates; when the
+ * ring is full the event is dropped and counted.
+ */
+
+#ifndef SAMPLE_PREFETCH_H
+#define SAMPLE_PREFETCH_H
+
+#include <stdint.h>
+
+typedef struct SamplePrefetcher SamplePrefetcher;
+
+/* Events the prefetcher could not take */
+typedef struct {
+    uint64_t dropped;   // Events lost to a full ring
+} SamplePrefetchStats;
+
+/* Memory held by a prefetcher */
+typedef struct {
+    uint64_t allocated;     // The prefetcher and its ring
+    uint64_t mapped;        // Size of the SoundFont mapping
+    uint64_t resident;      // Bytes of the mapping in the page cache
+} SamplePrefetchMemory;
+
+/*
+ * Map a sample bank and the SoundFont it describes and start the prefetch
+ * thread for them. The zone table is read from the bank; the read-ahead
+ * goes to the SoundFont.
+ * Returns NULL if either cannot be mapped or the thread cannot be started.
+ */
+SamplePrefetcher* sample_prefetch_start(const char* bank_path, const char* sf2_path);
+
+/* Stop the thread, unmap the files and free the prefetcher */
+void sample_prefetch_stop(SamplePrefetcher* prefetcher);
+
+/*
+ * Events from run(). Programs are indices into the bank's preset table, in
+ * Program port order. None of these block; the thread only sees the events
+ * once sample_prefetch_wake() is called.
+ */
+void sample_prefetch_program(SamplePrefetcher* prefetcher, int program);
+void sample_prefetch_bank(SamplePrefetcher* prefetcher, int bank);
+
+/* Wake the thread if events were posted since the last call */
+void sample_prefetch_wake(SamplePrefetcher* prefetcher);
+
+/* Read the counters; safe from any thread */
+void sample_prefetch_stats(SamplePrefetcher* prefetcher, SamplePrefetchStats* stats);
+
+/* Measure the memory the prefetcher holds; not for the audio thread */
+void sample_prefetch_memory(SamplePrefetcher* prefetcher, SamplePrefetchMemory* memory);
+
+/*
+ * Measure how many bytes of a program's sample data are in the page cache
+ * and how many would be read from disk, with mincore(). Not for the audio
+ * thread. Returns -1 if the program is not in the bank.
+ */
+int sample_prefetch_residency(SamplePrefetcher* prefetcher, int program,
+                              uint64_t* resident, uint64_t* missing);
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont Resource Analyzer (sf2_analyzer.c)
+ *
+ * This module:
+ * 1. Flattens the zones of every preset with the streaming parser
+ * 2. Counts the zones each key/velocity pair starts
+ * 3. Sums the sample data each preset references, counting shared samples once
+ */
+
+#include "sf2_analyzer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Note-on grid: every MIDI key with every non-zero velocity
+#define GRID_KEYS 128
+#define GRID_VELOCITIES 128
+
+/* Bytes of sample data a sample header refers to, clamped to the smpl chunk */
+static int64_t sample_size(const SF2File* sf, const SF2Sample* sample) {
+    uint32_t points = (uint32_t)(sf->smpl.size / 2);
+    uint32_t end = sample->end < points ? sample->end : points;
+    uint32_t start = sample->start < end ? sample->start : end;
+    int bytes_per_point = sf->sm24.size >= points && points > 0 ? 3 : 2;
+    return (int64_t)(end - start) * bytes_per_point;
+}
+
+int sf2_analyze_presets(SF2File* sf, const SF2Preset* presets, int preset_count,
+                        SF2PresetStats** stats_out) {
+    *stats_out = NULL;
+
+    SF2Zone* zones = NULL;
+    SF2Sample* samples = NULL;
+    int zone_count = sf2_read_zones(sf, presets, preset_count, &zones);
+    int sample_count = zone_count >= 0 ? sf2_read_samples(sf, &samples) : -1;
+    if (zone_count < 0 || sample_count < 0) {
+        free(zones);
+        free(samples);
+        return -1;
+    }
+
+    SF2PresetStats* stats = (SF2PresetStats*)calloc(preset_count > 0 ? preset_count : 1, sizeof(SF2PresetStats));
+    int* seen = (int*)calloc(sample_count > 0 ? sample_count : 1, sizeof(int));
+    uint16_t (*grid)[GRID_VELOCITIES] = malloc(sizeof(uint16_t[GRID_KEYS][GRID_VELOCITIES]));
+    if (!stats || !seen || !grid) {
+        free(stats); free(seen); free(grid); free(zones); free(samples);
+        return -1;
+    }
+
+    // Zones come back grouped by preset, so each preset owns one contiguous run
+    int z = 0;
+    for (int p = 0; p < preset_count; p++) {
+        SF2PresetStats* preset = &stats[p];
+        memset(grid, 0, sizeof(uint16_t[GRID_KEYS][GRID_VELOCITIES]));
+
+        for (; z < zone_count && zones[z].preset == p; z++) {
+            const SF2Zone* zone = &zones[z];
+            preset->zone_count++;
+            if (zone->loop_mode == 1 || zone->loop_mode == 3) {
+                preset->looping_zones++;
+            }
+
+            // seen[] holds the last preset (plus one) that counted the sample
+            if (seen[zone->sample] != p + 1) {
+                seen[zone->sample] = p + 1;
+                preset->sample_count++;
+                preset->sample_bytes += sample_size(sf, &samples[zone->sample]);
+            }
+
+            int vel_lo = zone->vel_lo > 0 ? zone->vel_lo : 1;
+            for (int key = zone->key_lo; key <= zone->key_hi && key < GRID_KEYS; key++) {
+                for (int vel = vel_lo; vel <= zone->vel_hi && vel < GRID_VELOCITIES; vel++) {
+                    if (grid[key][vel] < UINT16_MAX) grid[key][vel]++;
+                }
+            }
+        }
+
+        int64_t started = 0;
+        int sounding = 0;
+        for (int key = 0; key < GRID_KEYS; key++) {
+            for (int vel = 1; vel < GRID_VELOCITIES; vel++) {
+                int count = grid[key][vel];
+                if (count == 0) {
+                    continue;
+                }
+                sounding++;
+                started += count;
+                if (count > preset->max_zones) preset->max_zones = count;
+            }
+        }
+        preset->avg_zones = sounding > 0 ? (double)started / sounding : 0.0;
+        preset->coverage = (int)((int64_t)sounding * 100 / (GRID_KEYS * (GRID_VELOCITIES - 1)));
+    }
+
+    free(seen);
+    free(grid);
+    free(zones);
+    free(samples);
+    *stats_out = stats;
+    return 0;
+}
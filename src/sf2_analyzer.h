@@ -0,0 +1,38 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont Resource Analyzer (sf2_analyzer.h)
+ *
+ * Predicts what each preset costs to play: how much sample data it
+ * references and how many zones (voices) a single note-on starts across
+ * the key/velocity grid. The generator prints these figures and records
+ * them in the plugin metadata so hosts can budget memory and CPU.
+ */
+
+#ifndef SF2_ANALYZER_H
+#define SF2_ANALYZER_H
+
+#include "sf2_parser.h"
+
+#include <stdint.h>
+
+/* Resource figures of one preset */
+typedef struct {
+    int64_t sample_bytes;       // smpl and sm24 bytes of the distinct samples referenced
+    int sample_count;           // Distinct samples referenced
+    int zone_count;             // Playable zones
+    int max_zones;              // Most zones started by one note-on
+    double avg_zones;           // Mean zones started by the note-ons that sound
+    int coverage;               // Percentage of key/velocity pairs that sound
+    int looping_zones;          // Zones whose sample loops (sampleModes 1 or 3)
+} SF2PresetStats;
+
+/*
+ * Analyze the given presets. Note-ons are evaluated for every key 0-127 and
+ * velocity 1-127; velocity 0 is a note-off.
+ * The returned array has one entry per preset and must be released with free().
+ * Returns 0 on success, -1 on failure.
+ */
+int sf2_analyze_presets(SF2File* sf, const SF2Preset* presets, int preset_count,
+                        SF2PresetStats** stats_out);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Preprocessed Sample Bank (sf2_bank.c)
+ *
+ * Checksum and validation shared by the generator, which writes banks,
+ * and the plugin, which maps them and checks them against the SoundFont.
+ */
+
+#include "sf2_bank.h"
+#include "content_hash.h"
+
+#include <string.h>
+
+uint64_t sf2_bank_checksum(const SF2BankHeader* header, const SF2BankPreset* presets,
+                           const SF2BankZone* zones) {
+    SF2BankHeader copy = *header;
+    copy.checksum = 0;
+
+    ContentHash hash;
+    content_hash_init(&hash);
+    content_hash_update(&hash, &copy, sizeof(copy));
+    content_hash_update(&hash, presets, (size_t)header->preset_count * sizeof(SF2BankPreset));
+    content_hash_update(&hash, zones, (size_t)header->zone_count * sizeof(SF2BankZone));
+    return content_hash_final(&hash);
+}
+
+/* Check that a section lies inside the file and starts on a cache line */
+static int section_fits(uint64_t offset, uint64_t size, size_t file_size) {
+    return offset % SF2_BANK_ALIGN == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+const SF2BankHeader* sf2_bank_validate(const void* data, size_t size) {
+    const SF2BankHeader* header = (const SF2BankHeader*)data;
+    if (size < sizeof(SF2BankHeader) ||
+        memcmp(header->magic, SF2_BANK_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != SF2_BANK_BYTE_ORDER ||
+        header->version != SF2_BANK_VERSION ||
+        header->header_size != sizeof(SF2BankHeader)) {
+        return NULL;
+    }
+
+    if (!section_fits(header->preset_offset, (uint64_t)header->preset_count * sizeof(SF2BankPreset), size) ||
+        !section_fits(header->zone_offset, (uint64_t)header->zone_count * sizeof(SF2BankZone), size) ||
+        header->pdta_offset > header->source_size || header->pdta_size > header->source_size - header->pdta_offset) {
+        return NULL;
+    }
+
+    // Every zone range of every preset must exist, and every sample range must lie in the SoundFont
+    const SF2BankPreset* presets = sf2_bank_presets(header);
+    const SF2BankZone* zones = sf2_bank_zones(header);
+    for (uint32_t i = 0; i < header->preset_count; i++) {
+        if (presets[i].zone_start > header->zone_count ||
+            presets[i].zone_count > header->zone_count - presets[i].zone_start ||
+            memchr(presets[i].name, '\0', sizeof(presets[i].name)) == NULL) {
+            return NULL;
+        }
+    }
+    for (uint32_t i = 0; i < header->zone_count; i++) {
+        if (zones[i].data_offset > header->source_size ||
+            zones[i].data_size > header->source_size - zones[i].data_offset ||
+            zones[i].sample >= header->sample_count) {
+            return NULL;
+        }
+    }
+
+    if (sf2_bank_checksum(header, presets, zones) != header->checksum) {
+        return NULL;
+    }
+    return header;
+}
+
+int sf2_bank_matches(const SF2BankHeader* header, const void* soundfont, size_t size) {
+    if (size != header->source_size) {
+        return 0;
+    }
+    ContentHash hash;
+    content_hash_init(&hash);
+    content_hash_update(&hash, (const uint8_t*)soundfont + header->pdta_offset, (size_t)header->pdta_size);
+    return content_hash_final(&hash) == header->pdta_hash;
+}
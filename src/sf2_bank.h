@@ -0,0 +1,124 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Preprocessed Sample Bank (sf2_bank.h)
+ *
+ * A bank file is written by ttl_generator next to the SoundFont it describes
+ * and holds no sample data of its own: a fixed header, a flat preset table
+ * in the order the Program port uses and a flat zone table (key/velocity
+ * ranges mapped to byte ranges of the SoundFont's sample data), each section
+ * aligned to a cache line. The header and tables are covered by a checksum,
+ * and the header records the SoundFont's size and a hash of its preset data
+ * (pdta) list, which holds every preset and sample header the tables were
+ * built from. A damaged bank is rejected, and the plugin checks both
+ * against the SoundFont with sf2_bank_matches() when it loads, so a bank
+ * left over from an edited SoundFont is ignored and the plugin scans the
+ * SoundFont instead.
+ *
+ * All values are stored in the byte order of the machine that built the
+ * bank; a bank from a machine with a different byte order fails the magic
+ * check and is ignored.
+ */
+
+#ifndef SF2_BANK_H
+#define SF2_BANK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// File identification and format version
+#define SF2_BANK_MAGIC "SF2LVBNK"
+#define SF2_BANK_VERSION 3
+
+// Byte order marker, read back as a different value on a foreign machine
+#define SF2_BANK_BYTE_ORDER 0x01020304u
+
+// Every section starts on a cache line boundary
+#define SF2_BANK_ALIGN 64
+
+// File name extension of bank files
+#define SF2_BANK_EXT ".sf2bank"
+
+/* Fixed header at the start of the file */
+typedef struct {
+    char magic[8];              // SF2_BANK_MAGIC, not zero terminated
+    uint32_t version;           // SF2_BANK_VERSION
+    uint32_t byte_order;        // SF2_BANK_BYTE_ORDER
+    uint32_t header_size;       // sizeof(SF2BankHeader)
+    uint32_t preset_count;      // Entries in the preset table
+    uint32_t zone_count;        // Entries in the zone table
+    uint32_t sample_count;      // Sample headers in the SoundFont; zone sample indices are below it
+    uint32_t flags;             // SF2_BANK_SM24 if the SoundFont has usable 24 bit sample data
+    uint32_t reserved;          // Zero
+    uint64_t preset_offset;     // File offset of the preset table
+    uint64_t zone_offset;       // File offset of the zone table
+    uint64_t source_size;       // Size of the SoundFont the tables describe
+    uint64_t pdta_offset;       // Offset of its preset data (pdta) list in the SoundFont
+    uint64_t pdta_size;         // Size of the pdta list in bytes
+    uint64_t pdta_hash;         // Content hash of the pdta list
+    uint64_t sample_data_size;  // Size of its smpl chunk, and of sm24 if flagged, in bytes
+    uint64_t checksum;          // Content hash of header (this field zero) and tables
+} SF2BankHeader;
+
+// The SoundFont has an sm24 chunk covering every point of smpl, loaded with each sample at half its 16 bit size
+#define SF2_BANK_SM24 1u
+
+/* One preset, in Program port order */
+typedef struct {
+    uint16_t bank;              // MIDI bank number (0-128)
+    uint16_t prog;              // MIDI program number (0-127)
+    uint32_t zone_start;        // First entry in the zone table
+    uint32_t zone_count;        // Number of zones of this preset
+    char name[24];              // Zero terminated preset name
+} SF2BankPreset;
+
+/* One playable zone: a sample reached through a preset and instrument zone */
+typedef struct {
+    uint8_t key_lo;             // Lowest MIDI key
+    uint8_t key_hi;             // Highest MIDI key
+    uint8_t vel_lo;             // Lowest velocity
+    uint8_t vel_hi;             // Highest velocity
+    uint32_t sample;            // Sample index in the SoundFont
+    uint64_t data_offset;       // Offset of the 16 bit sample data within the SoundFont
+    uint32_t data_size;         // Size of the 16 bit sample data in bytes
+    uint32_t loop_mode;         // sampleModes generator value
+} SF2BankZone;
+
+_Static_assert(sizeof(SF2BankHeader) == 104, "bank header layout changed");
+_Static_assert(sizeof(SF2BankPreset) == 36, "bank preset layout changed");
+_Static_assert(sizeof(SF2BankZone) == 24, "bank zone layout changed");
+
+/* Round a file offset up to the section alignment */
+static inline uint64_t sf2_bank_align(uint64_t offset) {
+    return (offset + SF2_BANK_ALIGN - 1) & ~(uint64_t)(SF2_BANK_ALIGN - 1);
+}
+
+/*
+ * Compute the checksum of a bank: the header with its checksum field set to
+ * zero, followed by the preset and zone tables.
+ */
+uint64_t sf2_bank_checksum(const SF2BankHeader* header, const SF2BankPreset* presets,
+                           const SF2BankZone* zones);
+
+/*
+ * Check that a mapped bank file is complete and intact.
+ * Returns the header on success, NULL if the data is not a valid bank.
+ */
+const SF2BankHeader* sf2_bank_validate(const void* data, size_t size);
+
+/*
+ * Check that a validated bank describes the mapped SoundFont: the sizes
+ * must agree and its pdta list must hash to the recorded value. Sample
+ * data is not read. Returns 1 if the bank matches, 0 if not.
+ */
+int sf2_bank_matches(const SF2BankHeader* header, const void* soundfont, size_t size);
+
+/* Preset and zone tables of a validated bank */
+static inline const SF2BankPreset* sf2_bank_presets(const SF2BankHeader* header) {
+    return (const SF2BankPreset*)((const uint8_t*)header + header->preset_offset);
+}
+
+static inline const SF2BankZone* sf2_bank_zones(const SF2BankHeader* header) {
+    return (const SF2BankZone*)((const uint8_t*)header + header->zone_offset);
+}
+
+#endif
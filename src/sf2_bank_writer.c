@@ -0,0 +1,187 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Bank Writer (sf2_bank_writer.c)
+ *
+ * This module:
+ * 1. Flattens the zones of every preset with the streaming parser
+ * 2. Maps each zone to the byte range of its sample data
+ * 3. Hashes the SoundFont's pdta list so the plugin can tell whether the
+ *    bank still describes the SoundFont next to it
+ * 4. Writes the header, preset table and zone table, each aligned to a
+ *    cache line, and checksums them
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "sf2_bank_writer.h"
+#include "sf2_bank.h"
+#include "content_hash.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Buffer size for hashing the pdta list
+#define PDTA_READ_SIZE (1 << 16)
+
+/* Pad the file with zeros up to the given offset */
+static int pad_to(FILE* f, uint64_t offset) {
+    static const char zeros[SF2_BANK_ALIGN];
+    long long position = (long long)ftello(f);
+    while (position >= 0 && (uint64_t)position < offset) {
+        size_t count = (size_t)(offset - (uint64_t)position);
+        if (count > sizeof(zeros)) count = sizeof(zeros);
+        if (fwrite(zeros, 1, count, f) != count) {
+            return -1;
+        }
+        position += (long long)count;
+    }
+    return position < 0 ? -1 : 0;
+}
+
+/*
+ * Locate the pdta list from the sub-chunks the parser recorded: from the
+ * header of the first one to the end of the last one.
+ */
+static void pdta_range(const SF2File* sf, uint64_t* offset, uint64_t* size) {
+    const SF2Chunk* chunks[] = {&sf->phdr, &sf->pbag, &sf->pmod, &sf->pgen, &sf->inst,
+                                &sf->ibag, &sf->imod, &sf->igen, &sf->shdr};
+    int64_t first = sf->file_size;
+    int64_t last = 0;
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        if (chunks[i]->offset >= 8 && chunks[i]->offset - 8 < first) first = chunks[i]->offset - 8;
+        if (chunks[i]->offset + chunks[i]->size > last) last = chunks[i]->offset + chunks[i]->size;
+    }
+    *offset = first < last ? (uint64_t)first : 0;
+    *size = first < last ? (uint64_t)(last - first) : 0;
+}
+
+/* Hash a byte range of the SoundFont, the same way sf2_bank_matches does */
+static int hash_range(SF2File* sf, uint64_t offset, uint64_t size, uint64_t* hash_out) {
+    char* buffer = (char*)malloc(PDTA_READ_SIZE);
+    if (!buffer || fseeko(sf->file, (off_t)offset, SEEK_SET) != 0) {
+        free(buffer);
+        return -1;
+    }
+
+    ContentHash hash;
+    content_hash_init(&hash);
+    uint64_t remaining = size;
+    while (remaining > 0) {
+        size_t count = remaining > PDTA_READ_SIZE ? PDTA_READ_SIZE : (size_t)remaining;
+        if (fread(buffer, 1, count, sf->file) != count) {
+            free(buffer);
+            return -1;
+        }
+        content_hash_update(&hash, buffer, count);
+        remaining -= count;
+    }
+
+    free(buffer);
+    *hash_out = content_hash_final(&hash);
+    return 0;
+}
+
+int sf2_bank_write(SF2File* sf, const SF2Preset* presets, int preset_count,
+                   const char* path, FILE* log) {
+    SF2Zone* zones = NULL;
+    SF2Sample* samples = NULL;
+    int zone_count = sf2_read_zones(sf, presets, preset_count, &zones);
+    int sample_count = zone_count >= 0 ? sf2_read_samples(sf, &samples) : -1;
+    if (zone_count < 0 || sample_count < 0) {
+        fprintf(log, "Failed to read zones for sample bank\n");
+        free(zones);
+        free(samples);
+        return -1;
+    }
+
+    SF2BankPreset* bank_presets = (SF2BankPreset*)calloc(preset_count > 0 ? preset_count : 1, sizeof(SF2BankPreset));
+    SF2BankZone* bank_zones = (SF2BankZone*)calloc(zone_count > 0 ? zone_count : 1, sizeof(SF2BankZone));
+    if (!bank_presets || !bank_zones) {
+        fprintf(log, "Failed to allocate sample bank tables\n");
+        free(bank_presets); free(bank_zones); free(zones); free(samples);
+        return -1;
+    }
+
+    // Zones come back grouped by preset, so each preset owns one contiguous run
+    int z = 0;
+    for (int p = 0; p < preset_count; p++) {
+        SF2BankPreset* preset = &bank_presets[p];
+        preset->bank = (uint16_t)presets[p].bank;
+        preset->prog = (uint16_t)presets[p].prog;
+        snprintf(preset->name, sizeof(preset->name), "%s", presets[p].name);
+        preset->zone_start = (uint32_t)z;
+        while (z < zone_count && zones[z].preset == p) {
+            const SF2Sample* sample = &samples[zones[z].sample];
+            SF2BankZone* zone = &bank_zones[z];
+            zone->key_lo = zones[z].key_lo;
+            zone->key_hi = zones[z].key_hi;
+            zone->vel_lo = zones[z].vel_lo;
+            zone->vel_hi = zones[z].vel_hi;
+            zone->sample = (uint32_t)zones[z].sample;
+            zone->loop_mode = zones[z].loop_mode;
+
+            // Sample points are 16 bit; clamp headers that point past the smpl chunk
+            uint64_t start = (uint64_t)sample->start * 2;
+            uint64_t end = (uint64_t)sample->end * 2;
+            if (end > sf->smpl.size) end = sf->smpl.size;
+            if (start > end) start = end;
+            zone->data_offset = (uint64_t)sf->smpl.offset + start;
+            zone->data_size = (uint32_t)(end - start);
+            z++;
+        }
+        preset->zone_count = (uint32_t)z - preset->zone_start;
+    }
+
+    SF2BankHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SF2_BANK_MAGIC, sizeof(header.magic));
+    header.version = SF2_BANK_VERSION;
+    header.byte_order = SF2_BANK_BYTE_ORDER;
+    header.header_size = sizeof(SF2BankHeader);
+    header.preset_count = (uint32_t)preset_count;
+    header.zone_count = (uint32_t)zone_count;
+    header.sample_count = (uint32_t)sample_count;
+    // FluidSynth, like sf2_writer and sf2_dedup, ignores an sm24 chunk shorter than smpl's points
+    int has_sm24 = sf->smpl.size >= 2 && sf->sm24.size >= sf->smpl.size / 2;
+    header.flags = has_sm24 ? SF2_BANK_SM24 : 0;
+    header.preset_offset = sf2_bank_align(sizeof(SF2BankHeader));
+    header.zone_offset = sf2_bank_align(header.preset_offset + (uint64_t)preset_count * sizeof(SF2BankPreset));
+    header.source_size = (uint64_t)sf->file_size;
+    header.sample_data_size = (uint64_t)sf->smpl.size + (has_sm24 ? sf->sm24.size : 0);
+    pdta_range(sf, &header.pdta_offset, &header.pdta_size);
+    if (hash_range(sf, header.pdta_offset, header.pdta_size, &header.pdta_hash) != 0) {
+        fprintf(log, "Failed to read the preset data of the SoundFont\n");
+        free(bank_presets); free(bank_zones); free(zones); free(samples);
+        return -1;
+    }
+    header.checksum = sf2_bank_checksum(&header, bank_presets, bank_zones);
+
+    int status = -1;
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        fprintf(log, "Failed to create sample bank '%s': %s\n", path, strerror(errno));
+    } else {
+        if (fwrite(&header, sizeof(header), 1, out) == 1 &&
+            pad_to(out, header.preset_offset) == 0 &&
+            fwrite(bank_presets, sizeof(SF2BankPreset), preset_count, out) == (size_t)preset_count &&
+            pad_to(out, header.zone_offset) == 0 &&
+            fwrite(bank_zones, sizeof(SF2BankZone), zone_count, out) == (size_t)zone_count) {
+            status = 0;
+        }
+        if (fclose(out) != 0) {
+            status = -1;
+        }
+        if (status != 0) {
+            fprintf(log, "Failed to write sample bank '%s'\n", path);
+            remove(path);
+        }
+    }
+
+    free(bank_presets);
+    free(bank_zones);
+    free(zones);
+    free(samples);
+    return status == 0 ? zone_count : -1;
+}
@@ -0,0 +1,24 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Bank Writer (sf2_bank_writer.h)
+ *
+ * Builds the preprocessed bank described in sf2_bank.h from a SoundFont
+ * opened with the streaming parser.
+ */
+
+#ifndef SF2_BANK_WRITER_H
+#define SF2_BANK_WRITER_H
+
+#include "sf2_parser.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Write a bank for the given presets (in Program port order) to path.
+ * Returns the number of zones written, or -1 on failure.
+ */
+int sf2_bank_write(SF2File* sf, const SF2Preset* presets, int preset_count,
+                   const char* path, FILE* log);
+
+#endif
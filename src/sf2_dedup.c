@@ -0,0 +1,225 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Deduplication (sf2_dedup.c)
+ *
+ * This module:
+ * 1. Hashes and compares sample data ranges of an open SoundFont
+ * 2. Digests every sample of a SoundFont
+ * 3. Groups the digests of several SoundFonts to report shared data
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "sf2_dedup.h"
+#include "content_hash.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Sample points read at a time
+#define DIGEST_CHUNK_POINTS 65536
+
+/* One sample of one file in the cross-file report */
+typedef struct {
+    uint64_t hash;      // Digest hash
+    uint32_t points;    // Digest length
+    int file;           // Index into the path list
+    int64_t bytes;      // smpl and sm24 bytes
+} DigestEntry;
+
+/* Check whether the SoundFont stores 24 bit samples */
+static int has_sm24(const SF2File* sf) {
+    uint32_t points = sf->smpl.size / 2;
+    return points > 0 && sf->sm24.size >= points;
+}
+
+/* Read count bytes at offset into buffer */
+static int read_at(SF2File* sf, int64_t offset, void* buffer, size_t count) {
+    return fseeko(sf->file, (off_t)offset, SEEK_SET) == 0 && fread(buffer, 1, count, sf->file) == count ? 0 : -1;
+}
+
+int sf2_hash_sample_data(SF2File* sf, uint32_t start, uint32_t end, uint64_t* hash_out) {
+    uint8_t* buffer = (uint8_t*)malloc(DIGEST_CHUNK_POINTS * 2);
+    if (!buffer) {
+        return -1;
+    }
+
+    // The 16 bit points first, then their low bytes
+    ContentHash hash;
+    content_hash_init(&hash);
+    int status = 0;
+    for (uint32_t at = start; status == 0 && at < end; at += DIGEST_CHUNK_POINTS) {
+        uint32_t n = end - at < DIGEST_CHUNK_POINTS ? end - at : DIGEST_CHUNK_POINTS;
+        status = read_at(sf, sf->smpl.offset + (int64_t)at * 2, buffer, (size_t)n * 2);
+        content_hash_update(&hash, buffer, (size_t)n * 2);
+    }
+    for (uint32_t at = start; status == 0 && has_sm24(sf) && at < end; at += DIGEST_CHUNK_POINTS) {
+        uint32_t n = end - at < DIGEST_CHUNK_POINTS ? end - at : DIGEST_CHUNK_POINTS;
+        status = read_at(sf, sf->sm24.offset + at, buffer, n);
+        content_hash_update(&hash, buffer, n);
+    }
+    free(buffer);
+    *hash_out = content_hash_final(&hash);
+    return status;
+}
+
+int sf2_same_sample_data(SF2File* sf, uint32_t a, uint32_t b, uint32_t points) {
+    uint8_t* first = (uint8_t*)malloc(DIGEST_CHUNK_POINTS * 2);
+    uint8_t* second = (uint8_t*)malloc(DIGEST_CHUNK_POINTS * 2);
+    if (!first || !second) {
+        free(first);
+        free(second);
+        return -1;
+    }
+
+    int result = 1;
+    for (uint32_t done = 0; result == 1 && done < points; done += DIGEST_CHUNK_POINTS) {
+        uint32_t n = points - done < DIGEST_CHUNK_POINTS ? points - done : DIGEST_CHUNK_POINTS;
+        if (read_at(sf, sf->smpl.offset + (int64_t)(a + done) * 2, first, (size_t)n * 2) != 0 ||
+            read_at(sf, sf->smpl.offset + (int64_t)(b + done) * 2, second, (size_t)n * 2) != 0) {
+            result = -1;
+        } else if (memcmp(first, second, (size_t)n * 2) != 0) {
+            result = 0;
+        } else if (has_sm24(sf)) {
+            if (read_at(sf, sf->sm24.offset + a + done, first, n) != 0 ||
+                read_at(sf, sf->sm24.offset + b + done, second, n) != 0) {
+                result = -1;
+            } else if (memcmp(first, second, n) != 0) {
+                result = 0;
+            }
+        }
+    }
+    free(first);
+    free(second);
+    return result;
+}
+
+int sf2_digest_samples(SF2File* sf, SF2SampleDigest** digests_out) {
+    *digests_out = NULL;
+
+    SF2Sample* samples = NULL;
+    int count = sf2_read_samples(sf, &samples);
+    if (count < 0) {
+        return -1;
+    }
+    SF2SampleDigest* digests = (SF2SampleDigest*)calloc(count > 0 ? count : 1, sizeof(SF2SampleDigest));
+    if (!digests) {
+        free(samples);
+        return -1;
+    }
+
+    uint32_t smpl_points = sf->smpl.size / 2;
+    for (int i = 0; i < count; i++) {
+        uint32_t end = samples[i].end < smpl_points ? samples[i].end : smpl_points;
+        uint32_t start = samples[i].start < end ? samples[i].start : end;
+        memcpy(digests[i].name, samples[i].name, sizeof(digests[i].name));
+        digests[i].points = end - start;
+        digests[i].bytes = (int64_t)(end - start) * (has_sm24(sf) ? 3 : 2);
+        if (sf2_hash_sample_data(sf, start, end, &digests[i].hash) != 0) {
+            free(digests);
+            free(samples);
+            return -1;
+        }
+    }
+    free(samples);
+    *digests_out = digests;
+    return count;
+}
+
+/* Check whether two entries hold the same data */
+static int same_content(const DigestEntry* a, const DigestEntry* b) {
+    return a->hash == b->hash && a->points == b->points && a->bytes == b->bytes;
+}
+
+/* Order entries by content, then by file so the earliest file comes first */
+static int compare_entries(const void* a, const void* b) {
+    const DigestEntry* x = (const DigestEntry*)a;
+    const DigestEntry* y = (const DigestEntry*)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->points != y->points) return x->points < y->points ? -1 : 1;
+    if (x->bytes != y->bytes) return x->bytes < y->bytes ? -1 : 1;
+    return x->file - y->file;
+}
+
+int sf2_dedup_report(char* const* paths, int count, FILE* out) {
+    DigestEntry* entries = NULL;
+    int entry_count = 0;
+    int* sample_counts = (int*)calloc(count > 0 ? count : 1, sizeof(int));
+    int64_t* file_bytes = (int64_t*)calloc(count > 0 ? count : 1, sizeof(int64_t));
+    int64_t* own_duplicates = (int64_t*)calloc(count > 0 ? count : 1, sizeof(int64_t));
+    int64_t* earlier_duplicates = (int64_t*)calloc(count > 0 ? count : 1, sizeof(int64_t));
+    if (!sample_counts || !file_bytes || !own_duplicates || !earlier_duplicates) {
+        fprintf(out, "Failed to allocate deduplication report\n");
+        free(sample_counts); free(file_bytes); free(own_duplicates); free(earlier_duplicates);
+        return -1;
+    }
+
+    // Digest every sample of every file
+    int status = 0;
+    for (int f = 0; f < count && status == 0; f++) {
+        SF2File sf;
+        SF2SampleDigest* digests = NULL;
+        int n = -1;
+        if (sf2_open(&sf, paths[f]) == 0) {
+            n = sf2_digest_samples(&sf, &digests);
+            sf2_close(&sf);
+        }
+        DigestEntry* grown = n >= 0 ? (DigestEntry*)realloc(entries, (entry_count + n + 1) * sizeof(DigestEntry)) : NULL;
+        if (!grown) {
+            fprintf(out, "Failed to read samples of %s\n", paths[f]);
+            free(digests);
+            status = -1;
+            break;
+        }
+        entries = grown;
+        for (int i = 0; i < n; i++) {
+            DigestEntry* entry = &entries[entry_count++];
+            entry->hash = digests[i].hash;
+            entry->points = digests[i].points;
+            entry->file = f;
+            entry->bytes = digests[i].bytes;
+            file_bytes[f] += digests[i].bytes;
+        }
+        sample_counts[f] = n;
+        free(digests);
+    }
+
+    if (status == 0) {
+        // Every entry after the first of its group is a duplicate, of its own
+        // file if the previous entry is from the same file, else of an earlier one
+        qsort(entries, entry_count, sizeof(DigestEntry), compare_entries);
+        int64_t total = 0, distinct = 0;
+        for (int i = 0; i < entry_count; i++) {
+            const DigestEntry* entry = &entries[i];
+            total += entry->bytes;
+            if (i == 0 || !same_content(&entries[i - 1], entry)) {
+                distinct += entry->bytes;
+            } else if (entries[i - 1].file == entry->file) {
+                own_duplicates[entry->file] += entry->bytes;
+            } else {
+                earlier_duplicates[entry->file] += entry->bytes;
+            }
+        }
+
+        char size_text[32], own_text[32], earlier_text[32];
+        fprintf(out, "%-32s %8s %10s %12s %14s\n", "SoundFont", "samples", "data", "in file", "earlier files");
+        for (int f = 0; f < count; f++) {
+            const char* name = strrchr(paths[f], '/');
+            fprintf(out, "%-32s %8d %10s %12s %14s\n", name ? name + 1 : paths[f], sample_counts[f],
+                    format_bytes(file_bytes[f], size_text, sizeof(size_text)),
+                    format_bytes(own_duplicates[f], own_text, sizeof(own_text)),
+                    format_bytes(earlier_duplicates[f], earlier_text, sizeof(earlier_text)));
+        }
+        fprintf(out, "Total: %s of sample data, %s distinct (%.2fx, %s duplicated)\n",
+                format_bytes(total, size_text, sizeof(size_text)),
+                format_bytes(distinct, own_text, sizeof(own_text)),
+                distinct > 0 ? (double)total / distinct : 1.0,
+                format_bytes(total - distinct, earlier_text, sizeof(earlier_text)));
+    }
+
+    free(entries);
+    free(sample_counts); free(file_bytes); free(own_duplicates); free(earlier_duplicates);
+    return status;
+}
@@ -0,0 +1,57 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Deduplication (sf2_dedup.h)
+ *
+ * Finds sample data that is stored more than once. A sample's digest is the
+ * content hash of its 16 bit points and, if the SoundFont has them, their
+ * sm24 low bytes, so samples are equal when they sound the same regardless
+ * of their names, loop points or rates. The writer uses the digests to store
+ * each distinct sample once within a SoundFont; the report compares the
+ * samples of several SoundFonts.
+ */
+
+#ifndef SF2_DEDUP_H
+#define SF2_DEDUP_H
+
+#include "sf2_parser.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Content digest of the data of one sample */
+typedef struct {
+    char name[SF2_NAME_LEN + 1];    // Sample name
+    uint64_t hash;                  // Content hash of the points and their low bytes
+    uint32_t points;                // Length in sample points
+    int64_t bytes;                  // smpl and sm24 bytes
+} SF2SampleDigest;
+
+/*
+ * Hash the sample data between two points of smpl (and the matching sm24
+ * bytes, if present). Returns 0 on success, -1 if the data cannot be read.
+ */
+int sf2_hash_sample_data(SF2File* sf, uint32_t start, uint32_t end, uint64_t* hash_out);
+
+/*
+ * Compare the sample data starting at two points of smpl over the given
+ * number of points, byte for byte. Used to confirm a hash match.
+ * Returns 1 if equal, 0 if different, -1 if the data cannot be read.
+ */
+int sf2_same_sample_data(SF2File* sf, uint32_t a, uint32_t b, uint32_t points);
+
+/*
+ * Digest the data of every sample, excluding the terminal "EOS" record.
+ * The returned array must be released with free().
+ * Returns the number of samples, or -1 on error.
+ */
+int sf2_digest_samples(SF2File* sf, SF2SampleDigest** digests_out);
+
+/*
+ * Print how much sample data the given SoundFonts share: per file the
+ * duplicates within it and the data already present in an earlier file, and
+ * in total the distinct sample data and the resulting deduplication ratio.
+ * Matches are by digest only. Returns 0 on success, -1 if a file cannot be read.
+ */
+int sf2_dedup_report(char* const* paths, int count, FILE* out);
+
+#endif
@@ -0,0 +1,464 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Streaming SoundFont Parser (sf2_parser.c)
+ *
+ * This module:
+ * 1. Walks the RIFF chunk tree of a SoundFont using seeks only
+ * 2. Records the offset and size of the sdta and pdta sub-chunks
+ * 3. Reads preset headers without touching the sample data
+ * 4. Flattens preset and instrument zones into key/velocity ranges per sample
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "sf2_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+
+/* Read a little endian 32 bit value from a byte buffer */
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Read a little endian 16 bit value from a byte buffer */
+static uint16_t read_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/* Read an 8 byte chunk header (four character id + size) at the current position */
+static int read_chunk_header(FILE* f, char id[5], uint32_t* size) {
+    uint8_t header[8];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header)) {
+        return -1;
+    }
+    memcpy(id, header, 4);
+    id[4] = '\0';
+    *size = read_u32(header + 4);
+    return 0;
+}
+
+/* Read a four character list type at the current position */
+static int read_fourcc(FILE* f, char id[5]) {
+    if (fread(id, 1, 4, f) != 4) {
+        return -1;
+    }
+    id[4] = '\0';
+    return 0;
+}
+
+/*
+ * Walk the sub-chunks of a LIST chunk and record the ones we know about.
+ * Only chunk headers are read, the chunk bodies are skipped with fseeko().
+ */
+static int scan_list(SF2File* sf, const char* list_type, int64_t start, int64_t end) {
+    int64_t pos = start;
+
+    while (pos + 8 <= end) {
+        char id[5];
+        uint32_t size;
+
+        if (fseeko(sf->file, (off_t)pos, SEEK_SET) != 0 ||
+            read_chunk_header(sf->file, id, &size) != 0) {
+            return -1;
+        }
+
+        int64_t data = pos + 8;
+        if (data + size > end) {
+            fprintf(stderr, "Truncated '%s' chunk in %s list\n", id, list_type);
+            return -1;
+        }
+
+        SF2Chunk chunk = { data, size };
+        if (!strcmp(list_type, "sdta")) {
+            if (!strcmp(id, "smpl")) sf->smpl = chunk;
+            else if (!strcmp(id, "sm24")) sf->sm24 = chunk;
+        } else if (!strcmp(list_type, "pdta")) {
+            if (!strcmp(id, "phdr")) sf->phdr = chunk;
+            else if (!strcmp(id, "pbag")) sf->pbag = chunk;
+            else if (!strcmp(id, "pmod")) sf->pmod = chunk;
+            else if (!strcmp(id, "pgen")) sf->pgen = chunk;
+            else if (!strcmp(id, "inst")) sf->inst = chunk;
+            else if (!strcmp(id, "ibag")) sf->ibag = chunk;
+            else if (!strcmp(id, "imod")) sf->imod = chunk;
+            else if (!strcmp(id, "igen")) sf->igen = chunk;
+            else if (!strcmp(id, "shdr")) sf->shdr = chunk;
+        }
+
+        // RIFF chunks are padded to an even number of bytes
+        pos = data + size + (size & 1);
+    }
+
+    return 0;
+}
+
+int sf2_open(SF2File* sf, const char* path) {
+    memset(sf, 0, sizeof(*sf));
+
+    sf->file = fopen(path, "rb");
+    if (!sf->file) {
+        perror("Failed to open SoundFont");
+        return -1;
+    }
+
+    // Determine the file size so chunk sizes can be validated
+    if (fseeko(sf->file, 0, SEEK_END) != 0) {
+        perror("Failed to seek SoundFont");
+        sf2_close(sf);
+        return -1;
+    }
+    sf->file_size = (int64_t)ftello(sf->file);
+    rewind(sf->file);
+
+    // Check the RIFF header and the sfbk form type
+    char id[5], form[5];
+    uint32_t riff_size;
+    if (read_chunk_header(sf->file, id, &riff_size) != 0 ||
+        read_fourcc(sf->file, form) != 0 ||
+        strcmp(id, "RIFF") != 0 || strcmp(form, "sfbk") != 0) {
+        fprintf(stderr, "Not a SoundFont 2 file: %s\n", path);
+        sf2_close(sf);
+        return -1;
+    }
+
+    // Clamp to the real file size in case the header overstates it
+    int64_t riff_end = 8 + (int64_t)riff_size;
+    if (riff_end > sf->file_size) {
+        riff_end = sf->file_size;
+    }
+
+    // Walk the top level LIST chunks (INFO, sdta, pdta)
+    int64_t pos = 12;
+    while (pos + 12 <= riff_end) {
+        uint32_t size;
+        char list_type[5];
+
+        if (fseeko(sf->file, (off_t)pos, SEEK_SET) != 0 ||
+            read_chunk_header(sf->file, id, &size) != 0) {
+            break;
+        }
+
+        if (!strcmp(id, "LIST")) {
+            if (read_fourcc(sf->file, list_type) != 0) {
+                break;
+            }
+            int64_t list_end = pos + 8 + size;
+            if (list_end > riff_end) {
+                list_end = riff_end;
+            }
+            if (!strcmp(list_type, "INFO")) {
+                sf->info.offset = pos + 12;
+                sf->info.size = (uint32_t)(list_end - (pos + 12));
+            }
+            if (scan_list(sf, list_type, pos + 12, list_end) != 0) {
+                fprintf(stderr, "Malformed '%s' list in %s\n", list_type, path);
+                sf2_close(sf);
+                return -1;
+            }
+        }
+
+        pos += 8 + (int64_t)size + (size & 1);
+    }
+
+    if (sf->phdr.size < SF2_PHDR_SIZE) {
+        fprintf(stderr, "SoundFont has no preset headers: %s\n", path);
+        sf2_close(sf);
+        return -1;
+    }
+
+    return 0;
+}
+
+void sf2_close(SF2File* sf) {
+    if (sf->file) {
+        fclose(sf->file);
+        sf->file = NULL;
+    }
+}
+
+/* Order presets by bank, then program, keeping file order for equal pairs */
+static int compare_presets(const void* a, const void* b) {
+    const SF2Preset* pa = (const SF2Preset*)a;
+    const SF2Preset* pb = (const SF2Preset*)b;
+    if (pa->bank != pb->bank) return pa->bank - pb->bank;
+    if (pa->prog != pb->prog) return pa->prog - pb->prog;
+    return pa->index - pb->index;
+}
+
+int sf2_read_presets(SF2File* sf, SF2Preset** presets_out) {
+    // The last record is the terminal "EOP" entry and is not a real preset
+    int record_count = (int)(sf->phdr.size / SF2_PHDR_SIZE);
+    int header_count = record_count - 1;
+    *presets_out = NULL;
+
+    SF2Preset* presets = (SF2Preset*)calloc(header_count > 0 ? header_count : 1, sizeof(SF2Preset));
+    if (!presets) {
+        fprintf(stderr, "Failed to allocate preset table\n");
+        return -1;
+    }
+
+    if (fseeko(sf->file, (off_t)sf->phdr.offset, SEEK_SET) != 0) {
+        perror("Failed to seek to preset headers");
+        free(presets);
+        return -1;
+    }
+
+    // Read every record including the terminal one, which closes the last zone range
+    int count = 0;
+    int prev_valid = 0;
+    for (int i = 0; i < record_count; i++) {
+        uint8_t record[SF2_PHDR_SIZE];
+        if (fread(record, 1, sizeof(record), sf->file) != sizeof(record)) {
+            fprintf(stderr, "Truncated preset header chunk\n");
+            free(presets);
+            return -1;
+        }
+
+        int prog = read_u16(record + 20);
+        int bank = read_u16(record + 22);
+        int bag = read_u16(record + 24);
+
+        // Close the zone range of the previous preset
+        if (prev_valid) {
+            presets[count - 1].bag_end = bag;
+        }
+        prev_valid = 0;
+
+        // Skip the terminal record and presets FluidSynth does not expose
+        if (i == header_count || bank > 128 || prog > 127) {
+            continue;
+        }
+
+        SF2Preset* preset = &presets[count++];
+        memcpy(preset->name, record, SF2_NAME_LEN);
+        preset->name[SF2_NAME_LEN] = '\0';
+        preset->bank = bank;
+        preset->prog = prog;
+        preset->index = i;
+        preset->bag_start = bag;
+        preset->bag_end = bag;
+        prev_valid = 1;
+    }
+
+    // Sort into bank/program order and drop duplicate bank/program pairs
+    qsort(presets, count, sizeof(SF2Preset), compare_presets);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique > 0 &&
+            presets[unique - 1].bank == presets[i].bank &&
+            presets[unique - 1].prog == presets[i].prog) {
+            continue;
+        }
+        presets[unique++] = presets[i];
+    }
+
+    *presets_out = presets;
+    return unique;
+}
+
+uint8_t* sf2_read_chunk(SF2File* sf, const SF2Chunk* chunk, const char* name) {
+    uint8_t* data = (uint8_t*)malloc(chunk->size > 0 ? chunk->size : 1);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate '%s' chunk\n", name);
+        return NULL;
+    }
+    if (chunk->size > 0 &&
+        (fseeko(sf->file, (off_t)chunk->offset, SEEK_SET) != 0 ||
+         fread(data, 1, chunk->size, sf->file) != chunk->size)) {
+        fprintf(stderr, "Failed to read '%s' chunk\n", name);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+int sf2_read_samples(SF2File* sf, SF2Sample** samples_out) {
+    *samples_out = NULL;
+    int count = (int)(sf->shdr.size / SF2_SHDR_SIZE) - 1;
+    if (count < 0) {
+        count = 0;
+    }
+
+    uint8_t* shdr = sf2_read_chunk(sf, &sf->shdr, "shdr");
+    if (!shdr) {
+        return -1;
+    }
+
+    SF2Sample* samples = (SF2Sample*)calloc(count > 0 ? count : 1, sizeof(SF2Sample));
+    if (!samples) {
+        fprintf(stderr, "Failed to allocate sample table\n");
+        free(shdr);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t* record = shdr + i * SF2_SHDR_SIZE;
+        SF2Sample* sample = &samples[i];
+        memcpy(sample->name, record, SF2_NAME_LEN);
+        sample->name[SF2_NAME_LEN] = '\0';
+        sample->start = read_u32(record + 20);
+        sample->end = read_u32(record + 24);
+        sample->loop_start = read_u32(record + 28);
+        sample->loop_end = read_u32(record + 32);
+        sample->rate = read_u32(record + 36);
+        sample->original_pitch = record[40];
+        sample->pitch_correction = (int8_t)record[41];
+        sample->link = read_u16(record + 42);
+        sample->type = read_u16(record + 44);
+    }
+
+    free(shdr);
+    *samples_out = samples;
+    return count;
+}
+
+/* Generator values of one zone, starting from the defaults of its global zone */
+typedef struct {
+    int key_lo, key_hi;     // Key range
+    int vel_lo, vel_hi;     // Velocity range
+    int target;             // Instrument or sample index, -1 when absent
+    int loop_mode;          // sampleModes value
+} ZoneValues;
+
+/*
+ * Apply the generators of one bag to a set of zone values.
+ * target_oper is the generator that ends the zone (instrument or sampleID).
+ */
+static void read_zone_values(const uint8_t* bags, int bag, const uint8_t* gens, int gen_count,
+                             int target_oper, ZoneValues* values) {
+    int gen_start = read_u16(bags + bag * SF2_BAG_SIZE);
+    int gen_end = read_u16(bags + (bag + 1) * SF2_BAG_SIZE);
+    if (gen_end > gen_count) {
+        gen_end = gen_count;
+    }
+
+    for (int g = gen_start; g < gen_end; g++) {
+        const uint8_t* gen = gens + g * SF2_GEN_SIZE;
+        int oper = read_u16(gen);
+        if (oper == SF2_GEN_KEY_RANGE) {
+            values->key_lo = gen[2];
+            values->key_hi = gen[3];
+        } else if (oper == SF2_GEN_VEL_RANGE) {
+            values->vel_lo = gen[2];
+            values->vel_hi = gen[3];
+        } else if (oper == SF2_GEN_SAMPLE_MODES) {
+            values->loop_mode = read_u16(gen + 2) & 3;
+        } else if (oper == target_oper) {
+            values->target = read_u16(gen + 2);
+        }
+    }
+}
+
+/* Append a zone to a growing array. Returns 0 on success */
+static int append_zone(SF2Zone** zones, int* count, int* capacity, const SF2Zone* zone) {
+    if (*count == *capacity) {
+        int grown_capacity = *capacity ? *capacity * 2 : 256;
+        SF2Zone* grown = (SF2Zone*)realloc(*zones, grown_capacity * sizeof(SF2Zone));
+        if (!grown) {
+            fprintf(stderr, "Failed to allocate zone table\n");
+            return -1;
+        }
+        *zones = grown;
+        *capacity = grown_capacity;
+    }
+    (*zones)[(*count)++] = *zone;
+    return 0;
+}
+
+int sf2_read_zones(SF2File* sf, const SF2Preset* presets, int preset_count, SF2Zone** zones_out) {
+    *zones_out = NULL;
+
+    uint8_t* pbag = sf2_read_chunk(sf, &sf->pbag, "pbag");
+    uint8_t* pgen = sf2_read_chunk(sf, &sf->pgen, "pgen");
+    uint8_t* inst = sf2_read_chunk(sf, &sf->inst, "inst");
+    uint8_t* ibag = sf2_read_chunk(sf, &sf->ibag, "ibag");
+    uint8_t* igen = sf2_read_chunk(sf, &sf->igen, "igen");
+    if (!pbag || !pgen || !inst || !ibag || !igen) {
+        free(pbag); free(pgen); free(inst); free(ibag); free(igen);
+        return -1;
+    }
+
+    // Every list ends with a terminal record that only closes the previous range
+    int pbag_count = (int)(sf->pbag.size / SF2_BAG_SIZE) - 1;
+    int pgen_count = (int)(sf->pgen.size / SF2_GEN_SIZE);
+    int inst_count = (int)(sf->inst.size / SF2_INST_SIZE) - 1;
+    int ibag_count = (int)(sf->ibag.size / SF2_BAG_SIZE) - 1;
+    int igen_count = (int)(sf->igen.size / SF2_GEN_SIZE);
+    int sample_count = (int)(sf->shdr.size / SF2_SHDR_SIZE) - 1;
+
+    SF2Zone* zones = NULL;
+    int count = 0, capacity = 0;
+    int status = 0;
+
+    for (int p = 0; p < preset_count && status == 0; p++) {
+        ZoneValues preset_global = { 0, 127, 0, 127, -1, 0 };
+
+        for (int pb = presets[p].bag_start; pb < presets[p].bag_end && pb < pbag_count && status == 0; pb++) {
+            ZoneValues pzone = preset_global;
+            pzone.target = -1;
+            read_zone_values(pbag, pb, pgen, pgen_count, SF2_GEN_INSTRUMENT, &pzone);
+
+            // A first zone without an instrument is the global zone
+            if (pzone.target < 0) {
+                if (pb == presets[p].bag_start) {
+                    preset_global = pzone;
+                }
+                continue;
+            }
+            if (pzone.target >= inst_count) {
+                continue;
+            }
+
+            int ib_start = read_u16(inst + pzone.target * SF2_INST_SIZE + 20);
+            int ib_end = read_u16(inst + (pzone.target + 1) * SF2_INST_SIZE + 20);
+            ZoneValues inst_global = { 0, 127, 0, 127, -1, 0 };
+
+            for (int ib = ib_start; ib < ib_end && ib < ibag_count; ib++) {
+                ZoneValues izone = inst_global;
+                izone.target = -1;
+                read_zone_values(ibag, ib, igen, igen_count, SF2_GEN_SAMPLE_ID, &izone);
+
+                if (izone.target < 0) {
+                    if (ib == ib_start) {
+                        inst_global = izone;
+                    }
+                    continue;
+                }
+                if (izone.target >= sample_count) {
+                    continue;
+                }
+
+                // A note must fall inside both the preset and the instrument zone
+                SF2Zone zone;
+                zone.preset = p;
+                zone.instrument = pzone.target;
+                zone.sample = izone.target;
+                zone.key_lo = (uint8_t)(izone.key_lo > pzone.key_lo ? izone.key_lo : pzone.key_lo);
+                zone.key_hi = (uint8_t)(izone.key_hi < pzone.key_hi ? izone.key_hi : pzone.key_hi);
+                zone.vel_lo = (uint8_t)(izone.vel_lo > pzone.vel_lo ? izone.vel_lo : pzone.vel_lo);
+                zone.vel_hi = (uint8_t)(izone.vel_hi < pzone.vel_hi ? izone.vel_hi : pzone.vel_hi);
+                zone.loop_mode = (uint8_t)izone.loop_mode;
+                if (zone.key_lo > zone.key_hi || zone.vel_lo > zone.vel_hi) {
+                    continue;
+                }
+
+                if (append_zone(&zones, &count, &capacity, &zone) != 0) {
+                    status = -1;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(pbag); free(pgen); free(inst); free(ibag); free(igen);
+    if (status != 0) {
+        free(zones);
+        return -1;
+    }
+
+    *zones_out = zones;
+    return count;
+}
@@ -0,0 +1,154 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Streaming SoundFont Parser (sf2_parser.h)
+ *
+ * A small standalone SoundFont 2 reader that walks the RIFF structure with
+ * seeks instead of reading the whole file. Only the chunk headers and the
+ * preset data (pdta) records are read; the sample data (sdta) chunk is
+ * located but never loaded, so memory use does not depend on the size of
+ * the SoundFont.
+ */
+
+#ifndef SF2_PARSER_H
+#define SF2_PARSER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Preset and instrument names are stored as 20 byte, zero padded strings
+#define SF2_NAME_LEN 20
+
+// Size of one record in each of the pdta sub-chunks
+#define SF2_PHDR_SIZE 38
+#define SF2_BAG_SIZE 4
+#define SF2_MOD_SIZE 10
+#define SF2_GEN_SIZE 4
+#define SF2_INST_SIZE 22
+#define SF2_SHDR_SIZE 46
+
+// Generator operators that link or bound zones
+#define SF2_GEN_INSTRUMENT 41
+#define SF2_GEN_KEY_RANGE 43
+#define SF2_GEN_VEL_RANGE 44
+#define SF2_GEN_SAMPLE_ID 53
+#define SF2_GEN_SAMPLE_MODES 54
+
+// Zero sample points required after every sample in smpl
+#define SF2_SAMPLE_PADDING 46
+
+/* Location of a RIFF chunk inside the SoundFont file */
+typedef struct {
+    int64_t offset;     // File offset of the chunk data (after the 8 byte header)
+    uint32_t size;      // Size of the chunk data in bytes
+} SF2Chunk;
+
+/* An open SoundFont with the offsets of every chunk we care about */
+typedef struct {
+    FILE* file;         // Open file handle, positioned arbitrarily
+    int64_t file_size;  // Total size of the file in bytes
+
+    // Information list (INFO) - its sub-chunks, without the list type
+    SF2Chunk info;
+
+    // Sample data list (sdta) - located only, never read
+    SF2Chunk smpl;      // 16 bit sample data
+    SF2Chunk sm24;      // Optional low byte for 24 bit samples
+
+    // Preset data list (pdta)
+    SF2Chunk phdr;      // Preset headers
+    SF2Chunk pbag;      // Preset zone indices
+    SF2Chunk pmod;      // Preset modulators
+    SF2Chunk pgen;      // Preset generators
+    SF2Chunk inst;      // Instrument headers
+    SF2Chunk ibag;      // Instrument zone indices
+    SF2Chunk imod;      // Instrument modulators
+    SF2Chunk igen;      // Instrument generators
+    SF2Chunk shdr;      // Sample headers
+} SF2File;
+
+/* A preset as exposed to the host, in FluidSynth's bank/program order */
+typedef struct {
+    int bank;                       // MIDI bank number (0-128)
+    int prog;                       // MIDI program number (0-127)
+    int index;                      // Position of the header in the phdr chunk
+    int bag_start;                  // First preset zone index (into pbag)
+    int bag_end;                    // One past the last preset zone index
+    char name[SF2_NAME_LEN + 1];    // Zero terminated preset name
+} SF2Preset;
+
+/* A sample header (shdr record); positions are in sample points from the start of smpl */
+typedef struct {
+    char name[SF2_NAME_LEN + 1];    // Zero terminated sample name
+    uint32_t start;                 // First sample point
+    uint32_t end;                   // One past the last sample point
+    uint32_t loop_start;            // First point of the loop
+    uint32_t loop_end;              // First point after the loop
+    uint32_t rate;                  // Sample rate in Hz
+    uint8_t original_pitch;         // MIDI key of the recorded pitch
+    int8_t pitch_correction;        // Pitch correction in cents
+    uint16_t link;                  // Linked sample for stereo pairs
+    uint16_t type;                  // Mono, left, right, linked or ROM
+} SF2Sample;
+
+/*
+ * One instrument zone reached through one preset zone, with the key and
+ * velocity ranges of both levels intersected. This is the unit FluidSynth
+ * turns into a voice when a note inside both ranges is played.
+ */
+typedef struct {
+    int preset;         // Index into the preset array passed to sf2_read_zones()
+    int instrument;     // Instrument index (into inst)
+    int sample;         // Sample index (into shdr)
+    uint8_t key_lo;     // Lowest MIDI key
+    uint8_t key_hi;     // Highest MIDI key
+    uint8_t vel_lo;     // Lowest velocity
+    uint8_t vel_hi;     // Highest velocity
+    uint8_t loop_mode;  // sampleModes generator: 0 no loop, 1 loop, 3 loop until release
+} SF2Zone;
+
+/*
+ * Open a SoundFont and locate its chunks.
+ * Returns 0 on success, -1 if the file cannot be read or is not a SoundFont.
+ */
+int sf2_open(SF2File* sf, const char* path);
+
+/*
+ * Close a SoundFont opened with sf2_open().
+ */
+void sf2_close(SF2File* sf);
+
+/*
+ * Read the preset headers and return the presets FluidSynth would expose.
+ * Presets are sorted by bank then program, presets outside banks 0-128 are
+ * skipped and duplicate bank/program pairs keep their first occurrence,
+ * matching fluid_sfont_get_preset() on the same file.
+ * The returned array must be released with free().
+ * Returns the number of presets, or -1 on error.
+ */
+int sf2_read_presets(SF2File* sf, SF2Preset** presets_out);
+
+/*
+ * Read a whole chunk into memory; name is only used in error messages.
+ * The returned buffer must be released with free().
+ * Returns NULL on failure.
+ */
+uint8_t* sf2_read_chunk(SF2File* sf, const SF2Chunk* chunk, const char* name);
+
+/*
+ * Read the sample headers, excluding the terminal "EOS" record.
+ * The returned array must be released with free().
+ * Returns the number of samples, or -1 on error.
+ */
+int sf2_read_samples(SF2File* sf, SF2Sample** samples_out);
+
+/*
+ * Flatten the preset -> instrument -> sample hierarchy of the given presets.
+ * Global zones supply default ranges and loop modes, zones whose ranges do
+ * not overlap are dropped and zones referencing missing instruments or
+ * samples are skipped. Zones are returned grouped by preset, in preset order.
+ * The returned array must be released with free().
+ * Returns the number of zones, or -1 on error.
+ */
+int sf2_read_zones(SF2File* sf, const SF2Preset* presets, int preset_count, SF2Zone** zones_out);
+
+#endif
@@ -0,0 +1,809 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont Writer (sf2_writer.c)
+ *
+ * This module:
+ * 1. Copies the zones of the selected presets, renumbering instrument links
+ * 2. Copies the instruments they reach, renumbering sample links
+ * 3. Adds the partners of stereo sample pairs
+ * 4. Streams the referenced sample data into a new smpl (and sm24) chunk,
+ *    optionally trimming loop tails, dropping sm24 or resampling
+ * 5. Optionally points samples with identical data at a single copy
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "sf2_writer.h"
+#include "sf2_dedup.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Buffer size for streaming sample data
+#define COPY_CHUNK_SIZE (1 << 20)
+
+// Sample types that name a partner in their link field
+#define SAMPLE_TYPE_LINKED_MASK 0x000E
+
+// Valid points the specification requires after a loop end
+#define LOOP_GUARD_POINTS 8
+
+// Half width of the resampling filter, in written points
+#define RESAMPLE_HALF_WIDTH 16
+
+/* Growable byte buffer used to build the pdta sub-chunks */
+typedef struct {
+    uint8_t* data;      // Buffer contents
+    size_t size;        // Bytes used
+    size_t capacity;    // Bytes allocated
+    int failed;         // Set when an allocation failed
+} ByteBuffer;
+
+/* Mapping from source indices to output indices, in order of first use */
+typedef struct {
+    int* new_index;     // Output index per source index, -1 if unused
+    int* order;         // Source index per output index
+    int count;          // Number of indices mapped so far
+} IndexMap;
+
+/* The source pdta sub-chunks, loaded into memory */
+typedef struct {
+    uint8_t* phdr; uint8_t* pbag; uint8_t* pmod; uint8_t* pgen;
+    uint8_t* inst; uint8_t* ibag; uint8_t* imod; uint8_t* igen;
+    uint8_t* shdr;
+    int pbag_count, pmod_count, pgen_count;     // Records including the terminal one
+    int inst_count, ibag_count, imod_count, igen_count;
+    int sample_count;                           // Samples without the terminal record
+} SourceTables;
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+/* Append bytes to a buffer, returning a pointer to the copy (NULL on failure) */
+static uint8_t* buffer_put(ByteBuffer* buffer, const void* data, size_t size) {
+    if (buffer->failed) {
+        return NULL;
+    }
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        while (capacity < buffer->size + size) capacity *= 2;
+        uint8_t* grown = (uint8_t*)realloc(buffer->data, capacity);
+        if (!grown) {
+            buffer->failed = 1;
+            return NULL;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    uint8_t* copy = buffer->data + buffer->size;
+    if (data) {
+        memcpy(copy, data, size);
+    } else {
+        memset(copy, 0, size);
+    }
+    buffer->size += size;
+    return copy;
+}
+
+static int index_map_init(IndexMap* map, int size) {
+    map->new_index = (int*)malloc((size > 0 ? size : 1) * sizeof(int));
+    map->order = (int*)malloc((size > 0 ? size : 1) * sizeof(int));
+    map->count = 0;
+    if (!map->new_index || !map->order) {
+        return -1;
+    }
+    for (int i = 0; i < size; i++) {
+        map->new_index[i] = -1;
+    }
+    return 0;
+}
+
+static void index_map_free(IndexMap* map) {
+    free(map->new_index);
+    free(map->order);
+}
+
+/* Output index of a source index, assigning the next one on first use */
+static int index_map_get(IndexMap* map, int old_index) {
+    if (map->new_index[old_index] < 0) {
+        map->new_index[old_index] = map->count;
+        map->order[map->count++] = old_index;
+    }
+    return map->new_index[old_index];
+}
+
+static void free_tables(SourceTables* t) {
+    free(t->phdr); free(t->pbag); free(t->pmod); free(t->pgen);
+    free(t->inst); free(t->ibag); free(t->imod); free(t->igen);
+    free(t->shdr);
+}
+
+static int load_tables(SF2File* sf, SourceTables* t) {
+    memset(t, 0, sizeof(*t));
+    t->phdr = sf2_read_chunk(sf, &sf->phdr, "phdr");
+    t->pbag = sf2_read_chunk(sf, &sf->pbag, "pbag");
+    t->pmod = sf2_read_chunk(sf, &sf->pmod, "pmod");
+    t->pgen = sf2_read_chunk(sf, &sf->pgen, "pgen");
+    t->inst = sf2_read_chunk(sf, &sf->inst, "inst");
+    t->ibag = sf2_read_chunk(sf, &sf->ibag, "ibag");
+    t->imod = sf2_read_chunk(sf, &sf->imod, "imod");
+    t->igen = sf2_read_chunk(sf, &sf->igen, "igen");
+    t->shdr = sf2_read_chunk(sf, &sf->shdr, "shdr");
+    if (!t->phdr || !t->pbag || !t->pmod || !t->pgen || !t->inst ||
+        !t->ibag || !t->imod || !t->igen || !t->shdr) {
+        free_tables(t);
+        return -1;
+    }
+    t->pbag_count = (int)(sf->pbag.size / SF2_BAG_SIZE);
+    t->pmod_count = (int)(sf->pmod.size / SF2_MOD_SIZE);
+    t->pgen_count = (int)(sf->pgen.size / SF2_GEN_SIZE);
+    t->inst_count = (int)(sf->inst.size / SF2_INST_SIZE);
+    t->ibag_count = (int)(sf->ibag.size / SF2_BAG_SIZE);
+    t->imod_count = (int)(sf->imod.size / SF2_MOD_SIZE);
+    t->igen_count = (int)(sf->igen.size / SF2_GEN_SIZE);
+    t->sample_count = (int)(sf->shdr.size / SF2_SHDR_SIZE) - 1;
+    if (t->sample_count < 0) t->sample_count = 0;
+    return 0;
+}
+
+/*
+ * Copy the zones [bag_start, bag_end) with their generators and modulators.
+ * The generator named by link_oper (instrument or sampleID) is renumbered
+ * through link_map; a link past link_limit is dropped.
+ */
+static void copy_zones(const uint8_t* bags, int bag_count, int bag_start, int bag_end,
+                       const uint8_t* gens, int gen_count, const uint8_t* mods, int mod_count,
+                       int link_oper, IndexMap* link_map, int link_limit,
+                       ByteBuffer* out_bags, ByteBuffer* out_gens, ByteBuffer* out_mods) {
+    // The last bag record only terminates the list
+    if (bag_end > bag_count - 1) bag_end = bag_count - 1;
+
+    for (int b = bag_start; b < bag_end; b++) {
+        int gen_start = get_u16(bags + b * SF2_BAG_SIZE);
+        int gen_end = get_u16(bags + (b + 1) * SF2_BAG_SIZE);
+        int mod_start = get_u16(bags + b * SF2_BAG_SIZE + 2);
+        int mod_end = get_u16(bags + (b + 1) * SF2_BAG_SIZE + 2);
+        if (gen_end > gen_count) gen_end = gen_count;
+        if (mod_end > mod_count) mod_end = mod_count;
+
+        uint8_t bag[SF2_BAG_SIZE];
+        put_u16(bag, (uint16_t)(out_gens->size / SF2_GEN_SIZE));
+        put_u16(bag + 2, (uint16_t)(out_mods->size / SF2_MOD_SIZE));
+        buffer_put(out_bags, bag, sizeof(bag));
+
+        for (int g = gen_start; g < gen_end; g++) {
+            uint8_t gen[SF2_GEN_SIZE];
+            memcpy(gen, gens + g * SF2_GEN_SIZE, sizeof(gen));
+            if (get_u16(gen) == link_oper) {
+                int target = get_u16(gen + 2);
+                if (target >= link_limit) {
+                    continue;
+                }
+                put_u16(gen + 2, (uint16_t)index_map_get(link_map, target));
+            }
+            buffer_put(out_gens, gen, sizeof(gen));
+        }
+        for (int m = mod_start; m < mod_end; m++) {
+            buffer_put(out_mods, mods + m * SF2_MOD_SIZE, SF2_MOD_SIZE);
+        }
+    }
+}
+
+/* Append the terminal records that close the bag, modulator and generator lists */
+static void terminate_zones(ByteBuffer* bags, ByteBuffer* gens, ByteBuffer* mods) {
+    uint8_t bag[SF2_BAG_SIZE];
+    put_u16(bag, (uint16_t)(gens->size / SF2_GEN_SIZE));
+    put_u16(bag + 2, (uint16_t)(mods->size / SF2_MOD_SIZE));
+    buffer_put(bags, bag, sizeof(bag));
+    buffer_put(gens, NULL, SF2_GEN_SIZE);
+    buffer_put(mods, NULL, SF2_MOD_SIZE);
+}
+
+/* Write an 8 byte chunk header */
+static int write_header(FILE* out, const char* id, uint32_t size) {
+    uint8_t header[8];
+    memcpy(header, id, 4);
+    put_u32(header + 4, size);
+    return fwrite(header, 1, sizeof(header), out) == sizeof(header) ? 0 : -1;
+}
+
+/* Copy a byte range of the source file to the output */
+static int copy_range(FILE* in, int64_t offset, int64_t size, FILE* out, char* buffer) {
+    if (size <= 0) {
+        return 0;
+    }
+    if (fseeko(in, (off_t)offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    while (size > 0) {
+        size_t count = size > COPY_CHUNK_SIZE ? COPY_CHUNK_SIZE : (size_t)size;
+        if (fread(buffer, 1, count, in) != count || fwrite(buffer, 1, count, out) != count) {
+            return -1;
+        }
+        size -= (int64_t)count;
+    }
+    return 0;
+}
+
+/* Write zero bytes */
+static int write_zeros(FILE* out, size_t count) {
+    static const uint8_t zeros[SF2_SAMPLE_PADDING * 2];
+    while (count > 0) {
+        size_t n = count > sizeof(zeros) ? sizeof(zeros) : count;
+        if (fwrite(zeros, 1, n, out) != n) {
+            return -1;
+        }
+        count -= n;
+    }
+    return 0;
+}
+
+/* Clamp a sample header's data range to the points present in smpl */
+static void sample_range(const uint8_t* record, uint32_t smpl_points, uint32_t* start, uint32_t* end) {
+    *start = get_u32(record + 20);
+    *end = get_u32(record + 24);
+    if (*end > smpl_points) *end = smpl_points;
+    if (*start > *end) *start = *end;
+}
+
+/* Check for a generator that moves sample or loop boundaries away from the header */
+static int is_address_generator(int oper) {
+    switch (oper) {
+        case 0: case 1: case 2: case 3:     // start, end, startloop, endloop offsets
+        case 4: case 12: case 45: case 50:  // coarse versions of the same
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Mark the samples whose data after the loop can never be played: every
+ * written instrument zone using them loops continuously (sampleModes 1,
+ * which keeps looping through the release) and none of those zones moves
+ * the sample or loop boundaries with address offset generators.
+ * trimmable[s] is 1 for such samples and 0 or -1 (unused) otherwise.
+ */
+static void find_trimmable(const SourceTables* t, const IndexMap* inst_map, signed char* trimmable) {
+    for (int s = 0; s < t->sample_count; s++) {
+        trimmable[s] = -1;
+    }
+
+    for (int i = 0; i < inst_map->count; i++) {
+        int inst = inst_map->order[i];
+        int bag_start = get_u16(t->inst + inst * SF2_INST_SIZE + 20);
+        int bag_end = get_u16(t->inst + (inst + 1) * SF2_INST_SIZE + 20);
+        if (bag_end > t->ibag_count - 1) bag_end = t->ibag_count - 1;
+
+        int global_mode = 0, global_offsets = 0;
+        for (int b = bag_start; b < bag_end; b++) {
+            int gen_start = get_u16(t->ibag + b * SF2_BAG_SIZE);
+            int gen_end = get_u16(t->ibag + (b + 1) * SF2_BAG_SIZE);
+            if (gen_end > t->igen_count) gen_end = t->igen_count;
+
+            int mode = global_mode, offsets = global_offsets, sample = -1;
+            for (int g = gen_start; g < gen_end; g++) {
+                const uint8_t* gen = t->igen + g * SF2_GEN_SIZE;
+                int oper = get_u16(gen);
+                if (oper == SF2_GEN_SAMPLE_MODES) {
+                    mode = get_u16(gen + 2) & 3;
+                } else if (oper == SF2_GEN_SAMPLE_ID) {
+                    sample = get_u16(gen + 2);
+                } else if (is_address_generator(oper) && get_u16(gen + 2) != 0) {
+                    offsets = 1;
+                }
+            }
+
+            // A first zone without a sample is the global zone
+            if (sample < 0) {
+                if (b == bag_start) {
+                    global_mode = mode;
+                    global_offsets = offsets;
+                }
+                continue;
+            }
+            if (sample >= t->sample_count) {
+                continue;
+            }
+            if (mode == 1 && !offsets) {
+                if (trimmable[sample] < 0) trimmable[sample] = 1;
+            } else {
+                trimmable[sample] = 0;
+            }
+        }
+    }
+}
+
+/* Layout of one written sample */
+typedef struct {
+    uint32_t start;         // First source point
+    uint32_t end;           // One past the last source point used
+    double ratio;           // Source points per written point (1 = same rate)
+    uint32_t length;        // Written points, without padding
+    uint32_t rate;          // Written sample rate
+    int64_t offset;         // First written point in smpl
+    int shared;             // Earlier plan whose written data this sample uses, -1 if none
+    uint64_t hash;          // Digest of the source data, set when deduplicating
+} SamplePlan;
+
+/*
+ * Find an earlier plan that writes the same data as plans[i]: the same
+ * source data over the same number of points, resampled by the same ratio.
+ * slots is an open addressing table of plan indices plus one, indexed by
+ * hash; plans[i] is added to it if no match is found.
+ * Returns the matching plan index, -1 if there is none, or -2 on a read error.
+ */
+static int find_shared_plan(SF2File* sf, const SamplePlan* plans, int i, int* slots, uint32_t slot_mask) {
+    const SamplePlan* plan = &plans[i];
+    uint32_t slot = (uint32_t)plan->hash & slot_mask;
+    for (; slots[slot] != 0; slot = (slot + 1) & slot_mask) {
+        const SamplePlan* other = &plans[slots[slot] - 1];
+        if (other->hash != plan->hash || other->ratio != plan->ratio ||
+            other->length != plan->length || other->end - other->start != plan->end - plan->start) {
+            continue;
+        }
+        int same = sf2_same_sample_data(sf, other->start, plan->start, plan->end - plan->start);
+        if (same != 0) {
+            return same > 0 ? slots[slot] - 1 : -2;
+        }
+    }
+    slots[slot] = i + 1;
+    return -1;
+}
+
+/* Blackman windowed sinc lowpass tap at distance d (in source points) */
+static double sinc_tap(double d, double cutoff, double half_width) {
+    if (fabs(d) >= half_width) {
+        return 0.0;
+    }
+    double window = 0.42 + 0.5 * cos(M_PI * d / half_width) + 0.08 * cos(2.0 * M_PI * d / half_width);
+    double x = 2.0 * cutoff * d;
+    double sinc = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+    return sinc * window;
+}
+
+/* Lowpass filtered value of x at source position t, with unit gain at DC */
+static double filter_at(const double* x, uint32_t n, double t, double cutoff, double half_width) {
+    int64_t first = (int64_t)ceil(t - half_width);
+    int64_t last = (int64_t)floor(t + half_width);
+    if (first < 0) first = 0;
+    if (last > (int64_t)n - 1) last = (int64_t)n - 1;
+
+    double sum = 0.0, weight = 0.0;
+    for (int64_t k = first; k <= last; k++) {
+        double h = sinc_tap((double)k - t, cutoff, half_width);
+        sum += x[k] * h;
+        weight += h;
+    }
+    return weight != 0.0 ? sum / weight : 0.0;
+}
+
+/*
+ * Write the data of one sample to smpl (out) and, if sm24_out is set, its
+ * low bytes to the sm24 stream. Data is copied unchanged unless the sample
+ * is resampled or its 24 bit extension is dropped; then it is converted to
+ * 24 bit values, filtered and requantized, and the energy of the change
+ * relative to the signal is recorded in the report.
+ */
+static int write_sample_data(SF2File* sf, const SamplePlan* plan, int has_sm24,
+                             FILE* out, FILE* sm24_out, char* copy_buffer, SF2SampleReport* report) {
+    uint32_t n = plan->end - plan->start;
+    int drop_sm24 = has_sm24 && !sm24_out;
+
+    // Unchanged data is streamed straight through
+    if (plan->ratio == 1.0 && !drop_sm24) {
+        if (copy_range(sf->file, sf->smpl.offset + (int64_t)plan->start * 2, (int64_t)n * 2, out, copy_buffer) != 0 ||
+            (sm24_out && copy_range(sf->file, sf->sm24.offset + plan->start, n, sm24_out, copy_buffer) != 0)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    uint8_t* raw = (uint8_t*)malloc((size_t)n * 3 + 1);
+    double* x = (double*)malloc(((size_t)n + 1) * sizeof(double));
+    double* y = (double*)malloc(((size_t)plan->length + 1) * sizeof(double));
+    if (!raw || !x || !y) {
+        free(raw); free(x); free(y);
+        return -1;
+    }
+
+    // Read the 16 bit points and their optional low bytes as 24 bit values
+    int status = -1;
+    if (fseeko(sf->file, (off_t)(sf->smpl.offset + (int64_t)plan->start * 2), SEEK_SET) == 0 &&
+        fread(raw, 2, n, sf->file) == n &&
+        (!has_sm24 || (fseeko(sf->file, (off_t)(sf->sm24.offset + plan->start), SEEK_SET) == 0 &&
+                       fread(raw + (size_t)n * 2, 1, n, sf->file) == n))) {
+        status = 0;
+    }
+    double signal = 0.0, error = 0.0;
+    for (uint32_t k = 0; status == 0 && k < n; k++) {
+        x[k] = (double)(int16_t)get_u16(raw + (size_t)k * 2) * 256.0 + (has_sm24 ? raw[(size_t)n * 2 + k] : 0);
+        signal += x[k] * x[k];
+    }
+
+    // Band limit to the new Nyquist frequency and decimate
+    if (status == 0 && plan->ratio > 1.0) {
+        double cutoff = 0.5 / plan->ratio * 0.95;
+        double half_width = RESAMPLE_HALF_WIDTH * plan->ratio;
+        for (uint32_t m = 0; m < plan->length; m++) {
+            y[m] = filter_at(x, n, m * plan->ratio, cutoff, half_width);
+        }
+        // The content removed by the lowpass is what resampling loses
+        for (uint32_t k = 0; k < n; k++) {
+            double removed = x[k] - filter_at(x, n, k, cutoff, half_width);
+            error += removed * removed;
+        }
+    } else {
+        for (uint32_t m = 0; m < plan->length && m < n; m++) {
+            y[m] = x[m];
+        }
+    }
+
+    // Requantize to 24 bits, or round to 16 bits when the low bytes are dropped
+    double requantized = 0.0, written = 0.0;
+    for (uint32_t m = 0; status == 0 && m < plan->length; m++) {
+        uint8_t point[2];
+        if (sm24_out) {
+            long value = lround(y[m]);
+            if (value > 8388607) value = 8388607;
+            if (value < -8388608) value = -8388608;
+            put_u16(point, (uint16_t)(int16_t)(value >> 8));
+            if (fputc((int)(value & 0xFF), sm24_out) == EOF) status = -1;
+            requantized += (y[m] - value) * (y[m] - value);
+        } else {
+            long value = lround(y[m] / 256.0);
+            if (value > 32767) value = 32767;
+            if (value < -32768) value = -32768;
+            put_u16(point, (uint16_t)(int16_t)value);
+            requantized += (y[m] - value * 256.0) * (y[m] - value * 256.0);
+        }
+        written += y[m] * y[m];
+        if (fwrite(point, 1, 2, out) != 2) status = -1;
+    }
+
+    // Relative error energy of both steps, each against the signal it applies to
+    double relative = (signal > 0.0 ? error / signal : 0.0) + (written > 0.0 ? requantized / written : 0.0);
+    report->lossy = 1;
+    report->error_db = relative > 0.0 ? 10.0 * log10(relative) : -INFINITY;
+
+    free(raw); free(x); free(y);
+    return status;
+}
+
+int sf2_write_subset(SF2File* sf, const SF2Preset* presets, int preset_count,
+                     const SF2WriteOptions* options, const char* path,
+                     SF2WriteReport* report, FILE* log) {
+    static const SF2WriteOptions no_options = { 0, 0, 0, 0 };
+    if (!options) {
+        options = &no_options;
+    }
+    memset(report, 0, sizeof(*report));
+
+    SourceTables t;
+    if (load_tables(sf, &t) != 0) {
+        fprintf(log, "Failed to read SoundFont tables for writing\n");
+        return -1;
+    }
+
+    IndexMap inst_map, sample_map;
+    int inst_limit = t.inst_count - 1;
+    if (inst_limit < 0) inst_limit = 0;
+    if (index_map_init(&inst_map, inst_limit) != 0 || index_map_init(&sample_map, t.sample_count) != 0) {
+        fprintf(log, "Failed to allocate index maps\n");
+        index_map_free(&inst_map);
+        free_tables(&t);
+        return -1;
+    }
+
+    ByteBuffer phdr = {0}, pbag = {0}, pmod = {0}, pgen = {0};
+    ByteBuffer inst = {0}, ibag = {0}, imod = {0}, igen = {0}, shdr = {0};
+    SamplePlan* plans = NULL;
+    signed char* trimmable = NULL;
+    int* slots = NULL;
+    char* copy_buffer = NULL;
+    uint8_t* info = NULL;
+    FILE* out = NULL;
+    FILE* sm24_temp = NULL;
+
+    // Presets keep their header fields; only the zone index changes
+    for (int p = 0; p < preset_count; p++) {
+        uint8_t* record = buffer_put(&phdr, t.phdr + presets[p].index * SF2_PHDR_SIZE, SF2_PHDR_SIZE);
+        if (record) {
+            put_u16(record + 24, (uint16_t)(pbag.size / SF2_BAG_SIZE));
+        }
+        copy_zones(t.pbag, t.pbag_count, presets[p].bag_start, presets[p].bag_end,
+                   t.pgen, t.pgen_count, t.pmod, t.pmod_count,
+                   SF2_GEN_INSTRUMENT, &inst_map, inst_limit, &pbag, &pgen, &pmod);
+    }
+    uint8_t* eop = buffer_put(&phdr, NULL, SF2_PHDR_SIZE);
+    if (eop) {
+        memcpy(eop, "EOP", 3);
+        put_u16(eop + 24, (uint16_t)(pbag.size / SF2_BAG_SIZE));
+    }
+    terminate_zones(&pbag, &pgen, &pmod);
+
+    // Instruments in order of first reference; each one may add samples
+    for (int i = 0; i < inst_map.count; i++) {
+        int old = inst_map.order[i];
+        uint8_t* record = buffer_put(&inst, t.inst + old * SF2_INST_SIZE, SF2_INST_SIZE);
+        if (record) {
+            put_u16(record + 20, (uint16_t)(ibag.size / SF2_BAG_SIZE));
+        }
+        copy_zones(t.ibag, t.ibag_count, get_u16(t.inst + old * SF2_INST_SIZE + 20),
+                   get_u16(t.inst + (old + 1) * SF2_INST_SIZE + 20),
+                   t.igen, t.igen_count, t.imod, t.imod_count,
+                   SF2_GEN_SAMPLE_ID, &sample_map, t.sample_count, &ibag, &igen, &imod);
+    }
+    uint8_t* eoi = buffer_put(&inst, NULL, SF2_INST_SIZE);
+    if (eoi) {
+        memcpy(eoi, "EOI", 3);
+        put_u16(eoi + 20, (uint16_t)(ibag.size / SF2_BAG_SIZE));
+    }
+    terminate_zones(&ibag, &igen, &imod);
+
+    // Both halves of a stereo pair are needed even if only one is referenced
+    for (int i = 0; i < sample_map.count; i++) {
+        const uint8_t* record = t.shdr + sample_map.order[i] * SF2_SHDR_SIZE;
+        int link = get_u16(record + 42);
+        if ((get_u16(record + 44) & SAMPLE_TYPE_LINKED_MASK) && link < t.sample_count) {
+            index_map_get(&sample_map, link);
+        }
+    }
+
+    plans = (SamplePlan*)calloc(sample_map.count + 1, sizeof(SamplePlan));
+    trimmable = (signed char*)malloc(t.sample_count + 1);
+    report->samples = (SF2SampleReport*)calloc(sample_map.count + 1, sizeof(SF2SampleReport));
+    if (!plans || !trimmable || !report->samples) {
+        fprintf(log, "Failed to allocate sample plans\n");
+        goto fail;
+    }
+    if (options->trim_loop_tails) {
+        find_trimmable(&t, &inst_map, trimmable);
+    }
+
+    // Hash table of distinct plans, at most half full
+    uint32_t slot_mask = 1;
+    while (slot_mask < (uint32_t)sample_map.count * 2) {
+        slot_mask <<= 1;
+    }
+    slot_mask--;
+    if (options->dedup_samples && !(slots = (int*)calloc((size_t)slot_mask + 1, sizeof(int)))) {
+        fprintf(log, "Failed to allocate sample hash table\n");
+        goto fail;
+    }
+
+    // Lay out the sample data back to back, each sample followed by its padding
+    uint32_t smpl_points = sf->smpl.size / 2;
+    int has_sm24 = sf->sm24.size >= smpl_points && smpl_points > 0;
+    int write_sm24 = has_sm24 && !options->drop_sm24;
+    int64_t points = 0;
+    for (int i = 0; i < sample_map.count; i++) {
+        int old = sample_map.order[i];
+        const uint8_t* source = t.shdr + old * SF2_SHDR_SIZE;
+        SamplePlan* plan = &plans[i];
+        SF2SampleReport* sample_report = &report->samples[i];
+        sample_range(source, smpl_points, &plan->start, &plan->end);
+
+        uint32_t source_end = plan->end;
+        uint32_t loop_start = get_u32(source + 28);
+        uint32_t loop_end = get_u32(source + 32);
+        if (loop_start < plan->start) loop_start = plan->start;
+        if (loop_end > plan->end) loop_end = plan->end;
+        if (loop_end < loop_start) loop_end = loop_start;
+
+        // Keep the guard points the specification requires after the loop
+        if (options->trim_loop_tails && trimmable[old] == 1 && loop_end > loop_start &&
+            (uint64_t)loop_end + LOOP_GUARD_POINTS < plan->end) {
+            plan->end = loop_end + LOOP_GUARD_POINTS;
+        }
+
+        plan->rate = get_u32(source + 36);
+        plan->ratio = 1.0;
+        if (options->target_rate > 0 && plan->rate > options->target_rate) {
+            plan->ratio = (double)plan->rate / options->target_rate;
+            plan->rate = options->target_rate;
+        }
+        uint32_t used = plan->end - plan->start;
+        plan->length = plan->ratio == 1.0 ? used : (uint32_t)ceil(used / plan->ratio);
+
+        // Identical output is written once; later samples point at the first copy
+        plan->offset = points;
+        plan->shared = -1;
+        if (options->dedup_samples && used > 0) {
+            if (sf2_hash_sample_data(sf, plan->start, plan->end, &plan->hash) != 0 ||
+                (plan->shared = find_shared_plan(sf, plans, i, slots, slot_mask)) == -2) {
+                fprintf(log, "Failed to read sample data for deduplication\n");
+                goto fail;
+            }
+            if (plan->shared >= 0) {
+                plan->offset = plans[plan->shared].offset;
+            }
+        }
+
+        memcpy(sample_report->name, source, SF2_NAME_LEN);
+        sample_report->name[SF2_NAME_LEN] = '\0';
+        sample_report->source_bytes = (int64_t)(source_end - plan->start) * (has_sm24 ? 3 : 2);
+        sample_report->bytes = plan->shared >= 0 ? 0 : (int64_t)plan->length * (write_sm24 ? 3 : 2);
+        sample_report->shared_with = plan->shared;
+        sample_report->trimmed_points = source_end - plan->end;
+        sample_report->source_rate = get_u32(source + 36);
+        sample_report->rate = plan->rate;
+        sample_report->dropped_sm24 = has_sm24 && !write_sm24;
+
+        uint8_t* record = buffer_put(&shdr, source, SF2_SHDR_SIZE);
+        if (record) {
+            // Loop points move with the data and scale with the rate
+            int64_t new_loop_start = plan->offset + llround((loop_start - plan->start) / plan->ratio);
+            int64_t new_loop_end = plan->offset + llround((loop_end - plan->start) / plan->ratio);
+            int64_t new_end = plan->offset + plan->length;
+            if (new_loop_end > new_end) new_loop_end = new_end;
+            if (new_loop_start > new_loop_end) new_loop_start = new_loop_end;
+            put_u32(record + 20, (uint32_t)plan->offset);
+            put_u32(record + 24, (uint32_t)new_end);
+            put_u32(record + 28, (uint32_t)new_loop_start);
+            put_u32(record + 32, (uint32_t)new_loop_end);
+            put_u32(record + 36, plan->rate);
+
+            int link = get_u16(source + 42);
+            put_u16(record + 42, (uint16_t)(link < t.sample_count && sample_map.new_index[link] >= 0
+                                             ? sample_map.new_index[link] : 0));
+        }
+        if (plan->shared >= 0) {
+            report->shared_bytes += (int64_t)plan->length * (write_sm24 ? 3 : 2);
+        } else {
+            report->distinct_sample_count++;
+            points += (int64_t)plan->length + SF2_SAMPLE_PADDING;
+        }
+    }
+    uint8_t* eos = buffer_put(&shdr, NULL, SF2_SHDR_SIZE);
+    if (eos) {
+        memcpy(eos, "EOS", 3);
+    }
+
+    if (phdr.failed || pbag.failed || pmod.failed || pgen.failed || inst.failed ||
+        ibag.failed || imod.failed || igen.failed || shdr.failed) {
+        fprintf(log, "Failed to allocate SoundFont tables for writing\n");
+        goto fail;
+    }
+
+    // Chunk and list sizes, known before any data is written
+    static const uint8_t default_info[] = {
+        'i', 'f', 'i', 'l', 4, 0, 0, 0, 2, 0, 1, 0,
+        'i', 's', 'n', 'g', 8, 0, 0, 0, 'E', 'M', 'U', '8', '0', '0', '0', 0,
+        'I', 'N', 'A', 'M', 8, 0, 0, 0, 'S', 'F', '2', 'L', 'V', '2', 0, 0
+    };
+    info = sf->info.size > 0 ? sf2_read_chunk(sf, &sf->info, "INFO") : NULL;
+    const uint8_t* info_data = info ? info : default_info;
+    uint32_t info_size = info ? sf->info.size : (uint32_t)sizeof(default_info);
+
+    int64_t smpl_size = points * 2;
+    int64_t sm24_size = write_sm24 ? points : 0;
+    int64_t sdta_size = 4 + 8 + smpl_size + (write_sm24 ? 8 + sm24_size + (sm24_size & 1) : 0);
+    int64_t pdta_size = 4 + 9 * 8 + (int64_t)(phdr.size + pbag.size + pmod.size + pgen.size +
+                                             inst.size + ibag.size + imod.size + igen.size + shdr.size);
+    int64_t info_list_size = 4 + (int64_t)info_size + (info_size & 1);
+    int64_t riff_size = 4 + 8 + info_list_size + 8 + sdta_size + 8 + pdta_size;
+    if (riff_size > UINT32_MAX) {
+        fprintf(log, "SoundFont subset is too large to write\n");
+        goto fail;
+    }
+
+    // Low bytes are collected separately because sm24 follows the whole smpl chunk
+    copy_buffer = (char*)malloc(COPY_CHUNK_SIZE);
+    sm24_temp = write_sm24 ? tmpfile() : NULL;
+    out = fopen(path, "wb");
+    if (!copy_buffer || (write_sm24 && !sm24_temp) || !out) {
+        fprintf(log, "Failed to create SoundFont '%s': %s\n", path, strerror(errno));
+        goto fail;
+    }
+
+    int status = 0;
+    status |= write_header(out, "RIFF", (uint32_t)riff_size);
+    status |= fwrite("sfbk", 1, 4, out) == 4 ? 0 : -1;
+
+    status |= write_header(out, "LIST", (uint32_t)info_list_size);
+    status |= fwrite("INFO", 1, 4, out) == 4 ? 0 : -1;
+    status |= fwrite(info_data, 1, info_size, out) == info_size ? 0 : -1;
+    status |= write_zeros(out, info_size & 1);
+
+    status |= write_header(out, "LIST", (uint32_t)sdta_size);
+    status |= fwrite("sdta", 1, 4, out) == 4 ? 0 : -1;
+    status |= write_header(out, "smpl", (uint32_t)smpl_size);
+    for (int i = 0; i < sample_map.count && status == 0; i++) {
+        if (plans[i].shared >= 0) {
+            report->samples[i].lossy = report->samples[plans[i].shared].lossy;
+            report->samples[i].error_db = report->samples[plans[i].shared].error_db;
+            continue;
+        }
+        status |= write_sample_data(sf, &plans[i], has_sm24, out, sm24_temp, copy_buffer, &report->samples[i]);
+        status |= write_zeros(out, SF2_SAMPLE_PADDING * 2);
+        if (sm24_temp) {
+            status |= write_zeros(sm24_temp, SF2_SAMPLE_PADDING);
+        }
+    }
+    if (write_sm24 && status == 0) {
+        status |= write_header(out, "sm24", (uint32_t)sm24_size);
+        rewind(sm24_temp);
+        size_t count;
+        while ((count = fread(copy_buffer, 1, COPY_CHUNK_SIZE, sm24_temp)) > 0) {
+            if (fwrite(copy_buffer, 1, count, out) != count) {
+                status = -1;
+                break;
+            }
+        }
+        status |= write_zeros(out, (size_t)(sm24_size & 1));
+    }
+
+    status |= write_header(out, "LIST", (uint32_t)pdta_size);
+    status |= fwrite("pdta", 1, 4, out) == 4 ? 0 : -1;
+    const struct { const char* id; const ByteBuffer* data; } chunks[] = {
+        { "phdr", &phdr }, { "pbag", &pbag }, { "pmod", &pmod }, { "pgen", &pgen },
+        { "inst", &inst }, { "ibag", &ibag }, { "imod", &imod }, { "igen", &igen },
+        { "shdr", &shdr }
+    };
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        status |= write_header(out, chunks[i].id, (uint32_t)chunks[i].data->size);
+        status |= fwrite(chunks[i].data->data, 1, chunks[i].data->size, out) == chunks[i].data->size ? 0 : -1;
+    }
+
+    int close_status = fclose(out);
+    out = NULL;
+    if (close_status != 0 || status != 0) {
+        fprintf(log, "Failed to write SoundFont '%s'\n", path);
+        remove(path);
+        goto fail;
+    }
+
+    report->preset_count = preset_count;
+    report->instrument_count = inst_map.count;
+    report->sample_count = sample_map.count;
+    report->source_sample_count = t.sample_count;
+    report->source_sample_bytes = (int64_t)sf->smpl.size + (has_sm24 ? sf->sm24.size : 0);
+    report->sample_bytes = smpl_size + sm24_size;
+    report->file_size = 8 + riff_size;
+
+    free(phdr.data); free(pbag.data); free(pmod.data); free(pgen.data);
+    free(inst.data); free(ibag.data); free(imod.data); free(igen.data); free(shdr.data);
+    free(plans); free(trimmable); free(slots); free(copy_buffer); free(info);
+    if (sm24_temp) fclose(sm24_temp);
+    index_map_free(&inst_map);
+    index_map_free(&sample_map);
+    free_tables(&t);
+    return 0;
+
+fail:
+    free(phdr.data); free(pbag.data); free(pmod.data); free(pgen.data);
+    free(inst.data); free(ibag.data); free(imod.data); free(igen.data); free(shdr.data);
+    free(plans); free(trimmable); free(slots); free(copy_buffer); free(info);
+    if (out) {
+        fclose(out);
+        remove(path);
+    }
+    if (sm24_temp) fclose(sm24_temp);
+    free(report->samples);
+    report->samples = NULL;
+    index_map_free(&inst_map);
+    index_map_free(&sample_map);
+    free_tables(&t);
+    return -1;
+}
@@ -0,0 +1,73 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont Writer (sf2_writer.h)
+ *
+ * Writes a new SoundFont holding a subset of the presets of an open
+ * SoundFont, together with only the instruments and samples those presets
+ * reference. Indices in the preset, instrument and sample lists are
+ * renumbered, sample data is packed back to back (each sample followed by
+ * the 46 zero points the SoundFont specification requires) and the INFO
+ * list is copied unchanged.
+ *
+ * Sample data can optionally be reduced on the way: data after the loop of
+ * samples that never leave their loop is trimmed, the 24 bit extension
+ * (sm24) is dropped, and samples above a target rate are resampled with a
+ * windowed sinc filter. Samples whose written data would be identical can
+ * share one copy of it, each keeping its own header and loop points.
+ */
+
+#ifndef SF2_WRITER_H
+#define SF2_WRITER_H
+
+#include "sf2_parser.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Optional reductions applied to the sample data */
+typedef struct {
+    int trim_loop_tails;        // Drop data after the loop of samples that always loop
+    int drop_sm24;              // Write 16 bit sample data only
+    uint32_t target_rate;       // Resample samples above this rate in Hz (0 keeps rates)
+    int dedup_samples;          // Store identical sample data once
+} SF2WriteOptions;
+
+/* What happened to one sample */
+typedef struct {
+    char name[SF2_NAME_LEN + 1];    // Sample name
+    int64_t source_bytes;           // smpl and sm24 bytes in the source
+    int64_t bytes;                  // smpl and sm24 bytes written
+    uint32_t trimmed_points;        // Points removed after the loop
+    uint32_t source_rate;           // Sample rate in the source
+    uint32_t rate;                  // Sample rate written
+    int dropped_sm24;               // Non-zero if the low 8 bits were dropped
+    int lossy;                      // Non-zero if audible data changed
+    double error_db;                // Energy of the change relative to the signal, in dB
+    int shared_with;                // Written sample whose data this one uses, -1 if its own
+} SF2SampleReport;
+
+/* Summary of a written SoundFont */
+typedef struct {
+    int preset_count;               // Presets written
+    int instrument_count;           // Instruments written
+    int sample_count;               // Samples written
+    int source_sample_count;        // Samples in the source
+    int distinct_sample_count;      // Written samples with their own data
+    int64_t shared_bytes;           // Bytes not written because another sample holds the data
+    int64_t source_sample_bytes;    // smpl and sm24 bytes in the source
+    int64_t sample_bytes;           // smpl and sm24 bytes written
+    int64_t file_size;              // Size of the written file
+    SF2SampleReport* samples;       // One entry per written sample, release with free()
+} SF2WriteReport;
+
+/*
+ * Write the given presets of an open SoundFont to path.
+ * Presets keep their bank and program numbers and are written in array order.
+ * options may be NULL to copy sample data unchanged.
+ * Returns 0 on success, -1 on failure.
+ */
+int sf2_write_subset(SF2File* sf, const SF2Preset* presets, int preset_count,
+                     const SF2WriteOptions* options, const char* path,
+                     SF2WriteReport* report, FILE* log);
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Live Instance Monitor (sf2lv2_top.c)
+ *
+ * Shows every SF2LV2 plugin instance running on the machine, whichever host
+ * process it lives in, by reading the live metrics segments the plugins
+ * publish in /dev/shm. The table is refreshed like top, busiest instance
+ * first. With -p the same counters are also written to a file in the
+ * Prometheus text format, e.g. for node_exporter's textfile collector.
+ *
+ * Usage: sf2lv2_top [-d seconds] [-n count] [-b] [-p file]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "live_metrics.h"
+#include "util.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Where POSIX shared memory segments appear
+#define SHM_DIR "/dev/shm"
+
+// Seconds without a run() after which an instance is shown as idle
+#define IDLE_SECONDS 2.0
+
+/* One instance as read from its slot */
+typedef struct {
+    int pid;                // Host process
+    int segment;            // Segment number within the process, one per copy of the binary
+    int slot;               // Slot in the segment
+    char name[64];          // Plugin name
+    LiveMetrics values;     // Counters
+} Instance;
+
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [-d seconds] [-n count] [-b] [-p file]\n"
+            "  -d <seconds>     Time between refreshes (default: 1)\n"
+            "  -n <count>       Exit after this many refreshes (default: run until interrupted)\n"
+            "  -b               Batch mode: print each table below the last instead of redrawing\n"
+            "  -p <file>        Also write the counters to file in the Prometheus text format\n",
+            program);
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Check whether a process still exists */
+static int process_alive(int pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/*
+ * Append the instances of one segment to the list. Segments of processes
+ * that died without removing them are skipped, also when another process
+ * has taken over the ID since.
+ */
+static void read_segment(const char* entry, int pid, int number, Instance** list, int* count, int* capacity) {
+    if (!process_alive(pid)) {
+        return;
+    }
+    char name[300];
+    snprintf(name, sizeof(name), "/%s", entry);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LiveMetricsSegment)) {
+        close(fd);
+        return;
+    }
+    const LiveMetricsSegment* segment = (const LiveMetricsSegment*)mmap(NULL, sizeof(LiveMetricsSegment),
+                                                                        PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        return;
+    }
+
+    if (segment->magic == LIVE_METRICS_MAGIC && segment->version == LIVE_METRICS_VERSION &&
+        segment->pid == pid && live_metrics_owner_alive(segment)) {
+        for (int i = 0; i < LIVE_METRICS_SLOTS; i++) {
+            if (*count == *capacity) {
+                int grown_capacity = *capacity ? *capacity * 2 : 64;
+                Instance* grown = (Instance*)realloc(*list, grown_capacity * sizeof(Instance));
+                if (!grown) {
+                    break;
+                }
+                *list = grown;
+                *capacity = grown_capacity;
+            }
+            Instance* instance = &(*list)[*count];
+            if (live_metrics_read(&segment->slots[i], instance->name, &instance->values) == 0) {
+                instance->pid = pid;
+                instance->segment = number;
+                instance->slot = i;
+                (*count)++;
+            }
+        }
+    }
+    munmap((void*)segment, sizeof(LiveMetricsSegment));
+}
+
+/* Read every live instance on the machine. Returns the count, -1 on error */
+static int read_instances(Instance** list, int* capacity) {
+    DIR* dir = opendir(SHM_DIR);
+    if (!dir) {
+        perror("Failed to open " SHM_DIR);
+        return -1;
+    }
+    int count = 0;
+    size_t prefix = strlen(LIVE_METRICS_PREFIX);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char* end;
+        if (strncmp(entry->d_name, LIVE_METRICS_PREFIX, prefix) != 0) {
+            continue;
+        }
+        // sf2lv2-<pid>-<n>
+        long pid = strtol(entry->d_name + prefix, &end, 10);
+        if (pid <= 0 || *end != '-') {
+            continue;
+        }
+        const char* number_start = end + 1;
+        long number = strtol(number_start, &end, 10);
+        if (end != number_start && *end == '\0' && number >= 0 && number < LIVE_METRICS_SEGMENTS) {
+            read_segment(entry->d_name, (int)pid, (int)number, list, &count, capacity);
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+/* Busiest instance first */
+static int compare_load(const void* a, const void* b) {
+    float load_a = ((const Instance*)a)->values.load;
+    float load_b = ((const Instance*)b)->values.load;
+    return (load_a < load_b) - (load_a > load_b);
+}
+
+/* Print the table of instances */
+static void print_table(const Instance* instances, int count, int batch) {
+    if (!batch) {
+        printf("\033[H\033[2J");
+    }
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    char clock[16];
+    strftime(clock, sizeof(clock), "%H:%M:%S", &local);
+
+    int processes = 0;
+    for (int i = 0; i < count; i++) {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = instances[j].pid == instances[i].pid;
+        }
+        processes += !seen;
+    }
+    printf("sf2lv2_top - %d instances in %d processes, %s\n\n", count, processes, clock);
+    printf("%7s %5s %-20s %7s %6s %6s %5s %8s %9s %7s %11s  %s\n",
+           "PID", "SLOT", "PLUGIN", "PROGRAM", "LOAD%", "VOICES", "PEAK", "FULLPOLY",
+           "MEMORY", "MISSES", "CYCLES", "STATE");
+
+    int64_t now_monotonic = now_ns();
+    for (int i = 0; i < count; i++) {
+        const Instance* instance = &instances[i];
+        const LiveMetrics* values = &instance->values;
+        char memory[32], slot[16];
+        snprintf(slot, sizeof(slot), "%d:%d", instance->segment, instance->slot);
+        double idle = (now_monotonic - values->updated_ns) / 1e9;
+        printf("%7d %5s %-20.20s %7d %6.1f %6u %5u %8u %9s %7llu %11llu  %s\n",
+               instance->pid, slot, instance->name, values->program,
+               values->load * 100.0, values->voices, values->peak_voices, values->full_polyphony_notes,
+               format_bytes(values->memory, memory, sizeof(memory)),
+               (unsigned long long)values->deadline_misses, (unsigned long long)values->cycles,
+               values->cycles == 0 || idle > IDLE_SECONDS ? "idle" : "running");
+    }
+    if (batch) {
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+/* Write a label value, escaped as the Prometheus text format requires */
+static void write_label(FILE* out, const char* value) {
+    for (const char* c = value; *c; c++) {
+        if (*c == '\\' || *c == '"') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c == '\n') {
+            fprintf(out, "\\n");
+        } else {
+            fputc(*c, out);
+        }
+    }
+}
+
+/* Write one metric for every instance */
+static void write_metric(FILE* out, const Instance* instances, int count, const char* metric,
+                         const char* type, const char* help, double (*value)(const LiveMetrics*)) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", metric, help, metric, type);
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s{pid=\"%d\",segment=\"%d\",slot=\"%d\",plugin=\"", metric,
+                instances[i].pid, instances[i].segment, instances[i].slot);
+        write_label(out, instances[i].name);
+        fprintf(out, "\"} %.17g\n", value(&instances[i].values));
+    }
+}
+
+static double metric_load(const LiveMetrics* values) { return values->load; }
+static double metric_voices(const LiveMetrics* values) { return values->voices; }
+static double metric_peak_voices(const LiveMetrics* values) { return values->peak_voices; }
+static double metric_full_polyphony_notes(const LiveMetrics* values) { return values->full_polyphony_notes; }
+static double metric_memory(const LiveMetrics* values) { return (double)values->memory; }
+static double metric_program(const LiveMetrics* values) { return values->program; }
+static double metric_misses(const LiveMetrics* values) { return (double)values->deadline_misses; }
+static double metric_cycles(const LiveMetrics* values) { return (double)values->cycles; }
+
+/*
+ * Write the counters in the Prometheus text format. The file is replaced
+ * in one rename, so a collector never reads it half written.
+ * Returns 0 on success, -1 on failure.
+ */
+static int write_prometheus(const char* path, const Instance* instances, int count) {
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE* out = fopen(temporary, "w");
+    if (!out) {
+        fprintf(stderr, "Failed to write %s: %s\n", temporary, strerror(errno));
+        return -1;
+    }
+    write_metric(out, instances, count, "sf2lv2_dsp_load", "gauge",
+                 "Smoothed share of the block duration run() takes", metric_load);
+    write_metric(out, instances, count, "sf2lv2_voices", "gauge",
+                 "Active voices", metric_voices);
+    write_metric(out, instances, count, "sf2lv2_peak_voices", "gauge",
+                 "Most active voices since the plugin was activated", metric_peak_voices);
+    write_metric(out, instances, count, "sf2lv2_full_polyphony_notes_total", "counter",
+                 "Note-ons that found every voice in use and ended one since the plugin was activated",
+                 metric_full_polyphony_notes);
+    write_metric(out, instances, count, "sf2lv2_memory_bytes", "gauge",
+                 "Memory held by the instance", metric_memory);
+    write_metric(out, instances, count, "sf2lv2_program", "gauge",
+                 "Selected program, -1 before the first", metric_program);
+    write_metric(out, instances, count, "sf2lv2_deadline_misses_total", "counter",
+                 "run() calls longer than the deadline", metric_misses);
+    write_metric(out, instances, count, "sf2lv2_cycles_total", "counter",
+                 "run() calls", metric_cycles);
+    if (fclose(out) != 0 || rename(temporary, path) != 0) {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    double interval = 1.0;
+    long refreshes = 0;
+    int batch = 0;
+    const char* prometheus_path = NULL;
+
+    int first = 1;
+    while (first < argc) {
+        if (!strcmp(argv[first], "-d") && first + 1 < argc && atof(argv[first + 1]) > 0) {
+            interval = atof(argv[++first]);
+        } else if (!strcmp(argv[first], "-n") && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            refreshes = atol(argv[++first]);
+        } else if (!strcmp(argv[first], "-b")) {
+            batch = 1;
+        } else if (!strcmp(argv[first], "-p") && first + 1 < argc) {
+            prometheus_path = argv[++first];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+        first++;
+    }
+
+    Instance* instances = NULL;
+    int capacity = 0;
+    for (long refresh = 0; refreshes == 0 || refresh < refreshes; refresh++) {
+        if (refresh > 0) {
+            struct timespec pause = { (time_t)interval, (long)((interval - (time_t)interval) * 1e9) };
+            nanosleep(&pause, NULL);
+        }
+        int count = read_instances(&instances, &capacity);
+        if (count < 0) {
+            free(instances);
+            return 1;
+        }
+        if (count > 1) {
+            qsort(instances, count, sizeof(Instance), compare_load);
+        }
+        print_table(instances, count, batch);
+        if (prometheus_path && write_prometheus(prometheus_path, instances, count) != 0) {
+            free(instances);
+            return 1;
+        }
+    }
+    free(instances);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Stress Pattern (stress_pattern.c)
+ */
+
+#include "stress_pattern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Sustain pedal controller
+#define CC_SUSTAIN_PEDAL 64
+
+static void add_event(StressPattern* pattern, uint32_t rate, int ms, uint8_t status, int data1, int data2) {
+    if (pattern->count < STRESS_MAX_EVENTS) {
+        StressEvent* event = &pattern->events[pattern->count++];
+        event->frame = (uint32_t)((int64_t)ms * rate / 1000);
+        event->status = status;
+        event->data1 = (uint8_t)data1;
+        event->data2 = (uint8_t)data2;
+    }
+}
+
+static int compare_events(const void* a, const void* b) {
+    const StressEvent* x = (const StressEvent*)a;
+    const StressEvent* y = (const StressEvent*)b;
+    return x->frame < y->frame ? -1 : x->frame > y->frame;
+}
+
+void stress_pattern_build(StressPattern* pattern, unsigned mask, uint32_t rate) {
+    static const int chord[] = { 0, 4, 7, 12 };
+    memset(pattern, 0, sizeof(*pattern));
+    int ms = 0;
+
+    if (mask & (1u << STRESS_CHORDS)) {
+        for (int root = 36; root <= 84; root += 12, ms += 500) {
+            for (size_t i = 0; i < sizeof(chord) / sizeof(chord[0]); i++) {
+                add_event(pattern, rate, ms, STRESS_NOTE_ON, root + chord[i], 100);
+                add_event(pattern, rate, ms + 400, STRESS_NOTE_OFF, root + chord[i], 0);
+            }
+        }
+    }
+
+    if (mask & (1u << STRESS_REPEATS)) {
+        for (int i = 0; i < 16; i++, ms += 40) {
+            add_event(pattern, rate, ms, STRESS_NOTE_ON, 60, i % 2 ? 127 : 64);
+            add_event(pattern, rate, ms + 20, STRESS_NOTE_OFF, 60, 0);
+        }
+        ms += 160;
+    }
+
+    if (mask & (1u << STRESS_SUSTAIN)) {
+        add_event(pattern, rate, ms, STRESS_CONTROL, CC_SUSTAIN_PEDAL, 127);
+        for (int key = 48; key <= 72; key += 2) {
+            int start = ms + (key - 48) / 2 * 60;
+            add_event(pattern, rate, start, STRESS_NOTE_ON, key, 90);
+            add_event(pattern, rate, start + 50, STRESS_NOTE_OFF, key, 0);
+        }
+        add_event(pattern, rate, ms + 1500, STRESS_CONTROL, CC_SUSTAIN_PEDAL, 0);
+        ms += 2200;
+    }
+
+    qsort(pattern->events, pattern->count, sizeof(StressEvent), compare_events);
+    pattern->length = (uint32_t)((int64_t)ms * rate / 1000);
+}
+
+const char* stress_workload_name(StressWorkload workload) {
+    switch (workload) {
+        case STRESS_CHORDS: return "chords";
+        case STRESS_REPEATS: return "repeats";
+        case STRESS_SUSTAIN: return "sustain";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Stress Pattern (stress_pattern.h)
+ *
+ * A fixed MIDI workload used to measure rendering cost: four note chords,
+ * fast repeated notes whose release tails pile up, and notes held by the
+ * sustain pedal. The generator's preset profiler plays it straight into
+ * FluidSynth; render_bench plays it through the plugin.
+ */
+
+#ifndef STRESS_PATTERN_H
+#define STRESS_PATTERN_H
+
+#include <stdint.h>
+
+// Most events one pattern holds
+#define STRESS_MAX_EVENTS 256
+
+// MIDI status bytes used by the pattern
+#define STRESS_NOTE_ON  0x90
+#define STRESS_NOTE_OFF 0x80
+#define STRESS_CONTROL  0xB0
+
+/* Parts of the pattern, usable alone or together */
+typedef enum {
+    STRESS_CHORDS = 0,      // Four note chords in five registers, held 400 ms each
+    STRESS_REPEATS,         // One key struck 16 times 40 ms apart
+    STRESS_SUSTAIN,         // A scale played with the sustain pedal down for 1.5 s
+    STRESS_WORKLOAD_COUNT
+} StressWorkload;
+
+// Selects every workload in stress_pattern_build()
+#define STRESS_ALL ((1u << STRESS_WORKLOAD_COUNT) - 1)
+
+/* One MIDI event on channel 0 */
+typedef struct {
+    uint32_t frame;     // Frame the event is sent at
+    uint8_t status;     // STRESS_NOTE_ON, STRESS_NOTE_OFF or STRESS_CONTROL
+    uint8_t data1;      // Key or controller
+    uint8_t data2;      // Velocity or controller value
+} StressEvent;
+
+/* A built pattern, events sorted by frame */
+typedef struct {
+    StressEvent events[STRESS_MAX_EVENTS];
+    int count;          // Events used
+    uint32_t length;    // Frames to render, including release tails
+} StressPattern;
+
+/*
+ * Build the workloads selected by mask (bit 1 << StressWorkload), played one
+ * after another, at the given sample rate.
+ */
+void stress_pattern_build(StressPattern* pattern, unsigned mask, uint32_t rate);
+
+/* Short name of a workload, for reports */
+const char* stress_workload_name(StressWorkload workload);
+
+#endif
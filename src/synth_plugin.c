@@ -3,10 +3,29 @@
  * Synthesizer Plugin Runtime (synth_plugin.c)
  *
  * This is the main runtime implementation of the plugin that:
- * 1. Loads a SoundFont file using FluidSynth
+ * 1. Loads the SoundFont named in the bundle configuration using FluidSynth,
+ *    taking its preset table from the preprocessed sample bank when the
+ *    bundle has one
  * 2. Handles MIDI input and program changes
  * 3. Processes real-time parameter controls
  * 4. Generates audio output using FluidSynth
+ * 5. Saves the current program, sound parameters, controller values and a
+ *    histogram of what was played in the LV2 state, applies a restored state
+ *    in one batch and loads the played presets' samples first
+ * 6. Replaces the SoundFont on a patch:Set (or when the watched file is
+ *    saved): a second synth is loaded on the worker thread and swapped in
+ *    between two run() calls
+ * 7. With lazy sample loading, loads a selected preset's samples on the
+ *    worker thread before the next run() switches to it, and reads ahead the sample
+ *    data program changes suggest will be needed next if there is a bank
+ * 8. Accounts for the memory it holds by category, shown on the Memory
+ *    port and written to stderr when the Report port is triggered
+ * 9. Meters its DSP load and voice usage on output ports
+ * 10. Keeps a histogram of how long each phase of run() takes, written to
+ *    stderr with the memory report
+ * 11. Writes the cycles around a deadline miss to a file, if the bundle
+ *    names a directory for recordings
+ * 12. Publishes its counters in a shared memory segment for sf2lv2_top
  *
  * Control Parameters:
  * - Level: Master volume (0.0 - 2.0)
@@ -16,83 +35,303 @@
  * - ADSR: Attack, Decay, Sustain, Release controls (0.0 - 1.0)
  */
 
+// dladdr() locates the bundles for hosts that only call lv2_descriptor()
+#define _GNU_SOURCE
+
 // Required LV2 headers for plugin functionality
 #include <lv2/core/lv2.h>          // Core LV2 functionality
 #include <lv2/atom/atom.h>         // For handling MIDI events
 #include <lv2/atom/util.h>         // Utility functions for atom handling
 #include <lv2/midi/midi.h>         // MIDI event definitions
 #include <lv2/urid/urid.h>         // URI mapping functionality
+#include <lv2/state/state.h>       // State save and restore
+#include <lv2/worker/worker.h>     // Loading SoundFonts off the audio thread
+#include <lv2/patch/patch.h>       // Setting the SoundFont parameter
 
 // FluidSynth header for SoundFont synthesis
 #include <fluidsynth.h>
 
+// Preprocessed sample bank written by ttl_generator
+#include "sf2_bank.h"
+
+// FluidSynth configuration shared with the generator's preset profiler
+#include "synth_settings.h"
+
+// Read-ahead of sample data on a separate thread
+#include "sample_prefetch.h"
+
+// Sample data loaded, computed from the SoundFont's sample tables
+#include "sample_memory.h"
+
+// Histogram of run() durations
+#include "run_timing.h"
+
+// Recordings of the cycles around a deadline miss
+#include "flight_recorder.h"
+
+// USDT tracepoints, compiled in with USDT=1
+#include "probes.h"
+
+// Counters shared with sf2lv2_top
+#include "live_metrics.h"
+
+// Byte counts in the reports
+#include "util.h"
+
+// Values kept in the plugin state
+#include "plugin_state.h"
+
 // Standard C library headers
 #include <stdlib.h>                // For memory allocation
 #include <string.h>                // For string operations
 #include <stdio.h>                 // For debug output
 #include <math.h>                  // For mathematical operations
+#include <sys/mman.h>              // For mapping SoundFonts into memory
+#include <unistd.h>                // For closing the file watch
+#include <stddef.h>                // For worker message sizes
+#include <stdatomic.h>             // For handing restored state to run()
+#include <pthread.h>               // For the SoundFont file watch
+#include <sched.h>                 // For waiting on state_save() before freeing an engine
+#include <poll.h>                  // For waiting on file changes
+#include <sys/inotify.h>           // For watching the SoundFont file
+#include <time.h>                  // For timing run()
+#include <dlfcn.h>                 // For finding the bundle of the binary
+#include <libgen.h>                // For the directory of the binary
+#include <sys/resource.h>          // For counting page faults of preset loads and the mlock limit
 
-/* Plugin name and SF2 file are defined at compile time.
-   If not defined, use "undefined" as fallback values */
-#ifndef PLUGIN_NAME
+/* By default the binary is generic: the same .so is shared by every bundle
+   and reads its plugin URI and SoundFont file from the bundle's sf2lv2.conf.
+   Defining PLUGIN_NAME and SF2_FILE at compile time builds a dedicated
+   single-SoundFont binary instead */
+#if defined(SF2_FILE) && !defined(PLUGIN_NAME)
 #define PLUGIN_NAME "undefined"
 #endif
 
-#ifndef SF2_FILE
-#define SF2_FILE "undefined.sf2"
-#endif
+// Base of every plugin URI, used by LV2 hosts to identify the plugin
+#define PLUGIN_URI_BASE "https://github.com/islainstruments/sf2lv2/"
 
-// Display name used for logging and debugging
-static const char* PLUGIN_DISPLAY_NAME = PLUGIN_NAME;
+// Bundle configuration written by ttl_generator
+#define BUNDLE_CONFIG_FILE "sf2lv2.conf"
 
-// Unique URI for the plugin, used by LV2 hosts to identify the plugin
-#define PLUGIN_URI "https://github.com/islainstruments/sf2lv2/" PLUGIN_NAME
+// Namespace of the properties saved in the plugin state
+#define SF2LV2_NS PLUGIN_URI_BASE "ns#"
 
 // Size of audio processing buffer for FluidSynth
-#define BUFFER_SIZE 64
-
-/* MIDI CC numbers for sound parameters - these match standard MIDI CC assignments
-   for common synthesizer controls */
-#define CC_CUTOFF    74  // Filter cutoff/brightness (Sound Controller 5)
-#define CC_RESONANCE 71  // Filter resonance/timbre (Sound Controller 2)
-#define CC_ATTACK    73  // Attack time
-#define CC_DECAY     75  // Decay time (Sound Controller 6)
-#define CC_SUSTAIN   70  // Sustain level (Sound Controller 1)
-#define CC_RELEASE   72  // Release time
-
-/* Structure to store bank/program pairs for SoundFont presets.
-   Each preset in a SoundFont is identified by a bank and program number */
-typedef struct {
-    int bank;   // MIDI bank number (0-128)
-    int prog;   // MIDI program number (0-127)
-} BankProgram;
+#define BUFFER_SIZE SYNTH_BLOCK_SIZE
+
+// Usage histogram: note-ons per key, per velocity layer of 16 steps and per
+// program. Every count is halved when one reaches the limit, so recent
+// playing outweighs old sessions
+#define VELOCITY_LAYERS 8
+#define HISTOGRAM_LIMIT 65535
+
+// Presets whose samples are loaded on restore, each parked on one of the
+// MIDI channels after channel 0, which is the only one the plugin plays
+#define WARM_PRESETS 8
+
+// Channels a lazy engine holds programs on around a program change: the
+// worker selects the next program on one and the current one on the other,
+// so selecting on channel 0 in run() only counts references to samples
+#define HOLD_CHANNEL_NEXT 14
+#define HOLD_CHANNEL_CURRENT 15
+
+// Voices and rendering threads of a staging synth, which never plays
+#define STAGING_POLYPHONY 1
+#define STAGING_CPU_CORES 1
+
+// Sound parameter ports saved in the plugin state: cutoff to release
+#define SOUND_PARAMETERS 6
+
+// How often the file watch checks whether it should stop or watch another file
+#define WATCH_POLL_MS 250
+
+// Time constant of the DSP load smoothing, in seconds
+#define LOAD_SMOOTHING 0.3
+
+// Default fraction of the block duration beyond which a run() call counts as
+// a deadline miss; bundles can set their own
+#define RUN_DEADLINE 1.0
+
+/* Work scheduled from run() for the worker thread */
+enum {
+    WORK_LOAD = 0,      // Load the SoundFont at path into a new engine
+    WORK_FREE,          // Free an engine swapped out or a state applied by run()
+    WORK_REPORT,        // Write the memory and timing reports
+    WORK_RELOAD,        // Load the bundle's SoundFont again, from its source if known
+    WORK_SELECT,        // Load the samples of a program of a lazy engine before run() selects it
+    WORK_RELEASE        // Unset the hold channels of a lazy engine after run() selected a program
+};
+
+/* Categories of the memory an instance holds */
+typedef enum {
+    MEMORY_SAMPLES = 0,     // Sample data FluidSynth loaded
+    MEMORY_SYNTH,           // FluidSynth voices, channels and mix buffers, estimated
+    MEMORY_PROGRAMS,        // Program table, per-program counts and sample table
+    MEMORY_PLUGIN,          // Instance, audio buffers and read-ahead ring
+    MEMORY_CATEGORIES
+} MemoryCategory;
+
+static const char* const memory_category_names[MEMORY_CATEGORIES] = {
+    "sample data", "synth", "program table", "plugin"
+};
 
 /* Port indices for the plugin's inputs and outputs.
    These must match the TTL file port definitions */
 typedef enum {
-    PORT_EVENTS = 0,      // MIDI input port for receiving MIDI messages
-    PORT_AUDIO_OUT_L = 1, // Left audio output channel
-    PORT_AUDIO_OUT_R = 2, // Right audio output channel
-    PORT_LEVEL = 3,       // Master level control (0.0 to 2.0)
-    PORT_PROGRAM = 4,     // Program selection (0 to program_count-1)
-    PORT_CUTOFF = 5,      // Filter cutoff control (0.0 to 1.0)
-    PORT_RESONANCE = 6,   // Filter resonance control (0.0 to 1.0)
-    PORT_ATTACK = 7,      // Envelope attack control (0.0 to 1.0)
-    PORT_DECAY = 8,       // Envelope decay control (0.0 to 1.0)
-    PORT_SUSTAIN = 9,     // Envelope sustain control (0.0 to 1.0)
-    PORT_RELEASE = 10     // Envelope release control (0.0 to 1.0)
+    PORT_EVENTS = 0,        // MIDI input port for receiving MIDI messages
+    PORT_AUDIO_OUT_L = 1,   // Left audio output channel
+    PORT_AUDIO_OUT_R = 2,   // Right audio output channel
+    PORT_LEVEL = 3,         // Master level control (0.0 to 2.0)
+    PORT_PROGRAM = 4,       // Program selection (0 to program_count-1)
+    PORT_CUTOFF = 5,        // Filter cutoff control (0.0 to 1.0)
+    PORT_RESONANCE = 6,     // Filter resonance control (0.0 to 1.0)
+    PORT_ATTACK = 7,        // Envelope attack control (0.0 to 1.0)
+    PORT_DECAY = 8,         // Envelope decay control (0.0 to 1.0)
+    PORT_SUSTAIN = 9,       // Envelope sustain control (0.0 to 1.0)
+    PORT_RELEASE = 10,      // Envelope release control (0.0 to 1.0)
+    PORT_REPORT = 11,       // Trigger writing the reports
+    PORT_MEMORY = 12,       // Memory held by the instance in MB (output)
+    PORT_LOAD = 13,         // Smoothed DSP load in percent (output)
+    PORT_VOICES = 14,       // Active voices (output)
+    PORT_PEAK_VOICES = 15,  // Most active voices since activation (output)
+    PORT_FULL_POLYPHONY_NOTES = 16 // Note-ons that found every voice in use (output)
 } PortIndex;
 
+/* One plugin served by this binary.
+   The LV2 descriptor is the first member so instantiate() can recover the
+   entry from the descriptor pointer the host passes back */
+typedef struct {
+    LV2_Descriptor descriptor;  // Descriptor handed to the host
+    char uri[512];              // Plugin URI
+    char name[256];             // Display name used for logging
+    char sf2_file[256];         // SoundFont file name inside the bundle
+    char bank_file[256];        // Preprocessed sample bank inside the bundle (optional)
+    int lazy_samples;           // Load sample data only for presets selected on a channel
+    int watch_soundfont;        // Reload the SoundFont when the file changes
+    char source_path[4096];     // SoundFont the bundle was generated from, watched instead (optional)
+    double deadline;            // Fraction of the block duration run() may take, 0 for RUN_DEADLINE
+    char recordings_dir[1024];  // Directory for flight recordings, empty for none
+} PluginEntry;
+
+/* A SoundFont mapped into memory and read through FluidSynth's file callbacks */
+typedef struct {
+    const uint8_t* data;    // Whole mapped file
+    int64_t size;           // Size of the mapping
+    int64_t position;       // Current read position
+} MappedSoundFont;
+
+/* Programs the worker loaded for run() and what loading them found */
+typedef struct {
+    uint64_t count;         // Programs loaded
+    uint64_t resident;      // Bytes of their sample data already in the page cache
+    uint64_t missing;       // Bytes of their sample data read from disk
+    uint64_t hits;          // Programs whose sample data was all in the page cache
+    uint64_t misses;        // Programs with sample data read from disk
+    uint64_t faults;        // Major page faults taken while loading them
+    uint64_t minor_faults;  // Minor page faults taken while loading them
+} PresetLoads;
+
+/* A loaded SoundFont and the synth that plays it.
+   Swapping the SoundFont replaces the whole engine, so run() never sees a
+   synth that is still loading */
+typedef struct Engine {
+    fluid_settings_t* settings;  // FluidSynth configuration settings
+    fluid_synth_t* synth;        // FluidSynth synthesizer instance
+    BankProgram* programs;       // Array of available program bank/number pairs
+    int sfont_id;                // ID of loaded SoundFont
+    int program_count;           // Total number of available programs
+    uint32_t* program_counts;    // Note-ons per program
+    int from_bank;               // Whether the presets came from bank_path
+    int from_bundle;             // Whether path is the bundle's SoundFont or the source it was generated from
+    char path[4096];             // File the SoundFont was loaded from
+    char bank_path[4096];        // Sample bank describing path, empty if none
+    int64_t memory[MEMORY_CATEGORIES]; // Bytes held, by category; samples follow program changes
+    SamplePrefetcher* prefetcher; // Read-ahead of lazily loaded samples, NULL without a bank
+    SampleMemory* sample_memory; // Samples of the selected programs, NULL without lazy loading
+    fluid_settings_t* staging_settings; // Settings of staging
+    fluid_synth_t* staging;      // Synth the worker loads programs on for run(), NULL until needed
+    int staging_sfont_id;        // ID of the SoundFont loaded into staging
+    int held_next;               // Program held on HOLD_CHANNEL_NEXT, -1 if none; worker only
+    int held_current;            // Program held on HOLD_CHANNEL_CURRENT, -1 if none; worker only
+    PresetLoads loads;           // Programs loaded on the worker, written only there
+    struct Engine* next_retired; // Next engine waiting for cleanup() to free it
+} Engine;
+
+/* A message for the worker thread. Only the used part of path is sent */
+typedef struct {
+    uint32_t type;          // WORK_LOAD, WORK_FREE, WORK_REPORT, WORK_RELOAD, WORK_SELECT or WORK_RELEASE
+    Engine* engine;         // Engine to free, report on, load a program for or release
+    struct PendingState* state; // Applied restored state to free
+    int program;            // Program to load
+    int current;            // Program run() plays until then, -1 if none
+    uint32_t serial;        // Selection the program load answers
+    char path[4096];        // SoundFont to load, NUL-terminated
+} WorkMessage;
+
+/* A reply of the worker thread to run() */
+typedef struct {
+    uint32_t type;          // WORK_LOAD for an engine to swap in, WORK_SELECT for a loaded program
+    Engine* engine;         // Engine to swap in, or the one the program was loaded for
+    int program;            // Program loaded
+    int current;            // Program held with it
+    uint32_t serial;        // Selection the program load answers
+} WorkResponse;
+
 /* Structure for URID (URI to integer ID) mapping.
    LV2 uses URIs to identify different types of data.
    These are mapped to integers for efficiency during runtime */
 typedef struct {
     LV2_URID midi_Event;  // Integer ID for MIDI event type URI
+    LV2_URID atom_Int;    // Integer atoms in the saved state
+    LV2_URID atom_Float;  // Float atoms in the saved state
+    LV2_URID atom_Vector; // Vector atoms in the saved state
+    LV2_URID atom_Chunk;  // Raw byte blocks in the saved state
+    LV2_URID state_program;   // Saved current program
+    LV2_URID state_keys;      // Saved note-ons per key
+    LV2_URID state_layers;    // Saved note-ons per velocity layer
+    LV2_URID state_presets;   // Saved most played presets
+    LV2_URID state_parameters; // Saved sound parameter values
+    LV2_URID state_controllers; // Saved controller values of every channel
+    LV2_URID atom_Object; // Objects carrying patch messages
+    LV2_URID atom_Path;   // SoundFont file paths
+    LV2_URID atom_URID;   // Property keys of patch messages
+    LV2_URID patch_Set;       // Set a parameter
+    LV2_URID patch_property;  // Parameter being set
+    LV2_URID patch_value;     // Value it is set to
+    LV2_URID sf2lv2_soundfont; // SoundFont parameter, also the saved SoundFont path
 } URIDs;
 
+/* A vector of integer atoms as stored in the plugin state */
+typedef struct {
+    LV2_Atom_Vector_Body body;      // Element size and type
+    int32_t values[128];            // Elements
+} IntVector;
+
+/* A restored state, built by state_restore() and handed to run() whole,
+   which applies it in one batch without allocating */
+typedef struct PendingState {
+    int program;                                // Program to select, -1 to keep the current one
+    int has_parameters;                         // Whether parameters holds restored values
+    float parameters[SOUND_PARAMETERS];         // Cutoff, resonance, attack, decay, sustain, release
+    int has_controllers;                        // Whether controllers holds restored values
+    uint8_t controllers[STATE_CONTROLLERS];     // Controller values of channel 0
+    Engine* engine;                             // SoundFont to swap in first, NULL to keep the current one
+    int prepared;                               // Whether engine already plays program with the controllers
+    uint32_t key_counts[128];                   // Restored note-ons per MIDI key
+    uint32_t layer_counts[VELOCITY_LAYERS];     // Restored note-ons per velocity layer
+    const Engine* counts_engine;                // Engine hot and hot_counts index, NULL if engine has its counts
+    int hot[WARM_PRESETS];                      // Most played programs of counts_engine
+    uint32_t hot_counts[WARM_PRESETS];          // Their note-ons
+    int hot_count;                              // Entries in hot
+    struct PendingState* next_retired;          // Next applied state waiting for cleanup() to free it
+} PendingState;
+
 /* Main plugin instance structure.
    Contains all state and data needed for plugin operation */
 typedef struct {
+    // Plugin identity
+    const PluginEntry* entry;  // URI, name and SoundFont of this instance
+
     // LV2 host features
     LV2_URID_Map* map;    // Host-provided URID mapping feature
     URIDs urids;          // Our mapped URIDs for event handling
@@ -109,17 +348,24 @@ typedef struct {
     float* decay_port;     // Control value for envelope decay
     float* sustain_port;   // Control value for envelope sustain
     float* release_port;   // Control value for envelope release
+    float* report_port;    // Trigger for the reports
+    float* memory_port;    // Output of the memory held in MB
+    float* load_port;      // Output of the smoothed DSP load
+    float* voices_port;    // Output of the active voices
+    float* peak_voices_port;   // Output of the most active voices
+    float* full_polyphony_notes_port; // Output of the note-ons at full polyphony
 
     // Debug flag for logging
     bool debug;           // When true, outputs debug information to stderr
 
-    // FluidSynth engine instances and state
-    fluid_settings_t* settings;  // FluidSynth configuration settings
-    fluid_synth_t* synth;       // FluidSynth synthesizer instance
+    // FluidSynth engine and state
+    _Atomic(Engine*) engine;    // Loaded SoundFont and its synth, replaced only by run()
+    atomic_int saving;          // state_save() calls using the engine, which the worker does not free meanwhile
     int current_program;        // Currently selected program number
-    BankProgram* programs;      // Array of available program bank/number pairs
-    int sfont_id;              // ID of loaded SoundFont
-    int program_count;         // Total number of available programs
+    int requested_program;      // Program the worker is loading for run(), -1 if none
+    int keep_controllers;       // Whether requested_program comes from a restored state with controllers
+    int staged_program;         // requested_program once the worker loaded it, for run() to select; -1 if none
+    uint32_t select_serial;     // Number of the latest program load asked of the worker
 
     // Audio processing buffers
     char* bundle_path;     // Path to plugin's resource directory
@@ -134,38 +380,246 @@ typedef struct {
     float prev_decay;      // Previous value of decay control
     float prev_sustain;    // Previous value of sustain control
     float prev_release;    // Previous value of release control
+    float prev_report;     // Previous value of report trigger
+
+    // Usage histogram, saved in the plugin state for the warm start;
+    // the per-program counts belong to the engine
+    uint32_t key_counts[128];               // Note-ons per MIDI key
+    uint32_t layer_counts[VELOCITY_LAYERS]; // Note-ons per velocity layer
+
+    // Restored state waiting to be applied by run(); whoever exchanges it out owns it
+    _Atomic(PendingState*) pending;
+    PendingState* retired_states;           // Applied states the worker could not free
+
+    // SoundFont swapping
+    LV2_Worker_Schedule* schedule;  // Host-provided worker feature, NULL without one
+    Engine* retired;                // Swapped out engines the worker could not free
+    pthread_t watch_thread;         // Thread watching the SoundFont file
+    int watching;                   // Whether watch_thread was started
+    atomic_int watch_stop;          // Tells watch_thread to exit
+    atomic_int reload_requested;    // Set by watch_thread when the file changed
+    pthread_mutex_t watch_lock;     // Guards watch_path
+    char watch_path[4096];          // File watch_thread watches
+
+    // Bytes held by the instance itself, by category; engines keep their own
+    int64_t memory[MEMORY_CATEGORIES];
+
+    // Load meters, reset by activate()
+    double load;                // Smoothed share of the block duration run() takes
+    int voices;                 // Voices active at the last count, after a note-on or rendering
+    int peak_voices;            // Most voices active at once
+    uint32_t full_polyphony_notes; // Note-ons that found every voice in use and ended one
+
+    // Durations of run() and its phases
+    RunTiming timing;           // Histograms, written only by run()
+    double deadline;            // Fraction of the block duration run() may take
+    double deadline_ns_per_frame; // deadline as ns per frame at the sample rate
+    FlightRecorder* recorder;   // Recorder of the cycles around a miss, NULL if not configured
+
+    // Slot in the process's live metrics segment, NULL without shared memory
+    LiveMetricsSlot* metrics;
 } Plugin;
 
+/* Monotonic time in nanoseconds */
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * FluidSynth file callbacks.
+ * SoundFonts are mapped instead of read through stdio, so reads copy from
+ * the file's pages in the page cache without a stdio buffer. Only those
+ * file pages are shared between instances; the samples FluidSynth loads
+ * are copies it allocates.
+ */
+static void* mapped_open(const char* path) {
+    size_t map_size;
+    void* map = map_file(path, &map_size);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    MappedSoundFont* file = (MappedSoundFont*)calloc(1, sizeof(MappedSoundFont));
+    if (!file) {
+        munmap(map, map_size);
+        return NULL;
+    }
+    file->data = (const uint8_t*)map;
+    file->size = (int64_t)map_size;
+    return file;
+}
+
+static int mapped_read(void* buffer, fluid_long_long_t count, void* handle) {
+    MappedSoundFont* file = (MappedSoundFont*)handle;
+    if (count < 0 || count > file->size - file->position) {
+        return FLUID_FAILED;
+    }
+    memcpy(buffer, file->data + file->position, (size_t)count);
+    file->position += count;
+    return FLUID_OK;
+}
+
+static int mapped_seek(void* handle, fluid_long_long_t offset, int origin) {
+    MappedSoundFont* file = (MappedSoundFont*)handle;
+    int64_t position;
+    switch (origin) {
+        case SEEK_SET: position = offset; break;
+        case SEEK_CUR: position = file->position + offset; break;
+        case SEEK_END: position = file->size + offset; break;
+        default: return FLUID_FAILED;
+    }
+    if (position < 0 || position > file->size) {
+        return FLUID_FAILED;
+    }
+    file->position = position;
+    return FLUID_OK;
+}
+
+static fluid_long_long_t mapped_tell(void* handle) {
+    return ((MappedSoundFont*)handle)->position;
+}
+
+static int mapped_close(void* handle) {
+    MappedSoundFont* file = (MappedSoundFont*)handle;
+    munmap((void*)file->data, (size_t)file->size);
+    free(file);
+    return FLUID_OK;
+}
+
+/*
+ * Resident set size of the process in bytes, from /proc/self/statm.
+ * Returns -1 if it cannot be read.
+ */
+static int64_t resident_bytes(void) {
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return -1;
+    }
+    long long size, resident;
+    int fields = fscanf(file, "%lld %lld", &size, &resident);
+    fclose(file);
+    if (fields != 2) {
+        return -1;
+    }
+    return (int64_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+/* Bytes the process has locked in memory (VmLck), -1 if unknown */
+static int64_t locked_bytes(void) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) {
+        return -1;
+    }
+    char line[256];
+    long long locked = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmLck: %lld kB", &locked) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return locked < 0 ? -1 : (int64_t)locked * 1024;
+}
+
+/*
+ * Take the preset table of the loaded SoundFont from its sample bank
+ * instead of probing every bank/program pair. The bank must describe the
+ * SoundFont file: sf2_bank_matches() compares its size and hashes its
+ * preset data list, which only touches the pdta pages of the mapping and
+ * none of the sample data.
+ * Returns 0 on success, -1 if there is no bank or it does not describe
+ * the SoundFont.
+ */
+static int load_bank(Engine* engine, bool debug) {
+    const char* bank_path = engine->bank_path;
+    if (!bank_path[0]) {
+        return -1;
+    }
+
+    size_t map_size;
+    void* map = map_file(bank_path, &map_size);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    const SF2BankHeader* bank = sf2_bank_validate(map, map_size);
+    if (!bank || bank->preset_count == 0) {
+        fprintf(stderr, "Ignoring invalid sample bank: %s\n", bank_path);
+        munmap(map, map_size);
+        return -1;
+    }
+
+    size_t sf_size;
+    void* sf_map = map_file(engine->path, &sf_size);
+    int matches = sf_map != MAP_FAILED && sf2_bank_matches(bank, sf_map, sf_size);
+    if (sf_map != MAP_FAILED) {
+        munmap(sf_map, sf_size);
+    }
+    if (!matches) {
+        fprintf(stderr, "Ignoring sample bank that does not match %s: %s\n", engine->path, bank_path);
+        munmap(map, map_size);
+        return -1;
+    }
+
+    const SF2BankPreset* presets = sf2_bank_presets(bank);
+    engine->programs = (BankProgram*)calloc(bank->preset_count, sizeof(BankProgram));
+    if (!engine->programs) {
+        munmap(map, map_size);
+        return -1;
+    }
+    for (uint32_t i = 0; i < bank->preset_count; i++) {
+        engine->programs[i].bank = presets[i].bank;
+        engine->programs[i].prog = presets[i].prog;
+        if (debug) {
+            fprintf(stderr, "Stored program %u: bank=%d prog=%d name=%s\n",
+                    i, presets[i].bank, presets[i].prog, presets[i].name);
+        }
+    }
+    engine->program_count = (int)bank->preset_count;
+    engine->from_bank = 1;
+
+    munmap(map, map_size);
+    return 0;
+}
+
 /*
  * Load and initialize the SoundFont file.
  * This function:
  * 1. Loads the specified SoundFont file
- * 2. Scans it for available presets
+ * 2. Takes its preset table from the sample bank if that matches, or else
+ *    scans it for available presets
  * 3. Stores preset information for program changes
  * Returns: The SoundFont ID if successful, -1 on failure
  */
-static int load_soundfont(Plugin* plugin) {
-    // Construct the full path to the SoundFont file by combining bundle path and filename
-    char sf_path[4096];
-    snprintf(sf_path, sizeof(sf_path), "%s/%s", plugin->bundle_path, SF2_FILE);
-    if (plugin->debug) {
+static int load_soundfont(Engine* engine, bool debug) {
+    const char* sf_path = engine->path;
+    if (debug) {
         fprintf(stderr, "Loading soundfont from: %s\n", sf_path);
     }
     
     // Load the SoundFont into FluidSynth (1 = reset presets)
-    plugin->sfont_id = fluid_synth_sfload(plugin->synth, sf_path, 1);
-    if (plugin->sfont_id == FLUID_FAILED) {
+    engine->sfont_id = fluid_synth_sfload(engine->synth, sf_path, 1);
+    if (engine->sfont_id == FLUID_FAILED) {
         fprintf(stderr, "Failed to load SoundFont: %s\n", sf_path);
         return -1;
     }
 
     // Get a handle to the loaded SoundFont for preset scanning
-    fluid_sfont_t* sfont = fluid_synth_get_sfont(plugin->synth, 0);
+    fluid_sfont_t* sfont = fluid_synth_get_sfont_by_id(engine->synth, engine->sfont_id);
     if (!sfont) {
         fprintf(stderr, "Failed to get soundfont instance\n");
         return -1;
     }
 
+    // A matching sample bank brings the preset table
+    if (load_bank(engine, debug) == 0) {
+        if (debug) {
+            fprintf(stderr, "Loaded sample bank with %d presets\n", engine->program_count);
+        }
+        return engine->sfont_id;
+    }
+
     // First pass: Count total available presets across all banks
     size_t preset_count = 0;
     for (int bank = 0; bank <= 128; bank++) {          // Bank 128 is percussion
@@ -176,14 +630,14 @@ static int load_soundfont(Plugin* plugin) {
         }
     }
 
-    if (plugin->debug) {
+    if (debug) {
         fprintf(stderr, "Found %zu total presets in soundfont\n", preset_count);
     }
-    plugin->program_count = preset_count;
+    engine->program_count = preset_count;
 
     // Allocate memory to store information about each preset
-    plugin->programs = (BankProgram*)calloc(preset_count, sizeof(BankProgram));
-    if (!plugin->programs) {
+    engine->programs = (BankProgram*)calloc(preset_count, sizeof(BankProgram));
+    if (!engine->programs) {
         fprintf(stderr, "Failed to allocate program array\n");
         return -1;
     }
@@ -195,9 +649,9 @@ static int load_soundfont(Plugin* plugin) {
             fluid_preset_t* preset = fluid_sfont_get_preset(sfont, bank, prog);
             if (preset != NULL) {
                 // Store the bank and program numbers for this preset
-                plugin->programs[idx].bank = bank;
-                plugin->programs[idx].prog = prog;
-                if (plugin->debug) {
+                engine->programs[idx].bank = bank;
+                engine->programs[idx].prog = prog;
+                if (debug) {
                     fprintf(stderr, "Stored program %d: bank=%d prog=%d name=%s\n",
                             idx, bank, prog, fluid_preset_get_name(preset));
                 }
@@ -206,7 +660,173 @@ static int load_soundfont(Plugin* plugin) {
         }
     }
     
-    return plugin->sfont_id;  // Return the SoundFont ID for success
+    return engine->sfont_id;  // Return the SoundFont ID for success
+}
+
+/* Make a synth read SoundFonts through memory mappings */
+static void add_mapped_loader(fluid_settings_t* settings, fluid_synth_t* synth) {
+    fluid_sfloader_t* loader = new_fluid_defsfloader(settings);
+    if (loader) {
+        fluid_sfloader_set_callbacks(loader, mapped_open, mapped_read,
+                                     mapped_seek, mapped_tell, mapped_close);
+        fluid_synth_add_sfloader(synth, loader);
+    }
+}
+
+/* Find a bank/program pair in the program table. Returns -1 if absent */
+static int find_program(const Engine* engine, int bank, int prog) {
+    for (int i = 0; i < engine->program_count; i++) {
+        if (engine->programs[i].bank == bank && engine->programs[i].prog == prog) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Follow the selection of a program on a channel of a lazy engine, or on
+ * its staging synth, in the sample data it holds. -1 unsets the channel.
+ * Does not block or allocate.
+ */
+static void account_program(Engine* engine, int channel, int program) {
+    if (engine->sample_memory) {
+        sample_memory_select(engine->sample_memory, channel, program);
+        engine->memory[MEMORY_SAMPLES] = sample_memory_loaded(engine->sample_memory);
+    }
+}
+
+/*
+ * Free an engine and everything it loaded.
+ * Never called from run(): deleting a synth frees its samples.
+ */
+static void free_engine(Engine* engine) {
+    if (!engine) {
+        return;
+    }
+    sample_prefetch_stop(engine->prefetcher);
+    sample_memory_free(engine->sample_memory);
+    if (engine->staging) delete_fluid_synth(engine->staging);
+    if (engine->staging_settings) delete_fluid_settings(engine->staging_settings);
+    if (engine->synth) delete_fluid_synth(engine->synth);
+    if (engine->settings) delete_fluid_settings(engine->settings);
+    free(engine->programs);
+    free(engine->program_counts);
+    free(engine);
+}
+
+/*
+ * Create a synth and load a SoundFont into it, with the preset table of
+ * its sample bank if bank_path is not NULL and the bank matches.
+ * Returns NULL on failure.
+ */
+static Engine* load_engine(const Plugin* plugin, const char* path, const char* bank_path) {
+    Engine* engine = (Engine*)calloc(1, sizeof(Engine));
+    if (!engine) {
+        return NULL;
+    }
+    snprintf(engine->path, sizeof(engine->path), "%s", path);
+    snprintf(engine->bank_path, sizeof(engine->bank_path), "%s", bank_path ? bank_path : "");
+    engine->held_next = -1;
+    engine->held_current = -1;
+
+    // Initialize FluidSynth settings for optimal performance
+    engine->settings = new_fluid_settings();
+    if (!engine->settings) {
+        free(engine);
+        return NULL;
+    }
+    synth_configure(engine->settings, plugin->rate);
+
+    // Lazy bundles load sample data only for presets selected on a channel
+    if (plugin->entry->lazy_samples) {
+        fluid_settings_setint(engine->settings, "synth.dynamic-sample-loading", 1);
+    }
+
+    engine->synth = new_fluid_synth(engine->settings);
+    if (!engine->synth) {
+        free_engine(engine);
+        return NULL;
+    }
+
+    // Read SoundFonts through memory mappings
+    add_mapped_loader(engine->settings, engine->synth);
+
+    // Load the SoundFont, with the preset table of its bank if it has one
+    if (load_soundfont(engine, plugin->debug) < 0) {
+        free_engine(engine);
+        return NULL;
+    }
+
+    // FluidSynth does not report what it allocates, so the sample data is
+    // computed from the sample tables: the whole sample chunk is loaded,
+    // unless loading is lazy. Loading selects a preset on every channel;
+    // lazy bundles keep only channel 0's, bank 0 program 0
+    const char* tables = engine->from_bank ? engine->bank_path : NULL;
+    if (plugin->entry->lazy_samples) {
+        for (int channel = 1; channel < 16; channel++) {
+            fluid_synth_unset_program(engine->synth, channel);
+        }
+        engine->sample_memory = sample_memory_open(engine->path, tables, engine->program_count);
+        account_program(engine, 0, find_program(engine, 0, 0));
+    } else {
+        int64_t chunk_size = sample_memory_chunk_size(engine->path, tables);
+        engine->memory[MEMORY_SAMPLES] = chunk_size > 0 ? chunk_size : 0;
+    }
+
+    engine->memory[MEMORY_SYNTH] = synth_memory_estimate(SYNTH_POLYPHONY, SYNTH_CHANNELS, SYNTH_CPU_CORES);
+
+    engine->program_counts = (uint32_t*)calloc(engine->program_count + 1, sizeof(uint32_t));
+    if (!engine->program_counts) {
+        free_engine(engine);
+        return NULL;
+    }
+    engine->memory[MEMORY_PROGRAMS] = sizeof(Engine) +
+        engine->program_count * sizeof(BankProgram) +
+        (engine->program_count + 1) * sizeof(uint32_t) +
+        (engine->sample_memory ? sample_memory_size(engine->sample_memory) : 0);
+
+    // Lazily loaded samples are read on program changes; read them ahead with the bank's zones
+    if (plugin->entry->lazy_samples && engine->from_bank) {
+        engine->prefetcher = sample_prefetch_start(engine->bank_path, engine->path);
+    }
+    if (engine->prefetcher) {
+        SamplePrefetchMemory prefetch;
+        sample_prefetch_memory(engine->prefetcher, &prefetch);
+        engine->memory[MEMORY_PLUGIN] = (int64_t)prefetch.allocated;
+    }
+    return engine;
+}
+
+/*
+ * Load an engine between the load_start and load_end probes.
+ * Used when the plugin is instantiated and, on the worker thread, to load
+ * the SoundFont that replaces the current one.
+ * Returns NULL on failure.
+ */
+static Engine* create_engine(const Plugin* plugin, const char* path, const char* bank_path) {
+    PROBE1(load_start, path);
+    Engine* engine = load_engine(plugin, path, bank_path);
+    PROBE2(load_end, path, engine ? engine->program_count : -1);
+    return engine;
+}
+
+/*
+ * Load the bundle's own SoundFont, with its sample bank if it has one.
+ * A source path loads the file the bundle was generated from instead,
+ * whose edits a reload picks up; the bank is only used while it still
+ * matches. Either way the engine keeps the bundle as its origin.
+ * Returns NULL on failure.
+ */
+static Engine* create_bundle_engine(const Plugin* plugin, const char* source_path) {
+    char path[4096], bank_path[4096];
+    snprintf(path, sizeof(path), "%s/%s", plugin->bundle_path, plugin->entry->sf2_file);
+    snprintf(bank_path, sizeof(bank_path), "%s/%s", plugin->bundle_path, plugin->entry->bank_file);
+    Engine* engine = create_engine(plugin, source_path ? source_path : path,
+                                   plugin->entry->bank_file[0] ? bank_path : NULL);
+    if (engine) {
+        engine->from_bundle = 1;
+    }
+    return engine;
 }
 
 /*
@@ -214,92 +834,790 @@ static int load_soundfont(Plugin* plugin) {
  */
 static void map_uris(LV2_URID_Map* map, URIDs* uris) {
     uris->midi_Event = map->map(map->handle, LV2_MIDI__MidiEvent);
+    uris->atom_Int = map->map(map->handle, LV2_ATOM__Int);
+    uris->atom_Float = map->map(map->handle, LV2_ATOM__Float);
+    uris->atom_Vector = map->map(map->handle, LV2_ATOM__Vector);
+    uris->atom_Chunk = map->map(map->handle, LV2_ATOM__Chunk);
+    uris->state_program = map->map(map->handle, SF2LV2_NS "program");
+    uris->state_keys = map->map(map->handle, SF2LV2_NS "keyHistogram");
+    uris->state_layers = map->map(map->handle, SF2LV2_NS "velocityHistogram");
+    uris->state_presets = map->map(map->handle, SF2LV2_NS "presetHistogram");
+    uris->state_parameters = map->map(map->handle, SF2LV2_NS "soundParameters");
+    uris->state_controllers = map->map(map->handle, SF2LV2_NS "controllers");
+    uris->atom_Object = map->map(map->handle, LV2_ATOM__Object);
+    uris->atom_Path = map->map(map->handle, LV2_ATOM__Path);
+    uris->atom_URID = map->map(map->handle, LV2_ATOM__URID);
+    uris->patch_Set = map->map(map->handle, LV2_PATCH__Set);
+    uris->patch_property = map->map(map->handle, LV2_PATCH__property);
+    uris->patch_value = map->map(map->handle, LV2_PATCH__value);
+    uris->sf2lv2_soundfont = map->map(map->handle, SF2LV2_NS "soundfont");
+}
+
+/*
+ * Start a note on channel 0 from run(). Voices only end while rendering or
+ * on a sound off, so the count taken after the last note-on or rendering
+ * tells when the synth may be full; then the count is read again before
+ * the note-on. A note-on that found every voice in use and left the count
+ * there had to end a voice to start its own.
+ */
+static void play_note(Plugin* plugin, int key, int velocity) {
+    fluid_synth_t* synth = plugin->engine->synth;
+    int before = plugin->voices >= SYNTH_POLYPHONY ? fluid_synth_get_active_voice_count(synth) : 0;
+    fluid_synth_noteon(synth, 0, key, velocity);
+    plugin->voices = fluid_synth_get_active_voice_count(synth);
+    if (before >= SYNTH_POLYPHONY && plugin->voices >= before) {
+        plugin->full_polyphony_notes++;
+    }
+}
+
+/*
+ * Count a note-on in the usage histogram.
+ * Runs in the audio thread: every count is halved when one reaches the limit.
+ */
+static void record_note(Plugin* plugin, int key, int velocity) {
+    Engine* engine = plugin->engine;
+    int layer = velocity * VELOCITY_LAYERS / 128;
+    int program = plugin->current_program;
+    int has_program = program >= 0 && program < engine->program_count;
+
+    if (plugin->key_counts[key] >= HISTOGRAM_LIMIT || plugin->layer_counts[layer] >= HISTOGRAM_LIMIT ||
+        (has_program && engine->program_counts[program] >= HISTOGRAM_LIMIT)) {
+        for (int i = 0; i < 128; i++) plugin->key_counts[i] /= 2;
+        for (int i = 0; i < VELOCITY_LAYERS; i++) plugin->layer_counts[i] /= 2;
+        for (int i = 0; i < engine->program_count; i++) engine->program_counts[i] /= 2;
+    }
+    plugin->key_counts[key]++;
+    plugin->layer_counts[layer]++;
+    if (has_program) {
+        engine->program_counts[program]++;
+    }
+}
+
+/* Check whether a bank zone covers a played key and a played velocity layer */
+static int zone_was_played(const PendingState* state, const SF2BankZone* zone) {
+    int key_played = 0, layer_played = 0;
+    for (int key = zone->key_lo; key <= zone->key_hi && key < 128; key++) {
+        key_played |= state->key_counts[key] > 0;
+    }
+    for (int layer = zone->vel_lo * VELOCITY_LAYERS / 128;
+         layer <= zone->vel_hi * VELOCITY_LAYERS / 128 && layer < VELOCITY_LAYERS; layer++) {
+        layer_played |= state->layer_counts[layer] > 0;
+    }
+    return key_played && layer_played;
 }
 
 /*
- * Handle program changes with proper bank selection
+ * Read ahead the sample data of the given programs, using the zone table of
+ * the engine's sample bank. Only zones covering a key and velocity layer
+ * played in the restored state are read, or every zone if no notes were
+ * recorded. The pages land
+ * in the page cache, where FluidSynth finds them when it loads the samples.
  */
-static void handle_program_change(Plugin* plugin, int program) {
-    if (program < 0 || program >= plugin->program_count) {
+static void prefetch_bank_zones(const PendingState* state, const Engine* engine, const int* programs, int count) {
+    size_t bank_size, map_size;
+    void* bank_map = map_file(engine->bank_path, &bank_size);
+    if (bank_map == MAP_FAILED) {
+        return;
+    }
+    const SF2BankHeader* bank = sf2_bank_validate(bank_map, bank_size);
+    void* map = bank ? map_file(engine->path, &map_size) : MAP_FAILED;
+    if (map == MAP_FAILED) {
+        munmap(bank_map, bank_size);
+        return;
+    }
+
+    int any_notes = 0;
+    for (int key = 0; key < 128; key++) {
+        any_notes |= state->key_counts[key] > 0;
+    }
+    uint64_t page_mask = ~(uint64_t)(sysconf(_SC_PAGESIZE) - 1);
+    const SF2BankPreset* presets = sf2_bank_presets(bank);
+    const SF2BankZone* zones = sf2_bank_zones(bank);
+    for (int i = 0; i < count; i++) {
+        if (programs[i] < 0 || (uint32_t)programs[i] >= bank->preset_count) {
+            continue;
+        }
+        const SF2BankPreset* preset = &presets[programs[i]];
+        for (uint32_t z = preset->zone_start; z < preset->zone_start + preset->zone_count; z++) {
+            if (any_notes && !zone_was_played(state, &zones[z])) {
+                continue;
+            }
+            uint64_t start = zones[z].data_offset & page_mask;
+            uint64_t end = zones[z].data_offset + zones[z].data_size;
+            if (end <= map_size) {
+                madvise((uint8_t*)map + start, end - start, MADV_WILLNEED);
+            }
+        }
+    }
+    munmap(map, map_size);
+    munmap(bank_map, bank_size);
+}
+
+/*
+ * List the programs a restored state says will be played: the saved
+ * program, then the most played presets, most played first.
+ * Returns the number of programs written to programs (at most WARM_PRESETS).
+ */
+static int restored_programs(const PendingState* state, const Engine* engine, int* programs) {
+    int count = 0;
+    if (state->program >= 0 && state->program < engine->program_count) {
+        programs[count++] = state->program;
+    }
+    for (int i = 0; i < state->hot_count && count < WARM_PRESETS; i++) {
+        if (state->hot[i] != state->program) {
+            programs[count++] = state->hot[i];
+        }
+    }
+    return count;
+}
+
+/*
+ * Report samples FluidSynth could not lock after loading expected bytes of
+ * them, which it only logs: fewer bytes locked than loaded while the
+ * process is at its RLIMIT_MEMLOCK. Samples other instances already hold
+ * are not locked again, so a shortfall alone says nothing.
+ */
+static void check_locked(const Plugin* plugin, int64_t locked_before, int64_t expected) {
+    struct rlimit limit;
+    int64_t locked = locked_bytes();
+    if (locked_before < 0 || locked < 0 || expected <= 0 ||
+        getrlimit(RLIMIT_MEMLOCK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return;
+    }
+    int64_t shortfall = expected - (locked - locked_before);
+    if (shortfall > 0 && locked + shortfall > (int64_t)limit.rlim_cur) {
+        char text[32], limit_text[32];
+        fprintf(stderr, "%s: could not lock %s of samples in memory (RLIMIT_MEMLOCK %s); "
+                "they may page out\n", plugin->entry->name,
+                format_bytes(shortfall, text, sizeof(text)),
+                format_bytes((int64_t)limit.rlim_cur, limit_text, sizeof(limit_text)));
+    }
+}
+
+/*
+ * Load the samples the restored state says will be played, before the
+ * transport starts. The saved program and the most played presets are
+ * parked on MIDI channels the plugin does not play; with lazy sample
+ * loading FluidSynth then loads and locks their samples now instead of
+ * on the first program change. Without lazy loading every sample was
+ * loaded and locked with the SoundFont, so there is nothing to warm. The
+ * zones are only read ahead first if the bundle has a sample bank. The
+ * engine must not be the one run() plays: restore warms a new engine
+ * before it is swapped in.
+ */
+static void warm_start(const Plugin* plugin, Engine* engine, const PendingState* state) {
+    if (!plugin->entry->lazy_samples) {
+        return;
+    }
+    int64_t locked_before = locked_bytes();
+    int64_t loaded_before = engine->memory[MEMORY_SAMPLES];
+
+    int programs[WARM_PRESETS];
+    int count = restored_programs(state, engine, programs);
+
+    if (engine->from_bank) {
+        prefetch_bank_zones(state, engine, programs, count);
+    }
+    for (int i = 0; i < WARM_PRESETS; i++) {
+        if (i < count) {
+            fluid_synth_program_select(engine->synth, 1 + i, engine->sfont_id,
+                                       engine->programs[programs[i]].bank, engine->programs[programs[i]].prog);
+        } else {
+            fluid_synth_unset_program(engine->synth, 1 + i);
+        }
+        account_program(engine, 1 + i, i < count ? programs[i] : -1);
+        if (plugin->debug && i < count) {
+            fprintf(stderr, "Warm start: program %d parked on channel %d\n", programs[i], 1 + i);
+        }
+    }
+    check_locked(plugin, locked_before, engine->memory[MEMORY_SAMPLES] - loaded_before);
+}
+
+/*
+ * Handle program changes with proper bank selection. keep_controllers
+ * skips the sound control reset, for a program selected after restored
+ * controller values were sent.
+ */
+static void handle_program_change(Plugin* plugin, int program, int keep_controllers) {
+    if (program < 0 || program >= plugin->engine->program_count) {
         if (plugin->debug) {
             fprintf(stderr, "Invalid program number: %d (max: %d)\n", 
-                    program, plugin->program_count - 1);
+                    program, plugin->engine->program_count - 1);
         }
         return;
     }
 
     // Reset all notes and sounds
-    fluid_synth_all_notes_off(plugin->synth, -1);
-    fluid_synth_all_sounds_off(plugin->synth, -1);
+    fluid_synth_all_notes_off(plugin->engine->synth, -1);
+    fluid_synth_all_sounds_off(plugin->engine->synth, -1);
 
-    int bank = plugin->programs[program].bank;
-    int prog = plugin->programs[program].prog;
+    int bank = plugin->engine->programs[program].bank;
+    int prog = plugin->engine->programs[program].prog;
+    PROBE3(program_change, program, bank, prog);
 
     if (plugin->debug) {
         fprintf(stderr, "Changing to program %d (bank:%d prog:%d)\n", 
                 program, bank, prog);
     }
 
-    // Reset CCs (cutoff to max, others to 0)
-    fluid_synth_cc(plugin->synth, 0, CC_CUTOFF, 127);    // Cutoff fully open
-    fluid_synth_cc(plugin->synth, 0, CC_RESONANCE, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_ATTACK, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_DECAY, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_SUSTAIN, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_RELEASE, 0);
-
-    // Send bank select first
-    fluid_synth_bank_select(plugin->synth, 0, bank);
-    
-    // Then send program change
-    int result = fluid_synth_program_change(plugin->synth, 0, prog);
+    // Reset CCs (cutoff to max, others to 0), then send bank select and program change
+    int result;
+    if (keep_controllers) {
+        fluid_synth_bank_select(plugin->engine->synth, 0, bank);
+        result = fluid_synth_program_change(plugin->engine->synth, 0, prog);
+    } else {
+        result = synth_select_program(plugin->engine->synth, bank, prog);
+    }
     
     if (result != FLUID_OK) {
         if (plugin->debug) {
             fprintf(stderr, "Failed to change program: bank=%d prog=%d\n", bank, prog);
         }
+    } else {
+        account_program(plugin->engine, 0, program);
+    }
+
+    if (plugin->debug) {
+        // Debug output showing FluidSynth CC values
+        int cc_value;
+        fprintf(stderr, "CC values after program change:\n");
+        
+        fluid_synth_get_cc(plugin->engine->synth, 0, CC_CUTOFF, &cc_value);
+        fprintf(stderr, "  Cutoff (CC%d): %d\n", CC_CUTOFF, cc_value);
+        
+        fluid_synth_get_cc(plugin->engine->synth, 0, CC_RESONANCE, &cc_value);
+        fprintf(stderr, "  Resonance (CC%d): %d\n", CC_RESONANCE, cc_value);
+        
+        fluid_synth_get_cc(plugin->engine->synth, 0, CC_ATTACK, &cc_value);
+        fprintf(stderr, "  Attack (CC%d): %d\n", CC_ATTACK, cc_value);
+        
+        fluid_synth_get_cc(plugin->engine->synth, 0, CC_DECAY, &cc_value);
+        fprintf(stderr, "  Decay (CC%d): %d\n", CC_DECAY, cc_value);
+        
+        fluid_synth_get_cc(plugin->engine->synth, 0, CC_SUSTAIN, &cc_value);
+        fprintf(stderr, "  Sustain (CC%d): %d\n", CC_SUSTAIN, cc_value);
+        
+        fluid_synth_get_cc(plugin->engine->synth, 0, CC_RELEASE, &cc_value);
+        fprintf(stderr, "  Release (CC%d): %d\n", CC_RELEASE, cc_value);
+    }
+}
+
+/*
+ * Select a program from run(). On a lazy engine the worker has selected it
+ * on HOLD_CHANNEL_NEXT first, and the current one on HOLD_CHANNEL_CURRENT,
+ * so FluidSynth only counts references to samples it already holds.
+ */
+static void select_program(Plugin* plugin, int program, int keep_controllers) {
+    handle_program_change(plugin, program, keep_controllers);
+    plugin->current_program = program;
+}
+
+/*
+ * Hold a program on a channel of a lazy engine's synth from the worker,
+ * -1 to unset the channel. held is the program the channel holds now; a
+ * program already held is left alone.
+ */
+static void hold_program(Engine* engine, int channel, int* held, int program) {
+    if (*held == program) {
+        return;
+    }
+    if (program >= 0) {
+        fluid_synth_program_select(engine->synth, channel, engine->sfont_id,
+                                   engine->programs[program].bank, engine->programs[program].prog);
+    } else {
+        fluid_synth_unset_program(engine->synth, channel);
+    }
+    *held = program;
+}
+
+/*
+ * Load the samples of a program of a lazy engine on the worker thread,
+ * before run() selects it in place of current. The program is first
+ * selected on the engine's staging synth, which reads its samples into
+ * FluidSynth's sample cache without taking the lock of the synth run()
+ * plays. It is then selected on HOLD_CHANNEL_NEXT of that synth, and
+ * current on HOLD_CHANNEL_CURRENT: FluidSynth counts sample references per
+ * SoundFont, so only the synth's own channels spare run() from opening the
+ * SoundFont, allocating and optimizing the samples again. The staging
+ * synth keeps the program selected until the next one, so the cache holds
+ * on to its samples meanwhile. Counts how much of the sample data was in
+ * the page cache and the page faults taken.
+ */
+static void load_program_samples(Engine* engine, int program, int current) {
+    if (program < 0 || program >= engine->program_count) {
+        return;
+    }
+    if (!engine->staging && engine->staging_settings == NULL) {
+        // One voice and no extra rendering threads: the staging synth never plays.
+        // If it cannot be created, the hold channels read the samples themselves
+        engine->staging_settings = new_fluid_settings();
+        if (engine->staging_settings) {
+            fluid_settings_setint(engine->staging_settings, "synth.dynamic-sample-loading", 1);
+            fluid_settings_setint(engine->staging_settings, "synth.polyphony", STAGING_POLYPHONY);
+            fluid_settings_setint(engine->staging_settings, "synth.cpu-cores", STAGING_CPU_CORES);
+            engine->staging = new_fluid_synth(engine->staging_settings);
+        }
+        if (engine->staging) {
+            add_mapped_loader(engine->staging_settings, engine->staging);
+            // Without resetting the channels nothing is selected, so nothing is loaded yet
+            engine->staging_sfont_id = fluid_synth_sfload(engine->staging, engine->path, 0);
+            if (engine->staging_sfont_id == FLUID_FAILED) {
+                delete_fluid_synth(engine->staging);
+                engine->staging = NULL;
+            }
+        }
+    }
+
+    uint64_t resident, missing;
+    if (engine->prefetcher &&
+        sample_prefetch_residency(engine->prefetcher, program, &resident, &missing) == 0) {
+        engine->loads.resident += resident;
+        engine->loads.missing += missing;
+        if (missing == 0) {
+            engine->loads.hits++;
+        } else {
+            engine->loads.misses++;
+        }
+    }
+    struct rusage before, after;
+    getrusage(RUSAGE_THREAD, &before);
+    if (engine->staging) {
+        fluid_synth_program_select(engine->staging, 0, engine->staging_sfont_id,
+                                   engine->programs[program].bank, engine->programs[program].prog);
+    }
+    hold_program(engine, HOLD_CHANNEL_NEXT, &engine->held_next, program);
+    hold_program(engine, HOLD_CHANNEL_CURRENT, &engine->held_current,
+                 current >= 0 && current < engine->program_count ? current : -1);
+    getrusage(RUSAGE_THREAD, &after);
+    engine->loads.count++;
+    engine->loads.faults += (uint64_t)(after.ru_majflt - before.ru_majflt);
+    engine->loads.minor_faults += (uint64_t)(after.ru_minflt - before.ru_minflt);
+}
+
+/*
+ * Ask the worker to load a program's samples from run(), so a lazy engine
+ * selects it only once they are loaded. Returns 0 if the request was
+ * queued, -1 without the worker feature or if the queue is full.
+ */
+static int schedule_select(Plugin* plugin, int program) {
+    WorkMessage message;
+    if (!plugin->schedule) {
+        return -1;
+    }
+    message.type = WORK_SELECT;
+    message.engine = plugin->engine;
+    message.state = NULL;
+    message.program = program;
+    message.current = plugin->current_program;
+    message.serial = plugin->select_serial + 1;
+    if (plugin->schedule->schedule_work(plugin->schedule->handle,
+                                        (uint32_t)offsetof(WorkMessage, path), &message) != LV2_WORKER_SUCCESS) {
+        return -1;
+    }
+    plugin->select_serial = message.serial;
+    plugin->requested_program = program;
+    plugin->keep_controllers = 0;
+    return 0;
+}
+
+/*
+ * Ask the worker from the audio thread to unset the hold channels once
+ * run() no longer needs them, so the samples of the program channel 0 left
+ * are freed there. If the request cannot be queued the channels stay held
+ * until the next program load replaces them.
+ */
+static void schedule_release(Plugin* plugin) {
+    WorkMessage message;
+    if (!plugin->schedule) {
+        return;
+    }
+    message.type = WORK_RELEASE;
+    message.engine = plugin->engine;
+    message.state = NULL;
+    if (plugin->schedule->schedule_work(plugin->schedule->handle,
+                                        (uint32_t)offsetof(WorkMessage, path), &message) == LV2_WORKER_SUCCESS) {
+        account_program(plugin->engine, HOLD_CHANNEL_NEXT, -1);
+        account_program(plugin->engine, HOLD_CHANNEL_CURRENT, -1);
+    }
+}
+
+/*
+ * Take the sound parameter values a synth starts with, which are the
+ * values synth_select_program() resets its controllers to.
+ */
+static void reset_sound_parameters(Plugin* plugin) {
+    plugin->prev_cutoff = 1.0f;     // Start with cutoff open
+    plugin->prev_resonance = 0.0f;
+    plugin->prev_attack = 0.0f;
+    plugin->prev_decay = 0.0f;
+    plugin->prev_sustain = 0.0f;
+    plugin->prev_release = 0.0f;
+}
+
+/*
+ * Ask the worker to load a SoundFont from run(). The path is size bytes
+ * long including the terminating NUL. Without the worker feature the
+ * request is ignored.
+ */
+static void schedule_load(Plugin* plugin, const char* path, uint32_t size) {
+    WorkMessage message;
+    if (!plugin->schedule || size == 0 || size > sizeof(message.path)) {
+        return;
+    }
+    message.type = WORK_LOAD;
+    message.engine = NULL;
+    message.state = NULL;
+    memcpy(message.path, path, size);
+    message.path[size - 1] = '\0';
+    plugin->schedule->schedule_work(plugin->schedule->handle,
+                                    (uint32_t)(offsetof(WorkMessage, path) + size), &message);
+}
+
+/*
+ * Ask the worker to reload the bundle's SoundFont from run(), from the
+ * file it was generated from if the bundle names one. Without the worker
+ * feature the request is ignored.
+ */
+static void schedule_reload(Plugin* plugin) {
+    WorkMessage message;
+    if (!plugin->schedule) {
+        return;
+    }
+    message.type = WORK_RELOAD;
+    message.engine = NULL;
+    message.state = NULL;
+    plugin->schedule->schedule_work(plugin->schedule->handle,
+                                    (uint32_t)offsetof(WorkMessage, path), &message);
+}
+
+/*
+ * Replace the engine between two cycles, in the audio thread.
+ * The new synth gets the Program port's preset on the next run(), and the
+ * old engine is handed to the worker to free. If it cannot be, it is kept
+ * until cleanup().
+ */
+static void swap_engine(Plugin* plugin, Engine* engine) {
+    Engine* old = plugin->engine;
+    plugin->engine = engine;
+    plugin->current_program = -1;
+    plugin->requested_program = -1;
+    plugin->staged_program = -1;
+    plugin->voices = 0;     // Notes on the old synth stop with it
+    reset_sound_parameters(plugin);
+
+    WorkMessage message;
+    message.type = WORK_FREE;
+    message.engine = old;
+    message.state = NULL;
+    if (!plugin->schedule ||
+        plugin->schedule->schedule_work(plugin->schedule->handle,
+                                        (uint32_t)offsetof(WorkMessage, path), &message) != LV2_WORKER_SUCCESS) {
+        old->next_retired = plugin->retired;
+        plugin->retired = old;
+    }
+}
+
+/*
+ * Handle a patch message from the events port in run(): a patch:Set of
+ * sf2lv2:soundfont to a path schedules loading that SoundFont.
+ */
+static void handle_patch_message(Plugin* plugin, const LV2_Atom_Object* object) {
+    if (object->body.otype != plugin->urids.patch_Set) {
+        return;
+    }
+    const LV2_Atom* property = NULL;
+    const LV2_Atom* value = NULL;
+    lv2_atom_object_get(object, plugin->urids.patch_property, &property,
+                        plugin->urids.patch_value, &value, 0);
+    if (!property || property->type != plugin->urids.atom_URID ||
+        ((const LV2_Atom_URID*)property)->body != plugin->urids.sf2lv2_soundfont ||
+        !value || value->type != plugin->urids.atom_Path) {
+        return;
+    }
+    schedule_load(plugin, (const char*)LV2_ATOM_BODY_CONST(value), value->size);
+}
+
+/* Point the file watch at the file of a newly loaded SoundFont */
+static void set_watch_path(Plugin* plugin, const char* path) {
+    if (!plugin->watching) {
+        return;
+    }
+    pthread_mutex_lock(&plugin->watch_lock);
+    snprintf(plugin->watch_path, sizeof(plugin->watch_path), "%s", path);
+    pthread_mutex_unlock(&plugin->watch_lock);
+}
+
+/*
+ * File watch thread: flags a reload when the loaded SoundFont is saved.
+ * The directory is watched rather than the file, since editors such as
+ * Polyphone may write a new file and rename it over the old one. run()
+ * schedules the reload, so it goes through the worker like a patch:Set.
+ */
+static void* watch_soundfont(void* data) {
+    Plugin* plugin = (Plugin*)data;
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        perror("Failed to watch SoundFont");
+        return NULL;
+    }
+
+    char watched[4096] = "";
+    int wd = -1;
+    while (!atomic_load(&plugin->watch_stop)) {
+        char path[4096];
+        pthread_mutex_lock(&plugin->watch_lock);
+        memcpy(path, plugin->watch_path, sizeof(path));
+        pthread_mutex_unlock(&plugin->watch_lock);
+
+        const char* name = strrchr(path, '/');
+        if (strcmp(path, watched) != 0) {
+            if (wd >= 0) {
+                inotify_rm_watch(fd, wd);
+                wd = -1;
+            }
+            if (name) {
+                char dir[4096];
+                snprintf(dir, sizeof(dir), "%.*s", name > path ? (int)(name - path) : 1, path);
+                wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+            }
+            memcpy(watched, path, sizeof(watched));
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, WATCH_POLL_MS) <= 0) {
+            continue;
+        }
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(fd, events, sizeof(events))) > 0) {
+            for (char* p = events; p < events + length; ) {
+                const struct inotify_event* event = (const struct inotify_event*)p;
+                if (name && event->len > 0 && !strcmp(event->name, name + 1)) {
+                    atomic_store(&plugin->reload_requested, 1);
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+/* Bytes held by the instance with the given engine, over every category */
+static int64_t memory_total(const Plugin* plugin, const Engine* engine) {
+    int64_t total = 0;
+    for (int i = 0; i < MEMORY_CATEGORIES; i++) {
+        total += plugin->memory[i] + engine->memory[i];
+    }
+    return total;
+}
+
+/*
+ * Write the memory held by the instance with the given engine, by
+ * category. The SoundFont the read-ahead maps is listed apart: its pages
+ * belong to the page cache and are shared with every instance mapping it.
+ * Not for the audio thread.
+ */
+static void report_memory(const Plugin* plugin, const Engine* engine, FILE* out) {
+    char text[32];
+    fprintf(out, "Memory of %s (%s):\n", plugin->entry->name, engine->path);
+    for (int i = 0; i < MEMORY_CATEGORIES; i++) {
+        fprintf(out, "  %-14s %s\n", memory_category_names[i],
+                format_bytes(plugin->memory[i] + engine->memory[i], text, sizeof(text)));
+    }
+    fprintf(out, "  %-14s %s\n", "total", format_bytes(memory_total(plugin, engine), text, sizeof(text)));
+    if (engine->prefetcher) {
+        SamplePrefetchMemory prefetch;
+        sample_prefetch_memory(engine->prefetcher, &prefetch);
+        fprintf(out, "  %-14s %s mapped, ", "soundfont", format_bytes((int64_t)prefetch.mapped, text, sizeof(text)));
+        fprintf(out, "%s in the page cache\n", format_bytes((int64_t)prefetch.resident, text, sizeof(text)));
+    }
+    int64_t resident = resident_bytes();
+    if (resident >= 0) {
+        fprintf(out, "  %-14s %s\n", "process", format_bytes(resident, text, sizeof(text)));
+    }
+}
+
+/*
+ * Write what loading the current engine's programs on the worker cost for
+ * a lazy engine, with how much sample data had to be read from disk. A
+ * program whose sample data was all in the page cache is a read-ahead hit,
+ * any other a miss. Not for the audio thread.
+ */
+static void report_program_loads(const Engine* engine, FILE* out) {
+    char resident[32], missing[32];
+    if (engine->loads.count > 0) {
+        fprintf(out, "Program loads: %llu on the worker, %s of samples in the page cache, "
+                "%s read from disk, %llu major and %llu minor faults\n",
+                (unsigned long long)engine->loads.count,
+                format_bytes((int64_t)engine->loads.resident, resident, sizeof(resident)),
+                format_bytes((int64_t)engine->loads.missing, missing, sizeof(missing)),
+                (unsigned long long)engine->loads.faults,
+                (unsigned long long)engine->loads.minor_faults);
+    }
+    if (engine->prefetcher) {
+        SamplePrefetchStats stats;
+        sample_prefetch_stats(engine->prefetcher, &stats);
+        fprintf(out, "Sample prefetch: %llu hits, %llu misses, %llu events dropped\n",
+                (unsigned long long)engine->loads.hits, (unsigned long long)engine->loads.misses,
+                (unsigned long long)stats.dropped);
+    }
+}
+
+/* Write the run() timing histogram; not for the audio thread */
+static void report_timing(Plugin* plugin, FILE* out) {
+    fprintf(out, "run() timing of %s:\n", plugin->entry->name);
+    run_timing_report(&plugin->timing, plugin->deadline, out);
+}
+
+/*
+ * Select a restored program on channel 0 and then send the restored
+ * controller values that differ from the synth's, so the controller reset
+ * of a program selection never undoes them. Only channel 0 is restored:
+ * the other channels only park presets, so at most 128 values are read in
+ * the audio thread. Without restored controllers
+ * the selection resets them as any program change does. A program of -1
+ * only sends the controllers.
+ */
+static void apply_restored_controls(Engine* engine, const PendingState* state, int program) {
+    if (program >= 0) {
+        int bank = engine->programs[program].bank;
+        int prog = engine->programs[program].prog;
+        if (state->has_controllers) {
+            fluid_synth_bank_select(engine->synth, 0, bank);
+            fluid_synth_program_change(engine->synth, 0, prog);
+        } else {
+            synth_select_program(engine->synth, bank, prog);
+        }
+        account_program(engine, 0, program);
+    }
+
+    if (state->has_controllers) {
+        for (int cc = 0; cc < 128; cc++) {
+            int value;
+            if (state_controller_restorable(cc) &&
+                fluid_synth_get_cc(engine->synth, 0, cc, &value) == FLUID_OK &&
+                value != state->controllers[cc]) {
+                fluid_synth_cc(engine->synth, 0, cc, state->controllers[cc]);
+            }
+        }
+    }
+}
+
+/*
+ * Apply a restored state in one batch from run(): swap in the restored
+ * engine, take over the usage histogram, select the program only if it
+ * differs from the current one and send the controller values after it.
+ * An engine state_restore() prepared already plays the program with the
+ * controllers. On the current lazy engine the program is selected once the
+ * worker has staged its samples. A state without a program keeps the Program port's, which
+ * is selected here rather than by a later program change that would reset
+ * the restored controllers. The sound parameters are taken as the values
+ * already sent when the controllers that carry them were restored, so
+ * unchanged ports cause no further updates; otherwise every port is sent
+ * on the next cycle.
+ */
+static void apply_pending_state(Plugin* plugin, PendingState* state) {
+    if (state->engine) {
+        swap_engine(plugin, state->engine);
+        state->engine = NULL;   // Owned by the plugin now
+    }
+    Engine* engine = plugin->engine;
+
+    memcpy(plugin->key_counts, state->key_counts, sizeof(plugin->key_counts));
+    memcpy(plugin->layer_counts, state->layer_counts, sizeof(plugin->layer_counts));
+    if (state->counts_engine == engine) {
+        memset(engine->program_counts, 0, engine->program_count * sizeof(uint32_t));
+        for (int i = 0; i < state->hot_count; i++) {
+            engine->program_counts[state->hot[i]] = state->hot_counts[i];
+        }
+    }
+
+    int program = state->program;
+    if (program < 0 || program >= engine->program_count) {
+        program = plugin->current_program >= 0 ? plugin->current_program
+                                                : (plugin->program_port ? (int)*plugin->program_port : -1);
+    }
+    int valid = program >= 0 && program < engine->program_count;
+    if (!state->prepared) {
+        // A lazy engine selects a new program once the worker has staged its
+        // samples; the controllers are sent now and its selection keeps them
+        int select = valid && program != plugin->current_program ? program : -1;
+        if (select >= 0 && plugin->entry->lazy_samples && schedule_select(plugin, select) == 0) {
+            plugin->keep_controllers = state->has_controllers;
+            valid = 0;
+            select = -1;
+        }
+        apply_restored_controls(engine, state, select);
+    }
+    if (valid) {
+        plugin->current_program = program;
+        plugin->requested_program = -1;
     }
 
-    if (plugin->debug) {
-        // Debug output showing FluidSynth CC values
-        int cc_value;
-        fprintf(stderr, "CC values after program change:\n");
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_CUTOFF, &cc_value);
-        fprintf(stderr, "  Cutoff (CC%d): %d\n", CC_CUTOFF, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_RESONANCE, &cc_value);
-        fprintf(stderr, "  Resonance (CC%d): %d\n", CC_RESONANCE, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_ATTACK, &cc_value);
-        fprintf(stderr, "  Attack (CC%d): %d\n", CC_ATTACK, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_DECAY, &cc_value);
-        fprintf(stderr, "  Decay (CC%d): %d\n", CC_DECAY, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_SUSTAIN, &cc_value);
-        fprintf(stderr, "  Sustain (CC%d): %d\n", CC_SUSTAIN, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_RELEASE, &cc_value);
-        fprintf(stderr, "  Release (CC%d): %d\n", CC_RELEASE, cc_value);
+    if (state->has_parameters && state->has_controllers) {
+        plugin->prev_cutoff = state->parameters[0];
+        plugin->prev_resonance = state->parameters[1];
+        plugin->prev_attack = state->parameters[2];
+        plugin->prev_decay = state->parameters[3];
+        plugin->prev_sustain = state->parameters[4];
+        plugin->prev_release = state->parameters[5];
+    } else {
+        // The synth does not hold the saved values, so the ports are sent again
+        plugin->prev_cutoff = NAN;
+        plugin->prev_resonance = NAN;
+        plugin->prev_attack = NAN;
+        plugin->prev_decay = NAN;
+        plugin->prev_sustain = NAN;
+        plugin->prev_release = NAN;
+    }
+}
+
+/* Free a restored state and the engine it still owns */
+static void free_pending_state(PendingState* state) {
+    if (!state) {
+        return;
+    }
+    free_engine(state->engine);
+    free(state);
+}
+
+/*
+ * Hand a state run() applied to the worker to free. If it cannot be, it
+ * is kept until cleanup().
+ */
+static void retire_state(Plugin* plugin, PendingState* state) {
+    WorkMessage message;
+    message.type = WORK_FREE;
+    message.engine = NULL;
+    message.state = state;
+    if (!plugin->schedule ||
+        plugin->schedule->schedule_work(plugin->schedule->handle,
+                                        (uint32_t)offsetof(WorkMessage, path), &message) != LV2_WORKER_SUCCESS) {
+        state->next_retired = plugin->retired_states;
+        plugin->retired_states = state;
     }
 }
 
 /*
  * Initialize a new instance of the plugin
  */
-LV2_Handle instantiate(const LV2_Descriptor* descriptor,
+static LV2_Handle instantiate(const LV2_Descriptor* descriptor,
             double rate,
             const char* bundle_path,
             const LV2_Feature* const* features)
 {
-    fprintf(stderr, "Instantiating plugin: %s\n", PLUGIN_DISPLAY_NAME);
+    const PluginEntry* entry = (const PluginEntry*)descriptor;
+    fprintf(stderr, "Instantiating plugin: %s\n", entry->name);
+    PROBE1(instantiate_start, entry->name);
     
     // Allocate and initialize the plugin structure
     Plugin* plugin = (Plugin*)calloc(1, sizeof(Plugin));
     if (!plugin) {
+        PROBE2(instantiate_end, entry->name, 0);
         return NULL;
     }
+    plugin->entry = entry;
 
     // Initialize debug flag (set to false by default)
     plugin->debug = false;
@@ -308,12 +1626,15 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
     for (int i = 0; features[i]; ++i) {
         if (!strcmp(features[i]->URI, LV2_URID__map)) {
             plugin->map = (LV2_URID_Map*)features[i]->data;
+        } else if (!strcmp(features[i]->URI, LV2_WORKER__schedule)) {
+            plugin->schedule = (LV2_Worker_Schedule*)features[i]->data;
         }
     }
 
     if (!plugin->map) {
         fprintf(stderr, "Missing required feature urid:map\n");
         free(plugin);
+        PROBE2(instantiate_end, entry->name, 0);
         return NULL;
     }
 
@@ -321,68 +1642,63 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
     map_uris(plugin->map, &plugin->urids);
     plugin->bundle_path = strdup(bundle_path);
     plugin->rate = rate;
+    plugin->deadline = entry->deadline > 0 ? entry->deadline : RUN_DEADLINE;
+    plugin->deadline_ns_per_frame = plugin->deadline * 1e9 / rate;
     
-    // Initialize FluidSynth settings
-    plugin->settings = new_fluid_settings();
-    if (!plugin->settings) {
-        free(plugin->bundle_path);
-        free(plugin);
-        return NULL;
-    }
-    
-    // Configure FluidSynth settings for optimal performance
-    fluid_settings_setint(plugin->settings, "synth.threadsafe-api", 1);
-    fluid_settings_setint(plugin->settings, "audio.period-size", 256);
-    fluid_settings_setint(plugin->settings, "audio.periods", 2);
-    fluid_settings_setnum(plugin->settings, "synth.sample-rate", rate);
-    fluid_settings_setint(plugin->settings, "synth.cpu-cores", 4);
-    fluid_settings_setint(plugin->settings, "synth.polyphony", 16);
-    fluid_settings_setint(plugin->settings, "synth.reverb.active", 0);
-    fluid_settings_setint(plugin->settings, "synth.chorus.active", 0);
-    
-    // Create FluidSynth instance
-    plugin->synth = new_fluid_synth(plugin->settings);
-    if (!plugin->synth) {
-        delete_fluid_settings(plugin->settings);
-        free(plugin->bundle_path);
-        free(plugin);
-        return NULL;
-    }
-    
-    // Load and initialize the SoundFont
-    if (load_soundfont(plugin) < 0) {
-        delete_fluid_synth(plugin->synth);
-        delete_fluid_settings(plugin->settings);
+    // Load the bundle's SoundFont
+    plugin->engine = create_bundle_engine(plugin, NULL);
+    if (!plugin->engine) {
         free(plugin->bundle_path);
         free(plugin);
+        PROBE2(instantiate_end, entry->name, 0);
         return NULL;
     }
-    
+
     // Allocate audio processing buffers
     plugin->buffer_l = (float*)calloc(BUFFER_SIZE, sizeof(float));
     plugin->buffer_r = (float*)calloc(BUFFER_SIZE, sizeof(float));
     if (!plugin->buffer_l || !plugin->buffer_r) {
         if (plugin->buffer_l) free(plugin->buffer_l);
         if (plugin->buffer_r) free(plugin->buffer_r);
-        delete_fluid_synth(plugin->synth);
-        delete_fluid_settings(plugin->settings);
+        free_engine(plugin->engine);
         free(plugin->bundle_path);
         free(plugin);
+        PROBE2(instantiate_end, entry->name, 0);
         return NULL;
     }
     
     // Initialize plugin state
     plugin->current_program = -1;
-    
-    // Initialize prev values
-    plugin->prev_cutoff = 1.0f;     // Start with cutoff open
-    plugin->prev_resonance = 0.0f;
-    plugin->prev_attack = 0.0f;
-    plugin->prev_decay = 0.0f;
-    plugin->prev_sustain = 0.0f;
-    plugin->prev_release = 0.0f;
+    plugin->requested_program = -1;
+    plugin->staged_program = -1;
+    reset_sound_parameters(plugin);
+
+    // The instance's own allocations; the engine measured what it loaded
+    plugin->memory[MEMORY_PLUGIN] = sizeof(Plugin) + strlen(plugin->bundle_path) + 1 +
+                                    2 * BUFFER_SIZE * sizeof(float);
+
+    // Publish the counters for sf2lv2_top
+    plugin->metrics = live_metrics_claim(entry->name);
+
+    // Record the cycles around deadline misses, if the bundle names a directory
+    if (entry->recordings_dir[0]) {
+        plugin->recorder = flight_recorder_start(entry->recordings_dir, entry->name);
+    }
+
+    // Reload the SoundFont when its file is saved, if the bundle asks for it
+    if (entry->watch_soundfont) {
+        pthread_mutex_init(&plugin->watch_lock, NULL);
+        snprintf(plugin->watch_path, sizeof(plugin->watch_path), "%s",
+                 entry->source_path[0] ? entry->source_path : plugin->engine->path);
+        plugin->watching = pthread_create(&plugin->watch_thread, NULL, watch_soundfont, plugin) == 0;
+        if (!plugin->watching) {
+            pthread_mutex_destroy(&plugin->watch_lock);
+            fprintf(stderr, "Failed to start SoundFont file watch\n");
+        }
+    }
     
     fprintf(stderr, "Plugin instantiated successfully\n");
+    PROBE2(instantiate_end, entry->name, 1);
     return (LV2_Handle)plugin;
 }
 
@@ -391,7 +1707,7 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
  * Called by the host to connect each port to the appropriate data location.
  * The plugin must store each data location for use in the run() function.
  */
-void connect_port(LV2_Handle instance,
+static void connect_port(LV2_Handle instance,
             uint32_t port,
             void* data)
 {
@@ -432,6 +1748,24 @@ void connect_port(LV2_Handle instance,
         case PORT_RELEASE:
             plugin->release_port = (float*)data;
             break;
+        case PORT_REPORT:
+            plugin->report_port = (float*)data;
+            break;
+        case PORT_MEMORY:
+            plugin->memory_port = (float*)data;
+            break;
+        case PORT_LOAD:
+            plugin->load_port = (float*)data;
+            break;
+        case PORT_VOICES:
+            plugin->voices_port = (float*)data;
+            break;
+        case PORT_PEAK_VOICES:
+            plugin->peak_voices_port = (float*)data;
+            break;
+        case PORT_FULL_POLYPHONY_NOTES:
+            plugin->full_polyphony_notes_port = (float*)data;
+            break;
     }
 }
 
@@ -440,11 +1774,15 @@ void connect_port(LV2_Handle instance,
  * Called when the plugin is activated (enabled) by the host.
  * Ensures a clean state by stopping all notes and sounds.
  */
-void activate(LV2_Handle instance)
+static void activate(LV2_Handle instance)
 {
     Plugin* plugin = (Plugin*)instance;
-    fluid_synth_all_notes_off(plugin->synth, -1);
-    fluid_synth_all_sounds_off(plugin->synth, -1);
+    fluid_synth_all_notes_off(plugin->engine->synth, -1);
+    fluid_synth_all_sounds_off(plugin->engine->synth, -1);
+    plugin->load = 0.0;
+    plugin->voices = 0;
+    plugin->peak_voices = 0;
+    plugin->full_polyphony_notes = 0;
 }
 
 /*
@@ -456,16 +1794,78 @@ void activate(LV2_Handle instance)
  * 3. MIDI event processing
  * 4. Audio generation
  */
-void run(LV2_Handle instance, uint32_t sample_count)
+static void run(LV2_Handle instance, uint32_t sample_count)
 {
     Plugin* plugin = (Plugin*)instance;
+    FlightCycle cycle;
+    memset(&cycle, 0, sizeof(cycle));
+    cycle.start_ns = now_ns();
+    int64_t start = cycle.start_ns;
+    int start_program = plugin->current_program;
+    PROBE1(run_start, sample_count);
+
+    // A restored state is applied before the ports are compared with it
+    if (atomic_load_explicit(&plugin->pending, memory_order_relaxed)) {
+        PendingState* state = atomic_exchange(&plugin->pending, NULL);
+        if (state) {
+            apply_pending_state(plugin, state);
+            retire_state(plugin, state);
+        }
+    }
+
+    // The watched SoundFont was saved: load it again, as the bundle's own if it is
+    if (atomic_load_explicit(&plugin->reload_requested, memory_order_relaxed) &&
+        atomic_exchange(&plugin->reload_requested, 0)) {
+        if (plugin->engine->from_bundle) {
+            schedule_reload(plugin);
+        } else {
+            schedule_load(plugin, plugin->engine->path, (uint32_t)strlen(plugin->engine->path) + 1);
+        }
+    }
 
-    // Handle program changes first - if program changes, skip control updates
+    // Memory held, and the report written by the worker on a trigger
+    if (plugin->memory_port) {
+        *plugin->memory_port = (float)memory_total(plugin, plugin->engine) / (1024.0f * 1024.0f);
+    }
+    if (plugin->report_port) {
+        if (*plugin->report_port > 0.5f && plugin->prev_report <= 0.5f && plugin->schedule) {
+            WorkMessage message;
+            message.type = WORK_REPORT;
+            message.engine = plugin->engine;
+            message.state = NULL;
+            plugin->schedule->schedule_work(plugin->schedule->handle,
+                                            (uint32_t)offsetof(WorkMessage, path), &message);
+        }
+        plugin->prev_report = *plugin->report_port;
+    }
+
+    // Read-ahead of the engine's bank, NULL for a SoundFont without one
+    SamplePrefetcher* prefetcher = plugin->engine->prefetcher;
+
+    // A program the worker loaded is selected here, inside the timed cycle,
+    // unless the port moved on meanwhile; the hold channels are then released
+    if (plugin->staged_program >= 0) {
+        if (plugin->staged_program == plugin->requested_program) {
+            select_program(plugin, plugin->staged_program, plugin->keep_controllers);
+            plugin->requested_program = -1;
+        }
+        plugin->staged_program = -1;
+        schedule_release(plugin);
+    }
+
+    // Handle program changes first - if program changes, skip control updates.
+    // A lazy engine keeps playing the current program until the worker has
+    // loaded the new one's samples; the next run() then selects it
     if (plugin->program_port) {
         int new_program = (int)(*plugin->program_port + 0.5);
-        if (new_program != plugin->current_program && new_program >= 0) {
-            handle_program_change(plugin, new_program);
-            plugin->current_program = new_program;
+        if (new_program == plugin->current_program) {
+            plugin->requested_program = -1;     // Moved back before the load finished
+        } else if (new_program >= 0 && new_program != plugin->requested_program) {
+            if (prefetcher) sample_prefetch_program(prefetcher, new_program);
+            if (!plugin->entry->lazy_samples || new_program >= plugin->engine->program_count ||
+                schedule_select(plugin, new_program) != 0) {
+                select_program(plugin, new_program, 0);
+            }
             goto process_audio;  // Skip control updates after program change
         }
     }
@@ -473,37 +1873,37 @@ void run(LV2_Handle instance, uint32_t sample_count)
     // Process control changes - only send CC if control actually moved
     if (plugin->cutoff_port && *plugin->cutoff_port != plugin->prev_cutoff) {
         int cc_value = (int)(*plugin->cutoff_port * 127.0f);
-        fluid_synth_cc(plugin->synth, 0, CC_CUTOFF, cc_value);
+        fluid_synth_cc(plugin->engine->synth, 0, CC_CUTOFF, cc_value);
         plugin->prev_cutoff = *plugin->cutoff_port;
     }
 
     if (plugin->resonance_port && *plugin->resonance_port != plugin->prev_resonance) {
         int cc_value = (int)(*plugin->resonance_port * 127.0f);
-        fluid_synth_cc(plugin->synth, 0, CC_RESONANCE, cc_value);
+        fluid_synth_cc(plugin->engine->synth, 0, CC_RESONANCE, cc_value);
         plugin->prev_resonance = *plugin->resonance_port;
     }
 
     if (plugin->attack_port && *plugin->attack_port != plugin->prev_attack) {
         int cc_value = (int)(*plugin->attack_port * 127.0f);
-        fluid_synth_cc(plugin->synth, 0, CC_ATTACK, cc_value);
+        fluid_synth_cc(plugin->engine->synth, 0, CC_ATTACK, cc_value);
         plugin->prev_attack = *plugin->attack_port;
     }
 
     if (plugin->decay_port && *plugin->decay_port != plugin->prev_decay) {
         int cc_value = (int)(*plugin->decay_port * 127.0f);
-        fluid_synth_cc(plugin->synth, 0, CC_DECAY, cc_value);
+        fluid_synth_cc(plugin->engine->synth, 0, CC_DECAY, cc_value);
         plugin->prev_decay = *plugin->decay_port;
     }
 
     if (plugin->sustain_port && *plugin->sustain_port != plugin->prev_sustain) {
         int cc_value = (int)(*plugin->sustain_port * 127.0f);
-        fluid_synth_cc(plugin->synth, 0, CC_SUSTAIN, cc_value);
+        fluid_synth_cc(plugin->engine->synth, 0, CC_SUSTAIN, cc_value);
         plugin->prev_sustain = *plugin->sustain_port;
     }
 
     if (plugin->release_port && *plugin->release_port != plugin->prev_release) {
         int cc_value = (int)(*plugin->release_port * 127.0f);
-        fluid_synth_cc(plugin->synth, 0, CC_RELEASE, cc_value);
+        fluid_synth_cc(plugin->engine->synth, 0, CC_RELEASE, cc_value);
         plugin->prev_release = *plugin->release_port;
     }
 
@@ -511,34 +1911,65 @@ process_audio:
     // Update master level if changed
     if (plugin->level_port) {
         float level = *plugin->level_port;
-        fluid_synth_set_gain(plugin->synth, level);
+        fluid_synth_set_gain(plugin->engine->synth, level);
     }
+    int64_t controls_end = now_ns();
 
     // Process incoming MIDI events
     LV2_ATOM_SEQUENCE_FOREACH(plugin->events_in, ev) {
         if (ev->body.type == plugin->urids.midi_Event) {
             const uint8_t* const msg = (const uint8_t*)(ev + 1);
+            PROBE3(midi_event, msg[0], msg[1], msg[2]);
             switch (msg[0] & 0xF0) {
                 case 0x90:  // Note On (velocity > 0) or Note Off (velocity = 0)
                     if (msg[2] > 0) {
-                        fluid_synth_noteon(plugin->synth, 0, msg[1], msg[2]);
+                        cycle.note_ons++;
+                        play_note(plugin, msg[1], msg[2]);
+                        record_note(plugin, msg[1] & 0x7F, msg[2] & 0x7F);
                     } else {
-                        fluid_synth_noteoff(plugin->synth, 0, msg[1]);
+                        cycle.note_offs++;
+                        fluid_synth_noteoff(plugin->engine->synth, 0, msg[1]);
                     }
                     break;
                 case 0x80:  // Note Off
-                    fluid_synth_noteoff(plugin->synth, 0, msg[1]);
+                    cycle.note_offs++;
+                    fluid_synth_noteoff(plugin->engine->synth, 0, msg[1]);
                     break;
                 case 0xB0:  // Control Change
-                    fluid_synth_cc(plugin->synth, 0, msg[1], msg[2]);
+                    cycle.controllers++;
+                    fluid_synth_cc(plugin->engine->synth, 0, msg[1], msg[2]);
+                    if (prefetcher && msg[1] == 0) sample_prefetch_bank(prefetcher, msg[2]);
                     break;
                 case 0xE0:  // Pitch Bend (14-bit value from two 7-bit values)
-                    fluid_synth_pitch_bend(plugin->synth, 0,
+                    cycle.pitch_bends++;
+                    fluid_synth_pitch_bend(plugin->engine->synth, 0,
                         (msg[2] << 7) | msg[1]);
                     break;
+                default:
+                    cycle.others++;
+                    break;
             }
+        } else if (ev->body.type == plugin->urids.atom_Object) {
+            cycle.others++;
+            handle_patch_message(plugin, (const LV2_Atom_Object*)&ev->body);
         }
     }
+    if (prefetcher) {
+        sample_prefetch_wake(prefetcher);
+    }
+
+    // Voices mostly end while rendering, so the most are active now
+    int voices = fluid_synth_get_active_voice_count(plugin->engine->synth);
+    plugin->voices = voices;
+    if (voices > plugin->peak_voices) {
+        plugin->peak_voices = voices;
+    }
+
+    // Phase times go straight into the cycle summary
+    int64_t* phase_ns = cycle.phase_ns;
+    phase_ns[RUN_PHASE_CONTROLS] = controls_end - start;
+    int64_t mark = now_ns();
+    phase_ns[RUN_PHASE_EVENTS] = mark - controls_end;
 
     // Generate audio in chunks of BUFFER_SIZE
     uint32_t remaining = sample_count;
@@ -548,17 +1979,64 @@ process_audio:
         uint32_t chunk_size = (remaining > BUFFER_SIZE) ? BUFFER_SIZE : remaining;
 
         // Generate audio for current chunk
-        fluid_synth_write_float(plugin->synth, chunk_size,
+        PROBE1(render_start, chunk_size);
+        fluid_synth_write_float(plugin->engine->synth, chunk_size,
                               plugin->buffer_l, 0, 1,
                               plugin->buffer_r, 0, 1);
+        PROBE1(render_end, chunk_size);
+        int64_t rendered = now_ns();
+        phase_ns[RUN_PHASE_RENDER] += rendered - mark;
 
         // Copy generated audio to output ports
         memcpy(plugin->audio_out_l + offset, plugin->buffer_l, chunk_size * sizeof(float));
         memcpy(plugin->audio_out_r + offset, plugin->buffer_r, chunk_size * sizeof(float));
+        mark = now_ns();
+        phase_ns[RUN_PHASE_COPY] += mark - rendered;
 
         remaining -= chunk_size;
         offset += chunk_size;
     }
+    plugin->voices = fluid_synth_get_active_voice_count(plugin->engine->synth);
+
+    // Record the cycle against its deadline
+    phase_ns[RUN_PHASE_TOTAL] = mark - start;
+    cycle.deadline_ns = (int64_t)(sample_count * plugin->deadline_ns_per_frame);
+    run_timing_record(&plugin->timing, phase_ns, cycle.deadline_ns);
+    if (plugin->recorder) {
+        cycle.sample_count = sample_count;
+        cycle.voices = (uint16_t)voices;
+        cycle.program = plugin->current_program;
+        cycle.program_changed = plugin->current_program != start_program;
+        flight_recorder_record(plugin->recorder, &cycle);
+    }
+
+    // Update the load meters
+    if (sample_count > 0) {
+        double duration = sample_count / plugin->rate;
+        double load = phase_ns[RUN_PHASE_TOTAL] * 1e-9 / duration;
+        double weight = duration < LOAD_SMOOTHING ? duration / LOAD_SMOOTHING : 1.0;
+        plugin->load += (load - plugin->load) * weight;
+    }
+    if (plugin->load_port) *plugin->load_port = (float)(plugin->load * 100.0);
+    if (plugin->voices_port) *plugin->voices_port = voices;
+    if (plugin->peak_voices_port) *plugin->peak_voices_port = plugin->peak_voices;
+    if (plugin->full_polyphony_notes_port) *plugin->full_polyphony_notes_port = plugin->full_polyphony_notes;
+
+    // Publish the counters for sf2lv2_top
+    if (plugin->metrics) {
+        LiveMetrics metrics;
+        metrics.cycles = atomic_load_explicit(&plugin->timing.cycles, memory_order_relaxed);
+        metrics.deadline_misses = atomic_load_explicit(&plugin->timing.misses, memory_order_relaxed);
+        metrics.memory = memory_total(plugin, plugin->engine);
+        metrics.updated_ns = mark;
+        metrics.load = (float)plugin->load;
+        metrics.voices = (uint32_t)voices;
+        metrics.peak_voices = (uint32_t)plugin->peak_voices;
+        metrics.full_polyphony_notes = plugin->full_polyphony_notes;
+        metrics.program = plugin->current_program;
+        live_metrics_publish(plugin->metrics, &metrics);
+    }
+    PROBE1(run_end, sample_count);
 }
 
 /*
@@ -566,11 +2044,11 @@ process_audio:
  * Called when the plugin is deactivated (disabled) by the host.
  * Ensures all notes and sounds are stopped.
  */
-void deactivate(LV2_Handle instance)
+static void deactivate(LV2_Handle instance)
 {
     Plugin* plugin = (Plugin*)instance;
-    fluid_synth_all_notes_off(plugin->synth, -1);
-    fluid_synth_all_sounds_off(plugin->synth, -1);
+    fluid_synth_all_notes_off(plugin->engine->synth, -1);
+    fluid_synth_all_sounds_off(plugin->engine->synth, -1);
 }
 
 /*
@@ -578,21 +2056,56 @@ void deactivate(LV2_Handle instance)
  * Called when the plugin instance is being destroyed.
  * Frees all allocated resources in reverse order of allocation.
  */
-void cleanup(LV2_Handle instance)
+static void cleanup(LV2_Handle instance)
 {
     Plugin* plugin = (Plugin*)instance;
     
     if (plugin) {
+        // Report the memory held, for finding what grew over the session,
+        // and how long run() took
+        report_memory(plugin, plugin->engine, stderr);
+        report_timing(plugin, stderr);
+
+        // Report what selecting programs cost
+        report_program_loads(plugin->engine, stderr);
+
+        // Leave the live metrics segment
+        live_metrics_release(plugin->metrics);
+
+        // Stop the flight recorder and say where its recordings went
+        if (plugin->recorder) {
+            int recordings = flight_recorder_count(plugin->recorder);
+            if (recordings > 0) {
+                fprintf(stderr, "Flight recorder: %d recordings in %s\n", recordings, plugin->entry->recordings_dir);
+            }
+            flight_recorder_stop(plugin->recorder);
+        }
+
+        // Stop the file watch
+        if (plugin->watching) {
+            atomic_store(&plugin->watch_stop, 1);
+            pthread_join(plugin->watch_thread, NULL);
+            pthread_mutex_destroy(&plugin->watch_lock);
+        }
+
         // Free audio buffers
         if (plugin->buffer_l) free(plugin->buffer_l);
         if (plugin->buffer_r) free(plugin->buffer_r);
         
-        // Free program data
-        if (plugin->programs) free(plugin->programs);
-        
-        // Delete FluidSynth instances
-        if (plugin->synth) delete_fluid_synth(plugin->synth);
-        if (plugin->settings) delete_fluid_settings(plugin->settings);
+        // Delete the FluidSynth engines: the current one, a restored one run()
+        // never applied and swapped out ones the worker did not free
+        free_engine(plugin->engine);
+        free_pending_state(atomic_exchange(&plugin->pending, NULL));
+        while (plugin->retired) {
+            Engine* next = plugin->retired->next_retired;
+            free_engine(plugin->retired);
+            plugin->retired = next;
+        }
+        while (plugin->retired_states) {
+            PendingState* next = plugin->retired_states->next_retired;
+            free(plugin->retired_states);
+            plugin->retired_states = next;
+        }
         
         // Free bundle path
         if (plugin->bundle_path) free(plugin->bundle_path);
@@ -602,28 +2115,382 @@ void cleanup(LV2_Handle instance)
     }
 }
 
+/*
+ * Return the elements of an integer vector retrieved from the state.
+ * Returns NULL if the value is missing or of another type.
+ */
+static const int32_t* state_int_vector(const Plugin* plugin, const void* value, size_t size,
+                                       uint32_t type, int* count)
+{
+    const LV2_Atom_Vector_Body* body = (const LV2_Atom_Vector_Body*)value;
+    if (!value || type != plugin->urids.atom_Vector || size < sizeof(LV2_Atom_Vector_Body) ||
+        body->child_type != plugin->urids.atom_Int || body->child_size != sizeof(int32_t)) {
+        return NULL;
+    }
+    *count = (int)((size - sizeof(LV2_Atom_Vector_Body)) / sizeof(int32_t));
+    return (const int32_t*)(body + 1);
+}
+
+/* Find a host feature by URI. Returns its data, or NULL */
+static void* find_feature(const LV2_Feature* const* features, const char* uri) {
+    for (int i = 0; features && features[i]; i++) {
+        if (!strcmp(features[i]->URI, uri)) {
+            return features[i]->data;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Save the current program, the sound parameters, the controllers of
+ * channel 0 and the usage histogram.
+ * Presets are saved as bank, program and count triples so the histogram
+ * still applies if the SoundFont's preset list changes. A SoundFont set
+ * with patch:Set is saved as a path, mapped by the host if it can.
+ * Hosts may call this while run() swaps engines, so the engine is held
+ * through the saving counter, which keeps the worker from freeing it.
+ */
+static LV2_State_Status state_save(LV2_Handle instance,
+            LV2_State_Store_Function store,
+            LV2_State_Handle handle,
+            uint32_t flags,
+            const LV2_Feature* const* features)
+{
+    Plugin* plugin = (Plugin*)instance;
+    atomic_fetch_add(&plugin->saving, 1);
+    Engine* engine = atomic_load(&plugin->engine);
+    const uint32_t pod = LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE;
+
+    if (!engine->from_bundle) {
+        LV2_State_Map_Path* map_path = (LV2_State_Map_Path*)find_feature(features, LV2_STATE__mapPath);
+        LV2_State_Free_Path* free_path = (LV2_State_Free_Path*)find_feature(features, LV2_STATE__freePath);
+        char* abstract = map_path ? map_path->abstract_path(map_path->handle, engine->path) : NULL;
+        const char* path = abstract ? abstract : engine->path;
+        store(handle, plugin->urids.sf2lv2_soundfont, path, strlen(path) + 1, plugin->urids.atom_Path,
+              abstract ? pod : LV2_STATE_IS_POD);
+        if (abstract && free_path) {
+            free_path->free_path(free_path->handle, abstract);
+        } else {
+            free(abstract);
+        }
+    }
+
+    int32_t program = plugin->current_program;
+    store(handle, plugin->urids.state_program, &program, sizeof(program), plugin->urids.atom_Int, pod);
+
+    IntVector vector;
+    vector.body.child_size = sizeof(int32_t);
+    vector.body.child_type = plugin->urids.atom_Int;
+    state_encode_counts(plugin->key_counts, 128, vector.values);
+    store(handle, plugin->urids.state_keys, &vector, sizeof(vector.body) + 128 * sizeof(int32_t),
+          plugin->urids.atom_Vector, pod);
+
+    state_encode_counts(plugin->layer_counts, VELOCITY_LAYERS, vector.values);
+    store(handle, plugin->urids.state_layers, &vector, sizeof(vector.body) + VELOCITY_LAYERS * sizeof(int32_t),
+          plugin->urids.atom_Vector, pod);
+
+    int hot[WARM_PRESETS];
+    int hot_count = state_hot_programs(engine->program_counts, engine->program_count, hot, WARM_PRESETS);
+    int value_count = state_encode_presets(engine->programs, engine->program_counts, hot, hot_count, vector.values);
+    store(handle, plugin->urids.state_presets, &vector, sizeof(vector.body) + value_count * sizeof(int32_t),
+          plugin->urids.atom_Vector, pod);
+
+    struct {
+        LV2_Atom_Vector_Body body;
+        float values[SOUND_PARAMETERS];
+    } parameters = {
+        { sizeof(float), plugin->urids.atom_Float },
+        { plugin->prev_cutoff, plugin->prev_resonance, plugin->prev_attack,
+          plugin->prev_decay, plugin->prev_sustain, plugin->prev_release }
+    };
+    store(handle, plugin->urids.state_parameters, &parameters, sizeof(parameters), plugin->urids.atom_Vector, pod);
+
+    // One byte per controller of channel 0, the only channel the plugin plays
+    int values[STATE_CONTROLLERS];
+    uint8_t controllers[STATE_CONTROLLERS];
+    for (int cc = 0; cc < STATE_CONTROLLERS; cc++) {
+        values[cc] = 0;
+        fluid_synth_get_cc(engine->synth, 0, cc, &values[cc]);
+    }
+    state_encode_controllers(values, controllers);
+    store(handle, plugin->urids.state_controllers, controllers, sizeof(controllers), plugin->urids.atom_Chunk, pod);
+
+    atomic_fetch_sub(&plugin->saving, 1);
+    return LV2_STATE_SUCCESS;
+}
+
+/*
+ * Restore the saved state. The program, sound parameters, controller
+ * values and usage histogram are gathered into a new state that run()
+ * takes over whole and applies in one batch; a state run() has not taken
+ * yet is replaced. A saved SoundFont that differs from the current one is
+ * loaded here and handed over with them; a state without one brings back
+ * the bundle's SoundFont. A lazy new engine has the samples the usage
+ * histogram points at loaded into it before run() swaps it in; a lazy
+ * current engine is kept, its restored presets are read ahead, and run()
+ * has the worker stage the program. A new engine is left playing the
+ * restored program with the restored controllers. Missing or malformed
+ * properties leave the matching values unchanged, or the counts at zero.
+ */
+static LV2_State_Status state_restore(LV2_Handle instance,
+            LV2_State_Retrieve_Function retrieve,
+            LV2_State_Handle handle,
+            uint32_t flags,
+            const LV2_Feature* const* features)
+{
+    Plugin* plugin = (Plugin*)instance;
+    size_t size;
+    uint32_t type, value_flags;
+    int count = 0;
+
+    PendingState* state = (PendingState*)calloc(1, sizeof(PendingState));
+    if (!state) {
+        return LV2_STATE_ERR_UNKNOWN;
+    }
+
+    const int32_t* program = (const int32_t*)retrieve(handle, plugin->urids.state_program, &size, &type, &value_flags);
+    state->program = (program && type == plugin->urids.atom_Int && size == sizeof(int32_t)) ? *program : -1;
+
+    // Load the saved SoundFont first, since that takes a while
+    const char* path = (const char*)retrieve(handle, plugin->urids.sf2lv2_soundfont, &size, &type, &value_flags);
+    if (path && type == plugin->urids.atom_Path && size > 0 && path[size - 1] == '\0') {
+        LV2_State_Map_Path* map_path = (LV2_State_Map_Path*)find_feature(features, LV2_STATE__mapPath);
+        LV2_State_Free_Path* free_path = (LV2_State_Free_Path*)find_feature(features, LV2_STATE__freePath);
+        char* absolute = map_path ? map_path->absolute_path(map_path->handle, path) : NULL;
+        if (strcmp(absolute ? absolute : path, plugin->engine->path) != 0) {
+            state->engine = create_engine(plugin, absolute ? absolute : path, NULL);
+            if (!state->engine) {
+                fprintf(stderr, "Failed to load saved SoundFont, keeping the current one: %s\n",
+                        absolute ? absolute : path);
+            }
+        }
+        if (absolute && free_path) {
+            free_path->free_path(free_path->handle, absolute);
+        } else {
+            free(absolute);
+        }
+    } else if (!plugin->engine->from_bundle) {
+        state->engine = create_bundle_engine(plugin, NULL);
+    }
+
+    const void* value = retrieve(handle, plugin->urids.state_parameters, &size, &type, &value_flags);
+    const LV2_Atom_Vector_Body* body = (const LV2_Atom_Vector_Body*)value;
+    state->has_parameters = value && type == plugin->urids.atom_Vector &&
+        size == sizeof(LV2_Atom_Vector_Body) + SOUND_PARAMETERS * sizeof(float) &&
+        body->child_type == plugin->urids.atom_Float && body->child_size == sizeof(float);
+    if (state->has_parameters) {
+        memcpy(state->parameters, body + 1, sizeof(state->parameters));
+    }
+
+    value = retrieve(handle, plugin->urids.state_controllers, &size, &type, &value_flags);
+    state->has_controllers = type == plugin->urids.atom_Chunk &&
+        state_decode_controllers(value, size, state->controllers);
+
+    value = retrieve(handle, plugin->urids.state_keys, &size, &type, &value_flags);
+    const int32_t* values = state_int_vector(plugin, value, size, type, &count);
+    state_decode_counts(values, count, state->key_counts, 128);
+
+    value = retrieve(handle, plugin->urids.state_layers, &size, &type, &value_flags);
+    values = state_int_vector(plugin, value, size, type, &count);
+    state_decode_counts(values, count, state->layer_counts, VELOCITY_LAYERS);
+
+    // Presets are matched by bank and program; a new engine takes its counts
+    // now, the current one from run()
+    Engine* engine = state->engine ? state->engine : plugin->engine;
+    state->counts_engine = state->engine ? NULL : plugin->engine;
+    value = retrieve(handle, plugin->urids.state_presets, &size, &type, &value_flags);
+    values = state_int_vector(plugin, value, size, type, &count);
+    state->hot_count = state_decode_presets(values, count, engine->programs, engine->program_count,
+                                            state->hot, state->hot_counts, WARM_PRESETS);
+
+    if (state->engine) {
+        for (int i = 0; i < state->hot_count; i++) {
+            state->engine->program_counts[state->hot[i]] = state->hot_counts[i];
+        }
+        warm_start(plugin, state->engine, state);
+        if (state->program >= 0 && state->program < state->engine->program_count) {
+            apply_restored_controls(state->engine, state, state->program);
+            state->prepared = 1;
+        }
+        set_watch_path(plugin, state->engine->path);
+    } else if (plugin->entry->lazy_samples && engine->from_bank) {
+        // The synth run() plays is kept and not touched here: the restored
+        // presets are read into the page cache, and run() has the worker
+        // stage the program before selecting it
+        int programs[WARM_PRESETS];
+        prefetch_bank_zones(state, engine, programs, restored_programs(state, engine, programs));
+    }
+
+    // Hand the state to run(); one it never took is dropped
+    free_pending_state(atomic_exchange(&plugin->pending, state));
+    return LV2_STATE_SUCCESS;
+}
+
+/*
+ * Load a SoundFont or reload the bundle's for run() on the worker thread,
+ * load the samples of a program run() is about to select, free what run()
+ * swapped out, or write the reports. A loaded engine or program is passed
+ * back to work_response().
+ */
+static LV2_Worker_Status work(LV2_Handle instance,
+            LV2_Worker_Respond_Function respond,
+            LV2_Worker_Respond_Handle handle,
+            uint32_t size,
+            const void* data)
+{
+    Plugin* plugin = (Plugin*)instance;
+    const WorkMessage* message = (const WorkMessage*)data;
+    if (size < offsetof(WorkMessage, path)) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
+    if (message->type == WORK_FREE) {
+        // state_save() may still be reading a swapped out engine; any call
+        // that starts later sees the new one
+        while (message->engine && atomic_load(&plugin->saving) > 0) {
+            sched_yield();
+        }
+        free_engine(message->engine);
+        free_pending_state(message->state);
+        return LV2_WORKER_SUCCESS;
+    }
+    if (message->type == WORK_REPORT) {
+        // Engines are freed on this thread too, so this one is still loaded
+        report_memory(plugin, message->engine, stderr);
+        report_timing(plugin, stderr);
+        return LV2_WORKER_SUCCESS;
+    }
+    if (message->type == WORK_SELECT) {
+        // Freeing the engine was queued after this, if it was swapped out
+        load_program_samples(message->engine, message->program, message->current);
+        WorkResponse response;
+        response.type = WORK_SELECT;
+        response.engine = message->engine;
+        response.program = message->program;
+        response.current = message->engine->held_current;
+        response.serial = message->serial;
+        return respond(handle, sizeof(response), &response);
+    }
+    if (message->type == WORK_RELEASE) {
+        // Samples only channel 0 left are freed here rather than in run()
+        hold_program(message->engine, HOLD_CHANNEL_NEXT, &message->engine->held_next, -1);
+        hold_program(message->engine, HOLD_CHANNEL_CURRENT, &message->engine->held_current, -1);
+        return LV2_WORKER_SUCCESS;
+    }
+
+    Engine* engine;
+    if (message->type == WORK_RELOAD) {
+        const char* source = plugin->entry->source_path[0] ? plugin->entry->source_path : NULL;
+        fprintf(stderr, "Reloading SoundFont of %s\n", plugin->entry->name);
+        engine = create_bundle_engine(plugin, source);
+        if (!engine) {
+            fprintf(stderr, "Failed to reload SoundFont, keeping the current one\n");
+            return LV2_WORKER_ERR_UNKNOWN;
+        }
+    } else {
+        if (size <= offsetof(WorkMessage, path)) {
+            return LV2_WORKER_ERR_UNKNOWN;
+        }
+        fprintf(stderr, "Loading SoundFont: %s\n", message->path);
+        engine = create_engine(plugin, message->path, NULL);
+        if (!engine) {
+            fprintf(stderr, "Failed to load SoundFont, keeping the current one: %s\n", message->path);
+            return LV2_WORKER_ERR_UNKNOWN;
+        }
+    }
+    WorkResponse response;
+    response.type = WORK_LOAD;
+    response.engine = engine;
+    response.program = -1;
+    response.current = -1;
+    response.serial = 0;
+    if (respond(handle, sizeof(response), &response) != LV2_WORKER_SUCCESS) {
+        free_engine(engine);
+        return LV2_WORKER_ERR_NO_SPACE;
+    }
+    set_watch_path(plugin, engine->path);
+    return LV2_WORKER_SUCCESS;
+}
+
+/*
+ * Swap in an engine loaded by work(), or hand the next run() a program
+ * whose samples work() loaded if run() still wants it on the same engine.
+ * Called by the host in the audio thread between two run() calls.
+ */
+static LV2_Worker_Status work_response(LV2_Handle instance, uint32_t size, const void* data)
+{
+    Plugin* plugin = (Plugin*)instance;
+    const WorkResponse* response = (const WorkResponse*)data;
+    if (size != sizeof(WorkResponse)) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
+    if (response->type == WORK_SELECT) {
+        if (response->engine != plugin->engine) {
+            return LV2_WORKER_SUCCESS;  // Swapped out meanwhile, and freed after this
+        }
+        // The staging synth and the hold channels now hold the programs'
+        // samples, whether or not the program is selected
+        if (plugin->engine->staging) {
+            plugin->engine->memory[MEMORY_SYNTH] =
+                synth_memory_estimate(SYNTH_POLYPHONY, SYNTH_CHANNELS, SYNTH_CPU_CORES) +
+                synth_memory_estimate(STAGING_POLYPHONY, SYNTH_CHANNELS, STAGING_CPU_CORES);
+        }
+        account_program(plugin->engine, SAMPLE_MEMORY_STAGING,
+                        plugin->engine->staging ? response->program : -1);
+        account_program(plugin->engine, HOLD_CHANNEL_NEXT, response->program);
+        account_program(plugin->engine, HOLD_CHANNEL_CURRENT, response->current);
+        // A later load replaces the hold channels itself; the next run()
+        // selects the program, or the channels are released now
+        if (response->serial == plugin->select_serial) {
+            if (response->program == plugin->requested_program) {
+                plugin->staged_program = response->program;
+            } else {
+                schedule_release(plugin);
+            }
+        }
+        return LV2_WORKER_SUCCESS;
+    }
+    swap_engine(plugin, response->engine);
+    return LV2_WORKER_SUCCESS;
+}
+
 /*
  * Extension data interface.
- * Returns NULL as this plugin doesn't implement any extensions.
+ * The plugin implements the LV2 State and Worker interfaces.
  */
-const void* extension_data(const char* uri)
+static const void* extension_data(const char* uri)
 {
+    static const LV2_State_Interface state = { state_save, state_restore };
+    static const LV2_Worker_Interface worker = { work, work_response, NULL };
+    if (!strcmp(uri, LV2_STATE__interface)) {
+        return &state;
+    }
+    if (!strcmp(uri, LV2_WORKER__interface)) {
+        return &worker;
+    }
     return NULL;
 }
 
+/* Fill in the function pointers of a plugin entry's descriptor */
+static void init_entry_descriptor(PluginEntry* entry) {
+    entry->descriptor.URI = entry->uri;                 // Unique URI identifying the plugin
+    entry->descriptor.instantiate = instantiate;        // Create new instance of the plugin
+    entry->descriptor.connect_port = connect_port;      // Connect plugin ports to host buffers
+    entry->descriptor.activate = activate;              // Prepare plugin for audio processing
+    entry->descriptor.run = run;                        // Process audio and MIDI events
+    entry->descriptor.deactivate = deactivate;          // Stop audio processing
+    entry->descriptor.cleanup = cleanup;                // Free plugin resources
+    entry->descriptor.extension_data = extension_data;  // Plugin extensions (state, worker)
+}
+
+#ifdef SF2_FILE
+
 /*
- * Plugin descriptor.
- * Contains all function pointers required by the LV2 specification.
+ * Dedicated build: the plugin URI and SoundFont are fixed at compile time.
  */
-static const LV2_Descriptor descriptor = {
-    PLUGIN_URI,            // Unique URI identifying the plugin
-    instantiate,           // Create new instance of the plugin
-    connect_port,          // Connect plugin ports to host buffers
-    activate,             // Prepare plugin for audio processing
-    run,                  // Process audio and MIDI events
-    deactivate,           // Stop audio processing
-    cleanup,              // Free plugin resources
-    extension_data        // Plugin extensions (none implemented)
+static PluginEntry compiled_entry = {
+    .uri = PLUGIN_URI_BASE PLUGIN_NAME,
+    .name = PLUGIN_NAME,
+    .sf2_file = SF2_FILE
 };
 
 /*
@@ -631,9 +2498,213 @@ static const LV2_Descriptor descriptor = {
  * This is the entry point required by the LV2 specification.
  * Returns the plugin descriptor for index 0, NULL for all other indices.
  */
+LV2_SYMBOL_EXPORT
 const LV2_Descriptor* lv2_descriptor(uint32_t index)
 {
-    return (index == 0) ? &descriptor : NULL;
+    if (index != 0) {
+        return NULL;
+    }
+    init_entry_descriptor(&compiled_entry);
+    return &compiled_entry.descriptor;
+}
+
+#else
+
+/* Plugins described by one bundle's configuration file */
+typedef struct {
+    LV2_Lib_Descriptor lib;     // Library descriptor handed to the host
+    PluginEntry* entries;       // Plugins listed in the bundle configuration
+    uint32_t entry_count;       // Number of entries
+} BundleLibrary;
+
+/* Remove trailing whitespace and newline characters */
+static void trim_line(char* line) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                       line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        line[--len] = '\0';
+    }
+}
+
+/*
+ * Read the bundle configuration written by ttl_generator.
+ * Each plugin starts with a "plugin <uri>" line, followed by
+ * "name <display name>" and "sf2 <file>" lines, an optional
+ * "bank <file>" line naming its preprocessed sample bank, an optional
+ * "samples lazy" line enabling lazy sample loading and an optional
+ * "watch soundfont" line enabling the SoundFont file watch, with an
+ * optional "source <path>" line naming the file to watch.
+ * Returns the number of plugins read, or -1 on failure.
+ */
+static int read_bundle_config(const char* bundle_path, PluginEntry** entries_out) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", bundle_path, BUNDLE_CONFIG_FILE);
+    *entries_out = NULL;
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open bundle configuration: %s\n", path);
+        return -1;
+    }
+
+    PluginEntry* entries = NULL;
+    int count = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        trim_line(line);
+        char* value = strchr(line, ' ');
+        if (line[0] == '#' || !value) {
+            continue;
+        }
+        *value++ = '\0';
+
+        if (!strcmp(line, "plugin")) {
+            PluginEntry* grown = (PluginEntry*)realloc(entries, (count + 1) * sizeof(PluginEntry));
+            if (!grown) {
+                fprintf(stderr, "Failed to allocate plugin entries\n");
+                free(entries);
+                fclose(f);
+                return -1;
+            }
+            entries = grown;
+            memset(&entries[count], 0, sizeof(PluginEntry));
+            snprintf(entries[count].uri, sizeof(entries[count].uri), "%s", value);
+            snprintf(entries[count].name, sizeof(entries[count].name), "%s", value);
+            count++;
+        } else if (count > 0 && !strcmp(line, "name")) {
+            snprintf(entries[count - 1].name, sizeof(entries[count - 1].name), "%s", value);
+        } else if (count > 0 && !strcmp(line, "sf2")) {
+            snprintf(entries[count - 1].sf2_file, sizeof(entries[count - 1].sf2_file), "%s", value);
+        } else if (count > 0 && !strcmp(line, "bank")) {
+            snprintf(entries[count - 1].bank_file, sizeof(entries[count - 1].bank_file), "%s", value);
+        } else if (count > 0 && !strcmp(line, "samples")) {
+            entries[count - 1].lazy_samples = !strcmp(value, "lazy");
+        } else if (count > 0 && !strcmp(line, "source")) {
+            snprintf(entries[count - 1].source_path, sizeof(entries[count - 1].source_path), "%s", value);
+        } else if (count > 0 && !strcmp(line, "watch")) {
+            entries[count - 1].watch_soundfont = !strcmp(value, "soundfont");
+        } else if (count > 0 && !strcmp(line, "deadline")) {
+            entries[count - 1].deadline = atof(value);
+        } else if (count > 0 && !strcmp(line, "recordings")) {
+            snprintf(entries[count - 1].recordings_dir, sizeof(entries[count - 1].recordings_dir), "%s", value);
+        }
+    }
+    fclose(f);
+
+    // Every plugin needs a SoundFont to be usable
+    for (int i = 0; i < count; i++) {
+        if (!entries[i].sf2_file[0]) {
+            fprintf(stderr, "No SoundFont configured for %s\n", entries[i].uri);
+            free(entries);
+            return -1;
+        }
+        init_entry_descriptor(&entries[i]);
+    }
+
+    *entries_out = entries;
+    return count;
+}
+
+/*
+ * Free a bundle library once the host no longer needs its descriptors.
+ */
+static void library_cleanup(LV2_Lib_Handle handle)
+{
+    BundleLibrary* library = (BundleLibrary*)handle;
+    free(library->entries);
+    free(library);
+}
+
+/*
+ * Return the descriptor of the plugin at the given index, NULL past the end.
+ */
+static const LV2_Descriptor* library_get_plugin(LV2_Lib_Handle handle, uint32_t index)
+{
+    BundleLibrary* library = (BundleLibrary*)handle;
+    return (index < library->entry_count) ? &library->entries[index].descriptor : NULL;
+}
+
+/*
+ * Build the plugin descriptors of a bundle from its configuration file.
+ * Returns NULL on failure.
+ */
+static BundleLibrary* open_bundle_library(const char* bundle_path)
+{
+    BundleLibrary* library = (BundleLibrary*)calloc(1, sizeof(BundleLibrary));
+    if (!library) {
+        return NULL;
+    }
+
+    int count = read_bundle_config(bundle_path, &library->entries);
+    if (count <= 0) {
+        free(library->entries);
+        free(library);
+        return NULL;
+    }
+
+    library->entry_count = (uint32_t)count;
+    library->lib.handle = library;
+    library->lib.size = sizeof(LV2_Lib_Descriptor);
+    library->lib.cleanup = library_cleanup;
+    library->lib.get_plugin = library_get_plugin;
+    return library;
+}
+
+/*
+ * Return the library descriptor for a bundle.
+ * The host passes the bundle path before asking for any plugin, which lets
+ * one shared binary serve every bundle: the descriptors are built from the
+ * bundle's configuration file, so each bundle gets its own URI and SoundFont.
+ */
+LV2_SYMBOL_EXPORT
+const LV2_Lib_Descriptor* lv2_lib_descriptor(const char* bundle_path,
+            const LV2_Feature* const* features)
+{
+    BundleLibrary* library = open_bundle_library(bundle_path);
+    return library ? &library->lib : NULL;
+}
+
+// Bundle served by lv2_descriptor(); kept until the binary is unloaded
+static pthread_once_t own_bundle_once = PTHREAD_ONCE_INIT;
+static BundleLibrary* own_bundle = NULL;
+
+/*
+ * Read the configuration of the bundle the binary was opened from, found
+ * with dladdr(), for lv2_descriptor(). Other bundles are never scanned:
+ * hosts that call lv2_lib_descriptor() pass each bundle's path themselves.
+ */
+static void open_own_bundle(void)
+{
+    Dl_info info;
+    if (!dladdr((void*)open_own_bundle, &info) || !info.dli_fname) {
+        fprintf(stderr, "Failed to locate the plugin binary\n");
+        return;
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s", info.dli_fname);
+    own_bundle = open_bundle_library(dirname(path));
+}
+
+/* Free the descriptors of lv2_descriptor() when the binary is unloaded */
+__attribute__((destructor))
+static void close_own_bundle(void)
+{
+    if (own_bundle) {
+        library_cleanup(own_bundle);
+        own_bundle = NULL;
+    }
 }
 
+/*
+ * Return plugin descriptor, for hosts that do not call lv2_lib_descriptor().
+ * They pass no bundle path, so the descriptors come from the bundle the
+ * binary was opened from.
+ */
+LV2_SYMBOL_EXPORT
+const LV2_Descriptor* lv2_descriptor(uint32_t index)
+{
+    pthread_once(&own_bundle_once, open_own_bundle);
+    return own_bundle ? library_get_plugin(own_bundle, index) : NULL;
+}
 
+#endif
@@ -0,0 +1,84 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Synthesizer Settings (synth_settings.h)
+ *
+ * FluidSynth configuration and program selection shared by the plugin and
+ * the generator's preset profiler, so build-time measurements run the same
+ * engine setup the plugin runs.
+ */
+
+#ifndef SYNTH_SETTINGS_H
+#define SYNTH_SETTINGS_H
+
+#include <fluidsynth.h>
+#include <stdint.h>
+
+// Frames rendered per fluid_synth_write_float() call
+#define SYNTH_BLOCK_SIZE 64
+
+// Maximum number of simultaneous voices
+#define SYNTH_POLYPHONY 16
+
+// MIDI channels of a synth, FluidSynth's default
+#define SYNTH_CHANNELS 16
+
+// Rendering threads, the calling one included
+#define SYNTH_CPU_CORES 4
+
+// FluidSynth does not report its allocations. These approximate its
+// structures on a 64 bit build, where fluid_real_t is a double
+#define SYNTH_VOICE_BYTES 6144          // fluid_voice_t with its generators and modulators, and its two rvoices
+#define SYNTH_CHANNEL_BYTES 1024        // fluid_channel_t
+#define SYNTH_MIXER_BYTES (384 * 1024)  // Dry and effect mix buffers of one rendering thread
+
+// MIDI CC numbers for sound control parameters
+#define CC_CUTOFF    74  // Filter cutoff/brightness (Sound Controller 5)
+#define CC_RESONANCE 71  // Filter resonance/timbre (Sound Controller 2)
+#define CC_ATTACK    73  // Attack time
+#define CC_DECAY     75  // Decay time (Sound Controller 6)
+#define CC_SUSTAIN   70  // Sustain level (Sound Controller 1)
+#define CC_RELEASE   72  // Release time
+
+/* Configure FluidSynth settings for optimal performance */
+static inline void synth_configure(fluid_settings_t* settings, double rate) {
+    fluid_settings_setint(settings, "synth.threadsafe-api", 1);
+    fluid_settings_setint(settings, "audio.period-size", 256);
+    fluid_settings_setint(settings, "audio.periods", 2);
+    fluid_settings_setnum(settings, "synth.sample-rate", rate);
+    fluid_settings_setint(settings, "synth.cpu-cores", SYNTH_CPU_CORES);
+    fluid_settings_setint(settings, "synth.polyphony", SYNTH_POLYPHONY);
+    fluid_settings_setint(settings, "synth.midi-channels", SYNTH_CHANNELS);
+    // Keep loaded samples from paging out; FluidSynth only logs a failed mlock()
+    fluid_settings_setint(settings, "synth.lock-memory", 1);
+    fluid_settings_setint(settings, "synth.reverb.active", 0);
+    fluid_settings_setint(settings, "synth.chorus.active", 0);
+}
+
+/*
+ * Estimate the memory FluidSynth holds for a synth apart from samples: its
+ * voices, channels and the mix buffers of each rendering thread.
+ */
+static inline int64_t synth_memory_estimate(int polyphony, int channels, int cpu_cores) {
+    return (int64_t)polyphony * SYNTH_VOICE_BYTES + (int64_t)channels * SYNTH_CHANNEL_BYTES +
+           (int64_t)cpu_cores * SYNTH_MIXER_BYTES;
+}
+
+/*
+ * Select a preset on channel 0 the way the Program port does: reset the
+ * sound control CCs (cutoff fully open, others to 0), then send bank
+ * select and program change.
+ * Returns FLUID_OK on success.
+ */
+static inline int synth_select_program(fluid_synth_t* synth, int bank, int prog) {
+    fluid_synth_cc(synth, 0, CC_CUTOFF, 127);
+    fluid_synth_cc(synth, 0, CC_RESONANCE, 0);
+    fluid_synth_cc(synth, 0, CC_ATTACK, 0);
+    fluid_synth_cc(synth, 0, CC_DECAY, 0);
+    fluid_synth_cc(synth, 0, CC_SUSTAIN, 0);
+    fluid_synth_cc(synth, 0, CC_RELEASE, 0);
+
+    fluid_synth_bank_select(synth, 0, bank);
+    return fluid_synth_program_change(synth, 0, prog);
+}
+
+#endif
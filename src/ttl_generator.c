@@ -3,24 +3,97 @@
  * TTL Generator (ttl_generator.c)
  *
  * This program:
- * 1. Loads a SoundFont file using FluidSynth
- * 2. Scans all available presets (including bank 128 for drum kits)
+ * 1. Reads the SoundFont preset headers with the streaming parser (sf2_parser.c)
+ * 2. Lists all available presets (including bank 128 for drum kits)
  * 3. Generates LV2 TTL files describing the plugin interface
  * 4. Creates a manifest file for LV2 plugin discovery
+ * 5. Optionally writes a preprocessed sample bank (preset and zone tables of
+ *    the bundle's SoundFont) the plugin maps at startup
+ * 6. Optionally reduces the SoundFont to a subset of its presets
  */
 
-#include <fluidsynth.h>
+#include "sf2_parser.h"
+#include "content_hash.h"
+#include "content_store.h"
+#include "bundle_cache.h"
+#include "sf2_bank.h"
+#include "sf2_bank_writer.h"
+#include "sf2_writer.h"
+#include "sf2_dedup.h"
+#include "sf2_analyzer.h"
+#include "preset_profiler.h"
+#include "synth_settings.h"
+#include "util.h"
+
+#include <ctype.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 /* Plugin name should be defined at compile time using the make command, defaults to "undefined" */
 #ifndef PLUGIN_NAME
 #define PLUGIN_NAME "undefined"
 #endif
 
+// Name of the cache record written into every bundle
+#define CACHE_RECORD_NAME ".sf2lv2-cache"
+
+// Content-addressed store shared by all bundles for SoundFonts and plugin binaries,
+// kept inside the output directory
+#define STORE_SUBDIR ".store"
+
+// Bundle configuration read by the generic plugin binary
+#define BUNDLE_CONFIG_FILE "sf2lv2.conf"
+
+// Namespace of the resource annotations written into plugin and preset metadata
+#define SF2LV2_NS "https://github.com/islainstruments/sf2lv2/ns#"
+
+/* How presets are described in the generated metadata */
+typedef enum {
+    LAYOUT_INLINE = 0,  // Every preset is a scale point of the Program port
+    LAYOUT_PRESETS      // Minimal plugin TTL, presets as lazily loaded LV2 preset files
+} TtlLayout;
+
+/* Options shared by every bundle generated in one run */
+typedef struct {
+    uint64_t inputs_hash;       // Hash of the generator/plugin sources and build flags
+    int force;                  // Rebuild even if the cache record matches
+    const char* binary_path;    // Generic plugin binary to link into bundles (optional)
+    uint64_t binary_hash;       // Content hash of the plugin binary
+    const char* combined_name;  // Put every plugin into this one bundle (optional)
+    const char* output_root;    // Directory that receives the bundles and the store
+    TtlLayout layout;           // Where preset names are described
+    int bank;                   // Write a preprocessed sample bank into each bundle
+    int lazy_samples;           // Plugins load sample data only for presets in use
+    int watch_soundfont;        // Plugins reload their SoundFont when the file changes
+    double deadline;            // Fraction of the block duration run() may take, 0 for the default
+    const char* recordings_dir; // Directory for flight recordings of deadline misses (optional)
+    const char* preset_filter;  // Only keep presets matching this filter (optional)
+    SF2WriteOptions reduce;     // Sample data reductions applied to the shipped SoundFont
+    int profile;                // Render a stress pattern through every preset and time it
+    double profile_scale;       // Factor from this machine's render times to the target's
+} GeneratorOptions;
+
+/* Check whether the shipped SoundFont differs from the source one */
+static int rewrites_soundfont(const GeneratorOptions* options) {
+    return options->preset_filter || options->reduce.trim_loop_tails ||
+           options->reduce.drop_sm24 || options->reduce.target_rate > 0 || options->reduce.dedup_samples;
+}
+
+/* A plugin listed in a bundle's manifest and configuration */
+typedef struct {
+    const char* plugin_name;    // Plugin name, also used for the TTL file name
+    const char* sf2_file;       // SoundFont file name inside the bundle
+    const char* source_path;    // SoundFont the bundle was generated from
+    int preset_count;           // Presets listed in the manifest with LAYOUT_PRESETS
+} BundlePlugin;
+
 /* Structure to store bank/program mapping information */
 struct PresetMapping {
     int bank;           // MIDI bank number
@@ -37,48 +110,574 @@ void sanitize_name(char* name) {
     }
 }
 
-/* Utility function to copy files with error checking */
-void copy_file(const char* src_path, const char* dst_path) {
-    FILE* src = fopen(src_path, "rb");
-    if (!src) {
-        perror("Failed to open source file");
-        exit(1);
+/* Return the file name part of a path */
+static const char* sf2_basename(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+/* Directory of the bundle a plugin is written to */
+static void bundle_dir(char* dir, size_t size, const char* plugin_name, const GeneratorOptions* options) {
+    snprintf(dir, size, "%s/%s.lv2", options->output_root,
+             options->combined_name ? options->combined_name : plugin_name);
+}
+
+/* Directory of the content-addressed store */
+static void store_dir(char* dir, size_t size, const GeneratorOptions* options) {
+    snprintf(dir, size, "%s/%s", options->output_root, STORE_SUBDIR);
+}
+
+/*
+ * Length of the valid UTF-8 sequence starting at p, or 0 if p does not
+ * start one
+ */
+static int utf8_sequence_length(const unsigned char* p) {
+    int length = *p >= 0xF0 && *p <= 0xF4 ? 4 : *p >= 0xE0 ? 3 : *p >= 0xC2 && *p < 0xE0 ? 2 : 0;
+    for (int i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+/*
+ * Write a Turtle string literal. SoundFont names may hold any byte: quotes
+ * and backslashes are escaped, tabs and line breaks use their short escapes
+ * and other control characters a \u escape. Bytes that are not valid UTF-8
+ * are taken as Latin-1, the encoding older SoundFont editors write.
+ */
+static void write_ttl_string(FILE* ttl, const char* text) {
+    fputc('"', ttl);
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        int length;
+        switch (*p) {
+            case '"':  fputs("\\\"", ttl); break;
+            case '\\': fputs("\\\\", ttl); break;
+            case '\n': fputs("\\n", ttl); break;
+            case '\r': fputs("\\r", ttl); break;
+            case '\t': fputs("\\t", ttl); break;
+            default:
+                if (*p < 0x20 || *p == 0x7F) {
+                    fprintf(ttl, "\\u%04X", *p);
+                } else if (*p < 0x80) {
+                    fputc(*p, ttl);
+                } else if ((length = utf8_sequence_length(p)) > 0) {
+                    fwrite(p, 1, (size_t)length, ttl);
+                    p += length - 1;
+                } else {
+                    fprintf(ttl, "\\u%04X", *p);
+                }
+                break;
+        }
+    }
+    fputc('"', ttl);
+}
+
+/*
+ * Write the predicted resource use (stats) and measured render cost (profile)
+ * of one preset as sf2lv2: properties, each line starting with indent and
+ * ending in ';'. Either may be NULL.
+ */
+static void write_preset_annotations(FILE* ttl, const SF2PresetStats* stats,
+                                     const PresetProfile* profile, const char* indent) {
+    if (stats) {
+        fprintf(ttl,
+            "%ssf2lv2:sampleBytes %lld ;\n"
+            "%ssf2lv2:sampleCount %d ;\n"
+            "%ssf2lv2:maxZonesPerNote %d ;\n"
+            "%ssf2lv2:avgZonesPerNote %.2f ;\n"
+            "%ssf2lv2:loopingZoneRatio %.2f ;\n",
+            indent, (long long)stats->sample_bytes,
+            indent, stats->sample_count,
+            indent, stats->max_zones,
+            indent, stats->avg_zones,
+            indent, stats->zone_count > 0 ? (double)stats->looping_zones / stats->zone_count : 0.0
+        );
+    }
+    if (profile) {
+        fprintf(ttl,
+            "%ssf2lv2:nsPerSample %.1f ;\n"
+            "%ssf2lv2:worstBlockNs %.0f ;\n"
+            "%ssf2lv2:peakVoices %d ;\n"
+            "%ssf2lv2:lateBlocks %d ;\n",
+            indent, profile->ns_per_sample,
+            indent, profile->worst_block_ns,
+            indent, profile->peak_voices,
+            indent, profile->late_blocks
+        );
+    }
+}
+
+/*
+ * Write the presets layout for one plugin: one small preset file per preset
+ * (<plugin>.presets/<index>.ttl) that names the preset, sets the Program
+ * port and records the preset's resource annotations if stats or profiles
+ * are given. The manifest lists each preset with lv2:appliesTo and points
+ * to its file with rdfs:seeAlso, as LV2 presets are declared, so hosts
+ * only parse the files when the plugin's presets are loaded.
+ * Returns 0 on success, -1 on failure.
+ */
+static int write_preset_files(const char* output_dir, const char* plugin_name,
+                              const SF2Preset* presets, const SF2PresetStats* stats,
+                              const PresetProfile* profiles, int count, FILE* log) {
+    char path[4096], preset_dir[4096];
+    if (snprintf(preset_dir, sizeof(preset_dir), "%s/%s.presets", output_dir, plugin_name) >= (int)sizeof(preset_dir)) {
+        fprintf(log, "Path too long for preset files\n");
+        return -1;
+    }
+    if (mkdir(preset_dir, 0777) != 0 && errno != EEXIST) {
+        log_errno(log, "Failed to create preset directory", NULL);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (snprintf(path, sizeof(path), "%s/%d.ttl", preset_dir, i) >= (int)sizeof(path)) {
+            fprintf(log, "Path too long for preset files\n");
+            return -1;
+        }
+        FILE* preset = fopen(path, "w");
+        if (!preset) {
+            log_errno(log, "Failed to open preset file", NULL);
+            return -1;
+        }
+        fprintf(preset,
+            "@prefix lv2: <http://lv2plug.in/ns/lv2core#> .\n"
+            "@prefix pset: <http://lv2plug.in/ns/ext/presets#> .\n"
+            "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n"
+            "@prefix sf2lv2: <%s> .\n\n"
+            "<https://github.com/islainstruments/sf2lv2/%s/presets/%d>\n"
+            "    a pset:Preset ;\n"
+            "    lv2:appliesTo <https://github.com/islainstruments/sf2lv2/%s> ;\n"
+            "    rdfs:label ",
+            SF2LV2_NS, plugin_name, i, plugin_name
+        );
+        write_ttl_string(preset, presets[i].name);
+        fprintf(preset, " ;\n");
+        write_preset_annotations(preset, stats ? &stats[i] : NULL, profiles ? &profiles[i] : NULL, "    ");
+        fprintf(preset,
+            "    lv2:port [\n"
+            "        lv2:symbol \"program\" ;\n"
+            "        pset:value %d\n"
+            "    ] .\n",
+            i
+        );
+        if (fclose(preset) != 0) {
+            log_errno(log, "Failed to write preset file", NULL);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Write the bundle level files: the manifest listing every plugin, the
+ * configuration read by the generic plugin binary, and the binary itself
+ * (linked from the store as <binary_name>.so). A combined bundle lists many
+ * plugins that all share the one binary.
+ * Returns 0 on success, -1 on failure.
+ */
+static int write_bundle_index(const char* output_dir, const char* binary_name,
+                              const BundlePlugin* plugins, int count,
+                              const GeneratorOptions* options, FILE* log) {
+    char manifest_path[4096], config_path[4096];
+    if (snprintf(manifest_path, sizeof(manifest_path), "%s/manifest.ttl", output_dir) >= (int)sizeof(manifest_path) ||
+        snprintf(config_path, sizeof(config_path), "%s/%s", output_dir, BUNDLE_CONFIG_FILE) >= (int)sizeof(config_path)) {
+        fprintf(log, "Path too long for manifest file\n");
+        return -1;
     }
 
-    FILE* dst = fopen(dst_path, "wb");
-    if (!dst) {
-        perror("Failed to open destination file");
-        fclose(src);
-        exit(1);
+    // Write manifest.ttl
+    FILE* manifest = fopen(manifest_path, "w");
+    if (!manifest) {
+        log_errno(log, "Failed to write manifest", NULL);
+        return -1;
     }
+    fprintf(manifest,
+        "@prefix lv2: <http://lv2plug.in/ns/lv2core#> .\n"
+        "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n"
+    );
+    if (options->layout == LAYOUT_PRESETS) {
+        fprintf(manifest, "@prefix pset: <http://lv2plug.in/ns/ext/presets#> .\n");
+    }
+    for (int i = 0; i < count; i++) {
+        fprintf(manifest,
+            "\n<https://github.com/islainstruments/sf2lv2/%s>\n"
+            "    a lv2:Plugin ;\n"
+            "    lv2:binary <%s.so> ;\n"
+            "    rdfs:seeAlso <%s.ttl> .\n",
+            plugins[i].plugin_name, binary_name, plugins[i].plugin_name
+        );
+        // Each preset's file is only parsed when the host loads the plugin's presets
+        for (int p = 0; options->layout == LAYOUT_PRESETS && p < plugins[i].preset_count; p++) {
+            fprintf(manifest,
+                "\n<https://github.com/islainstruments/sf2lv2/%s/presets/%d>\n"
+                "    a pset:Preset ;\n"
+                "    lv2:appliesTo <https://github.com/islainstruments/sf2lv2/%s> ;\n"
+                "    rdfs:seeAlso <%s.presets/%d.ttl> .\n",
+                plugins[i].plugin_name, p, plugins[i].plugin_name, plugins[i].plugin_name, p
+            );
+        }
+    }
+    fclose(manifest);
 
-    char buffer[8192];
-    size_t bytes;
-    while ((bytes = fread(buffer, 1, sizeof(buffer), src)) > 0) {
-        if (fwrite(buffer, 1, bytes, dst) != bytes) {
-            perror("Failed to write to destination file");
-            fclose(src);
-            fclose(dst);
-            exit(1);
+    // Tell the generic plugin binary which URIs and SoundFonts this bundle serves
+    FILE* config = fopen(config_path, "w");
+    if (!config) {
+        log_errno(log, "Failed to write bundle configuration", NULL);
+        return -1;
+    }
+    fprintf(config, "# SF2LV2 bundle configuration, generated by ttl_generator\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(config,
+            "plugin https://github.com/islainstruments/sf2lv2/%s\n"
+            "name %s\n"
+            "sf2 %s\n",
+            plugins[i].plugin_name, plugins[i].plugin_name, plugins[i].sf2_file
+        );
+        if (options->bank) {
+            fprintf(config, "bank %s%s\n", plugins[i].plugin_name, SF2_BANK_EXT);
+        }
+        if (options->lazy_samples) {
+            fprintf(config, "samples lazy\n");
+        }
+        if (options->watch_soundfont) {
+            fprintf(config, "watch soundfont\n");
+
+            // The bundle holds a store copy; edits are saved to the source file.
+            // A rewritten SoundFont has no source the plugin could load as is
+            char* source = rewrites_soundfont(options) ? NULL : realpath(plugins[i].source_path, NULL);
+            if (source) {
+                fprintf(config, "source %s\n", source);
+                free(source);
+            }
         }
+        if (options->deadline > 0) {
+            fprintf(config, "deadline %g\n", options->deadline);
+        }
+        if (options->recordings_dir) {
+            fprintf(config, "recordings %s\n", options->recordings_dir);
+        }
+    }
+    fclose(config);
+
+    // Link the shared plugin binary into the bundle under the name the manifest uses
+    if (options->binary_path) {
+        char so_path[4096], object_path[4096], store[4096];
+        StoreMethod method;
+        store_dir(store, sizeof(store), options);
+        if (snprintf(so_path, sizeof(so_path), "%s/%s.so", output_dir, binary_name) >= (int)sizeof(so_path) ||
+            store_add(store, options->binary_path, options->binary_hash,
+                      object_path, sizeof(object_path), log) != 0 ||
+            store_place(object_path, so_path, &method, log) != 0) {
+            fprintf(log, "Failed to place plugin binary into bundle\n");
+            return -1;
+        }
+        fprintf(log, "Plugin binary placed from store (%s): %s\n", store_method_name(method), object_path);
     }
 
-    fclose(src);
-    fclose(dst);
+    return 0;
 }
 
-int main(int argc, char** argv) {
-    fprintf(stderr, "Starting SF2LV2 generator...\n");
-    
-    // Check command line arguments
-    if (argc < 2) {
-        printf("Usage: %s <soundfont.sf2>\n", argv[0]);
+/* Check a number against "*", "<n>" or "<first>-<last>" */
+static int number_matches(const char* spec, int value) {
+    int first, last;
+    char extra;
+    if (!strcmp(spec, "*")) {
         return 1;
     }
+    if (sscanf(spec, "%d-%d%c", &first, &last, &extra) == 2) {
+        return value >= first && value <= last;
+    }
+    if (sscanf(spec, "%d%c", &first, &extra) == 1) {
+        return value == first;
+    }
+    return 0;
+}
+
+/* Match a shell style pattern (* and ?) against text, ignoring case */
+static int name_matches(const char* pattern, const char* text) {
+    if (*pattern == '\0') {
+        return *text == '\0';
+    }
+    if (*pattern == '*') {
+        return name_matches(pattern + 1, text) || (*text && name_matches(pattern, text + 1));
+    }
+    if (*text && (*pattern == '?' || tolower((unsigned char)*pattern) == tolower((unsigned char)*text))) {
+        return name_matches(pattern + 1, text + 1);
+    }
+    return 0;
+}
+
+/*
+ * Check whether a preset is selected by a filter.
+ * The filter is a comma separated list of items. An item is either
+ * "<bank>:<prog>", where each side is a number, a range "a-b" or "*",
+ * or a pattern matched against the preset name (case insensitive).
+ */
+static int preset_selected(const char* filter, const SF2Preset* preset) {
+    const char* item = filter;
+    while (*item) {
+        size_t length = strcspn(item, ",");
+        char spec[256];
+        snprintf(spec, sizeof(spec), "%.*s", (int)(length < sizeof(spec) ? length : sizeof(spec) - 1), item);
+
+        char* colon = strchr(spec, ':');
+        if (colon && strspn(spec, "0123456789-*") == (size_t)(colon - spec) &&
+            strspn(colon + 1, "0123456789-*") == strlen(colon + 1)) {
+            *colon = '\0';
+            if (number_matches(spec, preset->bank) && number_matches(colon + 1, preset->prog)) {
+                return 1;
+            }
+        } else if (spec[0] && name_matches(spec, preset->name)) {
+            return 1;
+        }
+
+        item += length;
+        if (*item == ',') item++;
+    }
+    return 0;
+}
+
+/*
+ * Write a SoundFont holding only the given presets and the instruments and
+ * samples they reference, and add it to the store. The presets are re-read
+ * from the new file so their zone indices match it.
+ * Returns the number of presets, or -1 on failure.
+ */
+static int write_preset_subset(const char* sf2_path, SF2Preset** presets, int preset_count,
+                               const char* output_dir, const char* plugin_name,
+                               const GeneratorOptions* options, char* object_path,
+                               size_t object_path_size, uint64_t* hash_out, FILE* log) {
+    char temp_path[4096], store[4096];
+    if (snprintf(temp_path, sizeof(temp_path), "%s/.%s.tmp.sf2", output_dir, plugin_name) >= (int)sizeof(temp_path)) {
+        fprintf(log, "Path too long for SoundFont subset\n");
+        return -1;
+    }
+
+    SF2File sf;
+    SF2WriteReport report;
+    if (sf2_open(&sf, sf2_path) != 0) {
+        fprintf(log, "Failed to load SoundFont: %s\n", sf2_path);
+        return -1;
+    }
+    int result = sf2_write_subset(&sf, *presets, preset_count, &options->reduce, temp_path, &report, log);
+    sf2_close(&sf);
+    if (result != 0) {
+        return -1;
+    }
+
+    // Zone indices differ in the new file, so its presets replace the source ones
+    SF2Preset* subset_presets = NULL;
+    int count = -1;
+    store_dir(store, sizeof(store), options);
+    if (sf2_open(&sf, temp_path) == 0) {
+        count = sf2_read_presets(&sf, &subset_presets);
+        sf2_close(&sf);
+    }
+    if (count != preset_count ||
+        content_hash_file(temp_path, hash_out) != 0 ||
+        store_add(store, temp_path, *hash_out, object_path, object_path_size, log) != 0) {
+        fprintf(log, "Failed to store SoundFont subset\n");
+        free(subset_presets);
+        free(report.samples);
+        unlink(temp_path);
+        return -1;
+    }
+    unlink(temp_path);
+    free(*presets);
+    *presets = subset_presets;
+
+
+    int64_t saved = report.source_sample_bytes - report.sample_bytes;
+    char before[32], after[32], saved_text[32];
+    fprintf(log, "Preset subset: %d presets, %d instruments, %d of %d samples\n",
+            report.preset_count, report.instrument_count, report.sample_count, report.source_sample_count);
+    fprintf(log, "Sample data: %s -> %s (%s saved, %.0f%%)\n",
+            format_bytes(report.source_sample_bytes, before, sizeof(before)),
+            format_bytes(report.sample_bytes, after, sizeof(after)),
+            format_bytes(saved, saved_text, sizeof(saved_text)),
+            report.source_sample_bytes > 0 ? 100.0 * saved / report.source_sample_bytes : 0.0);
+    if (options->reduce.dedup_samples) {
+        fprintf(log, "Deduplicated: %d of %d samples hold distinct data (%s shared)\n",
+                report.distinct_sample_count, report.sample_count,
+                format_bytes(report.shared_bytes, saved_text, sizeof(saved_text)));
+    }
+
+    // One line per sample the reductions changed
+    for (int i = 0; i < report.sample_count; i++) {
+        const SF2SampleReport* sample = &report.samples[i];
+        if (sample->bytes == sample->source_bytes && !sample->lossy) {
+            continue;
+        }
+        char changes[96] = "";
+        size_t length = 0;
+        if (sample->trimmed_points > 0) {
+            length += snprintf(changes + length, sizeof(changes) - length, " trimmed %u points", sample->trimmed_points);
+        }
+        if (sample->rate != sample->source_rate && length < sizeof(changes)) {
+            length += snprintf(changes + length, sizeof(changes) - length, " %u->%u Hz", sample->source_rate, sample->rate);
+        }
+        if (sample->dropped_sm24 && length < sizeof(changes)) {
+            length += snprintf(changes + length, sizeof(changes) - length, " 16 bit");
+        }
+        if (sample->shared_with >= 0 && length < sizeof(changes)) {
+            snprintf(changes + length, sizeof(changes) - length, " shares %s", report.samples[sample->shared_with].name);
+        }
+        char error[32] = "lossless";
+        if (sample->lossy) {
+            snprintf(error, sizeof(error), "error %.1f dB", sample->error_db);
+        }
+        fprintf(log, "  %-20s %s -> %s (%s saved,%s, %s)\n", sample->name,
+                format_bytes(sample->source_bytes, before, sizeof(before)),
+                format_bytes(sample->bytes, after, sizeof(after)),
+                format_bytes(sample->source_bytes - sample->bytes, saved_text, sizeof(saved_text)),
+                changes, error);
+    }
+    free(report.samples);
+    return count;
+}
+
+/*
+ * Write the preprocessed sample bank of a plugin (<plugin_name>.sf2bank).
+ * The bank describes the SoundFont placed in the bundle and holds none of
+ * its data. It is built next to the bundle, added to the store under its
+ * own content hash and linked into the bundle like the SoundFont.
+ * Returns 0 on success, -1 on failure.
+ */
+static int write_bundle_bank(const char* sf2_path, const SF2Preset* presets,
+                             int preset_count, const char* output_dir, const char* plugin_name,
+                             const GeneratorOptions* options, FILE* log) {
+    char temp_path[4096], bank_path[4096], object_path[4096], store[4096];
+    if (snprintf(temp_path, sizeof(temp_path), "%s/.%s.tmp%s", output_dir, plugin_name, SF2_BANK_EXT) >= (int)sizeof(temp_path) ||
+        snprintf(bank_path, sizeof(bank_path), "%s/%s%s", output_dir, plugin_name, SF2_BANK_EXT) >= (int)sizeof(bank_path)) {
+        fprintf(log, "Path too long for sample bank\n");
+        return -1;
+    }
+
+    SF2File sf;
+    if (sf2_open(&sf, sf2_path) != 0) {
+        fprintf(log, "Failed to load SoundFont: %s\n", sf2_path);
+        return -1;
+    }
+    int zone_count = sf2_bank_write(&sf, presets, preset_count, temp_path, log);
+    sf2_close(&sf);
+    if (zone_count < 0) {
+        return -1;
+    }
+
+    uint64_t bank_hash;
+    StoreMethod method;
+    store_dir(store, sizeof(store), options);
+    int result = -1;
+    if (content_hash_file(temp_path, &bank_hash) == 0 &&
+        store_add(store, temp_path, bank_hash, object_path, sizeof(object_path), log) == 0 &&
+        store_place(object_path, bank_path, &method, log) == 0) {
+        fprintf(log, "Sample bank with %d zones placed from store (%s): %s\n",
+                zone_count, store_method_name(method), object_path);
+        result = 0;
+    } else {
+        fprintf(log, "Failed to place sample bank into bundle\n");
+    }
+    unlink(temp_path);
+    return result;
+}
+
+// Profiling runs one SoundFont at a time so batch threads do not skew each other's timings
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Profile every preset of the SoundFont a plugin ships and write the results
+ * to <plugin_name>.profile.tsv in the bundle, one line per Program port value.
+ * Presets whose slowest block exceeds the SYNTH_BLOCK_SIZE frame deadline
+ * are reported.
+ * Returns 0 on success, -1 on failure.
+ */
+static int profile_presets(const char* sf2_path, const SF2Preset* presets, int preset_count,
+                           const char* output_dir, const char* plugin_name,
+                           const GeneratorOptions* options, PresetProfile** profiles_out, FILE* log) {
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/%s.profile.tsv", output_dir, plugin_name) >= (int)sizeof(path)) {
+        fprintf(log, "Path too long for profile\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&profile_lock);
+    int result = preset_profile(sf2_path, presets, preset_count, options->profile_scale, profiles_out, log);
+    pthread_mutex_unlock(&profile_lock);
+    if (result != 0) {
+        return -1;
+    }
+
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        log_errno(log, "Failed to open profile", NULL);
+        free(*profiles_out);
+        *profiles_out = NULL;
+        return -1;
+    }
+    fprintf(out, "# %d frame blocks at %d Hz, deadline %.0f ns, time scale %.2f\n",
+            SYNTH_BLOCK_SIZE, PROFILE_RATE, 1e9 * SYNTH_BLOCK_SIZE / PROFILE_RATE, options->profile_scale);
+    fprintf(out, "program\tbank\tprog\tns_per_sample\tworst_block_ns\tpeak_voices\tlate_blocks\tblocks\tname\n");
 
+    int late = 0;
+    for (int i = 0; i < preset_count; i++) {
+        const PresetProfile* profile = &(*profiles_out)[i];
+        fprintf(out, "%d\t%d\t%d\t%.1f\t%.0f\t%d\t%d\t%d\t%s\n", i, presets[i].bank, presets[i].prog,
+                profile->ns_per_sample, profile->worst_block_ns, profile->peak_voices,
+                profile->late_blocks, profile->blocks, presets[i].name);
+        if (profile->late_blocks > 0) late++;
+    }
+    if (fclose(out) != 0) {
+        log_errno(log, "Failed to write profile", NULL);
+        free(*profiles_out);
+        *profiles_out = NULL;
+        return -1;
+    }
+
+    if (late > 0) {
+        fprintf(log, "Warning: %d of %d presets miss the %d frame deadline\n", late, preset_count, SYNTH_BLOCK_SIZE);
+    }
+    return 0;
+}
+
+/*
+ * Predict the resource use of the presets of the SoundFont a plugin ships.
+ * sample_data_bytes receives the size of all sample data, which FluidSynth
+ * loads in full. Analysis is advisory: on failure a warning is logged and
+ * NULL is returned so the plugin is still generated without annotations.
+ */
+static SF2PresetStats* analyze_presets(const char* sf2_path, const SF2Preset* presets, int preset_count,
+                                       int64_t* sample_data_bytes, FILE* log) {
+    SF2File sf;
+    SF2PresetStats* stats = NULL;
+    if (sf2_open(&sf, sf2_path) != 0) {
+        fprintf(log, "Warning: cannot analyze SoundFont: %s\n", sf2_path);
+        return NULL;
+    }
+    uint32_t points = sf.smpl.size / 2;
+    *sample_data_bytes = (int64_t)sf.smpl.size + (sf.sm24.size >= points && points > 0 ? sf.sm24.size : 0);
+    if (sf2_analyze_presets(&sf, presets, preset_count, &stats) != 0) {
+        fprintf(log, "Warning: cannot analyze presets of: %s\n", sf2_path);
+        stats = NULL;
+    }
+    sf2_close(&sf);
+    return stats;
+}
+
+/*
+ * Write one plugin bundle (build/<plugin_name>.lv2) from a SoundFont, or add
+ * the plugin to the combined bundle when options->combined_name is set.
+ * All progress and error output goes to the given log stream so that
+ * concurrent batch jobs do not interleave their preset tables.
+ * sf2_hash is the SoundFont's content hash, used as its key in the store.
+ * Returns the number of presets written, or -1 on failure.
+ */
+static int write_bundle(const char* sf2_path, uint64_t sf2_hash, const char* plugin_name,
+                        const GeneratorOptions* options, FILE* log) {
     // Process SoundFont filename
     char soundfont_name[256];
-    strncpy(soundfont_name, argv[1], 255);
+    strncpy(soundfont_name, sf2_path, 255);
     soundfont_name[255] = '\0';
 
     // Extract base name without path and extension
@@ -97,83 +696,91 @@ int main(int argc, char** argv) {
 
     // Set up output directory structure
     char output_dir[4096];
-    snprintf(output_dir, sizeof(output_dir), "build/%s.lv2", PLUGIN_NAME);
+    bundle_dir(output_dir, sizeof(output_dir), plugin_name, options);
 
-    // Create build directory if it doesn't exist
-    if (mkdir("build", 0777) != 0 && errno != EEXIST) {
-        perror("Failed to create 'build' directory");
-        return 1;
+    // Open the SoundFont and locate its chunks without loading sample data
+    SF2File sf;
+    if (sf2_open(&sf, sf2_path) != 0) {
+        fprintf(log, "Failed to load SoundFont: %s\n", sf2_path);
+        return -1;
     }
 
-    // Create plugin directory if it doesn't exist
-    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
-        perror("Failed to create plugin directory");
-        return 1;
+    // Read the preset headers in the same bank/program order FluidSynth uses
+    SF2Preset* presets = NULL;
+    int total_presets = sf2_read_presets(&sf, &presets);
+    sf2_close(&sf);
+    if (total_presets < 0) {
+        fprintf(log, "Failed to read presets from: %s\n", sf2_path);
+        return -1;
     }
 
-    // Initialize FluidSynth
-    fluid_settings_t* settings = new_fluid_settings();
-    fluid_synth_t* synth = new_fluid_synth(settings);
-    
-    // Load the SoundFont file
-    int sfont_id = fluid_synth_sfload(synth, argv[1], 1);
-    if (sfont_id == FLUID_FAILED) {
-        fprintf(stderr, "Failed to load SoundFont: %s\n", argv[1]);
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return 1;
+    if (total_presets == 0) {
+        fprintf(log, "No presets found in soundfont\n");
+        free(presets);
+        return -1;
     }
+    fprintf(log, "Found %d total presets\n", total_presets);
 
-    // Get SoundFont instance
-    fluid_sfont_t* sfont = fluid_synth_get_sfont(synth, 0);
-    if (!sfont) {
-        fprintf(stderr, "Failed to get soundfont instance\n");
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return 1;
+    // Keep only the presets selected by the filter
+    if (options->preset_filter) {
+        int kept = 0;
+        for (int i = 0; i < total_presets; i++) {
+            if (preset_selected(options->preset_filter, &presets[i])) {
+                presets[kept++] = presets[i];
+            }
+        }
+        if (kept == 0) {
+            fprintf(log, "No presets match filter '%s'\n", options->preset_filter);
+            free(presets);
+            return -1;
+        }
+        fprintf(log, "Keeping %d of %d presets matching '%s'\n", kept, total_presets, options->preset_filter);
+        total_presets = kept;
     }
 
-    // Count total available presets
-    int total_presets = 0;
-    int bank, prog;
-    fluid_preset_t* preset;
+    // Create build directory if it doesn't exist
+    if (mkdir(options->output_root, 0777) != 0 && errno != EEXIST) {
+        log_errno(log, "Failed to create output directory", NULL);
+        free(presets);
+        return -1;
+    }
 
-    // Scan all banks (including bank 128 for drum kits)
-    for (bank = 0; bank <= 128; bank++) {
-        for (prog = 0; prog < 128; prog++) {
-            preset = fluid_sfont_get_preset(sfont, bank, prog);
-            if (preset != NULL) {
-                total_presets++;
-            }
-        }
+    // Create plugin directory if it doesn't exist
+    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
+        log_errno(log, "Failed to create plugin directory", NULL);
+        free(presets);
+        return -1;
     }
 
-    if (total_presets == 0) {
-        fprintf(stderr, "No presets found in soundfont\n");
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return 1;
+    // A filtered or reduced plugin ships a rewritten SoundFont instead of the
+    // source file; Program port values are renumbered to the kept presets
+    const char* source_path = sf2_path;
+    uint64_t source_hash = sf2_hash;
+    char subset_object[4096];
+    if (rewrites_soundfont(options)) {
+        total_presets = write_preset_subset(sf2_path, &presets, total_presets, output_dir, plugin_name,
+                                            options, subset_object, sizeof(subset_object), &source_hash, log);
+        if (total_presets < 0) {
+            free(presets);
+            return -1;
+        }
+        source_path = subset_object;
     }
-    fprintf(stderr, "Found %d total presets\n", total_presets);
 
     // Prepare output files
-    char ttl_path[4096], manifest_path[4096];
-    if (snprintf(ttl_path, sizeof(ttl_path), "%s/%s.ttl", output_dir, PLUGIN_NAME) >= sizeof(ttl_path)) {
-        fprintf(stderr, "Path too long for TTL file\n");
-        return 1;
-    }
-    if (snprintf(manifest_path, sizeof(manifest_path), "%s/manifest.ttl", output_dir) >= sizeof(manifest_path)) {
-        fprintf(stderr, "Path too long for manifest file\n");
-        return 1;
+    char ttl_path[4096];
+    if (snprintf(ttl_path, sizeof(ttl_path), "%s/%s.ttl", output_dir, plugin_name) >= (int)sizeof(ttl_path)) {
+        fprintf(log, "Path too long for TTL file\n");
+        free(presets);
+        return -1;
     }
 
     // Open main TTL file
     FILE* ttl = fopen(ttl_path, "w");
     if (!ttl) {
-        perror("Failed to open plugin TTL file");
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return 1;
+        log_errno(log, "Failed to open plugin TTL file", NULL);
+        free(presets);
+        return -1;
     }
 
     // Write TTL prefix definitions
@@ -182,8 +789,13 @@ int main(int argc, char** argv) {
         "@prefix doap: <http://usefulinc.com/ns/doap#> .\n"
         "@prefix foaf: <http://xmlns.com/foaf/0.1/> .\n"
         "@prefix lv2: <http://lv2plug.in/ns/lv2core#> .\n"
+        "@prefix patch: <http://lv2plug.in/ns/ext/patch#> .\n"
+        "@prefix pprops: <http://lv2plug.in/ns/ext/port-props#> .\n"
         "@prefix rdf: <http://www.w3.org/1999/02/22-rdf-syntax-ns#> .\n"
-        "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n\n"
+        "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n"
+        "@prefix sf2lv2: <%s> .\n"
+        "@prefix units: <http://lv2plug.in/ns/extensions/units#> .\n\n",
+        SF2LV2_NS
     );
 
     // Write plugin definition
@@ -191,10 +803,15 @@ int main(int argc, char** argv) {
         "<https://github.com/islainstruments/sf2lv2/%s>\n"
         "    a lv2:InstrumentPlugin, lv2:Plugin ;\n"
         "    lv2:requiredFeature <http://lv2plug.in/ns/ext/urid#map> ;\n"
+        "    lv2:optionalFeature <http://lv2plug.in/ns/ext/worker#schedule> ;\n"
+        "    lv2:extensionData <http://lv2plug.in/ns/ext/state#interface> ,\n"
+        "        <http://lv2plug.in/ns/ext/worker#interface> ;\n"
+        "    patch:writable sf2lv2:soundfont ;\n"
         "    lv2:port [\n"
         "        a lv2:InputPort, atom:AtomPort ;\n"
         "        atom:bufferType atom:Sequence ;\n"
-        "        atom:supports <http://lv2plug.in/ns/ext/midi#MidiEvent> ;\n"
+        "        atom:supports <http://lv2plug.in/ns/ext/midi#MidiEvent> ,\n"
+        "            patch:Message ;\n"
         "        lv2:designation lv2:control ;\n"
         "        lv2:index 0 ;\n"
         "        lv2:symbol \"events\" ;\n"
@@ -218,7 +835,7 @@ int main(int argc, char** argv) {
         "        lv2:minimum 0.0 ;\n"
         "        lv2:maximum 2.0 ;\n"
         "    ] , [\n",
-        PLUGIN_NAME
+        plugin_name
     );
 
     // Add Program Control Port definition
@@ -227,68 +844,119 @@ int main(int argc, char** argv) {
         "        lv2:index 4 ;\n"
         "        lv2:symbol \"program\" ;\n"
         "        lv2:name \"Program\" ;\n"
-        "        lv2:portProperty lv2:enumeration, lv2:integer ;\n"
+        "        lv2:portProperty %s ;\n"
         "        lv2:default 0 ;\n"
         "        lv2:minimum 0 ;\n"
-        "        lv2:maximum %d ;\n"
-        "        lv2:scalePoint [\n",
+        "        lv2:maximum %d ;\n",
+        options->layout == LAYOUT_INLINE ? "lv2:enumeration, lv2:integer" : "lv2:integer",
         total_presets - 1
     );
 
     // Allocate memory for preset mappings
     struct PresetMapping* preset_mappings = malloc(total_presets * sizeof(struct PresetMapping));
     if (!preset_mappings) {
-        fprintf(stderr, "Failed to allocate preset mapping memory\n");
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return 1;
+        fprintf(log, "Failed to allocate preset mapping memory\n");
+        fclose(ttl);
+        free(presets);
+        return -1;
+    }
+
+    // Predict what each preset costs to play, from the SoundFont the plugin ships
+    int64_t sample_data_bytes = 0;
+    SF2PresetStats* stats = analyze_presets(source_path, presets, total_presets, &sample_data_bytes, log);
+
+    // Measure what each preset costs to render, if requested
+    PresetProfile* profiles = NULL;
+    if (options->profile) {
+        if (profile_presets(source_path, presets, total_presets, output_dir, plugin_name,
+                            options, &profiles, log) != 0) {
+            fclose(ttl);
+            free(stats);
+            free(preset_mappings);
+            free(presets);
+            return -1;
+        }
     }
 
     // Store all preset mappings
     int mapping_index = 0;
-    fprintf(stderr, "\nAvailable presets:\n");
-    for (bank = 0; bank <= 128; bank++) {
-        for (prog = 0; prog < 128; prog++) {
-            preset = fluid_sfont_get_preset(sfont, bank, prog);
-            if (preset != NULL) {
-                preset_mappings[mapping_index].bank = bank;
-                preset_mappings[mapping_index].prog = prog;
-                preset_mappings[mapping_index].name = fluid_preset_get_name(preset);
-                // Print first column with Isla Instruments colors
-                fprintf(stderr, "  \033[1;37m%3d\033[0m: [\033[1;31m%3d,%3d\033[0m] \033[0;37m%-24s\033[0m", 
-                        mapping_index, bank, prog, preset_mappings[mapping_index].name);
-                // If this is an even-numbered preset and not the last one, print a separator
-                if (mapping_index % 2 == 0) {
-                    fprintf(stderr, "\033[1;30m|\033[0m ");
-                } else {
-                    fprintf(stderr, "\n");
+    int detailed = stats || profiles;
+    fprintf(log, "\nAvailable presets:\n");
+    if (detailed) {
+        fprintf(log, "  \033[1;30m%-39s", "");
+        if (stats) fprintf(log, " %10s %9s %5s", "samples", "zones", "loop");
+        if (profiles) fprintf(log, " %8s %6s", "ns/smp", "voices");
+        fprintf(log, "\033[0m\n");
+    }
+    for (int i = 0; i < total_presets; i++) {
+        int bank = presets[i].bank;
+        int prog = presets[i].prog;
+        preset_mappings[mapping_index].bank = bank;
+        preset_mappings[mapping_index].prog = prog;
+        preset_mappings[mapping_index].name = presets[i].name;
+        // Print first column with Isla Instruments colors
+        fprintf(log, "  \033[1;37m%3d\033[0m: [\033[1;31m%3d,%3d\033[0m] \033[0;37m%-24s\033[0m", 
+                mapping_index, bank, prog, preset_mappings[mapping_index].name);
+        if (detailed) {
+            // One preset per line with its predicted sample memory, zones per note (max/avg),
+            // looping share, and measured render cost
+            if (stats) {
+                char size[32];
+                const SF2PresetStats* preset = &stats[i];
+                fprintf(log, " %10s %3d/%5.2f %4d%%",
+                        format_bytes(preset->sample_bytes, size, sizeof(size)), preset->max_zones, preset->avg_zones,
+                        preset->zone_count > 0 ? preset->looping_zones * 100 / preset->zone_count : 0);
+            }
+            if (profiles) {
+                fprintf(log, " %8.1f %6d", profiles[i].ns_per_sample, profiles[i].peak_voices);
+                if (profiles[i].late_blocks > 0) {
+                    fprintf(log, " \033[1;31mLATE (%d blocks)\033[0m", profiles[i].late_blocks);
                 }
-                mapping_index++;
             }
+            fprintf(log, "\n");
+        } else if (mapping_index % 2 == 0) {
+            // If this is an even-numbered preset and not the last one, print a separator
+            fprintf(log, "\033[1;30m|\033[0m ");
+        } else {
+            fprintf(log, "\n");
         }
+        mapping_index++;
     }
     // Add a newline if we ended on an even-numbered preset
-    if ((mapping_index - 1) % 2 == 0) {
-        fprintf(stderr, "\n");
+    if (!detailed && (mapping_index - 1) % 2 == 0) {
+        fprintf(log, "\n");
     }
-    fprintf(stderr, "\n");
+    fprintf(log, "\n");
 
-    // Write preset information to TTL
-    for (int i = 0; i < total_presets; i++) {
-        fprintf(ttl,
-            "            rdfs:label \"%s\" ;\n"
-            "            rdf:value %d\n",
-            preset_mappings[i].name, i
-        );
+    // Write preset information to TTL, either inline as scale points or as preset files
+    if (options->layout == LAYOUT_INLINE) {
+        fprintf(ttl, "        lv2:scalePoint [\n");
+        for (int i = 0; i < total_presets; i++) {
+            fprintf(ttl, "            rdfs:label ");
+            write_ttl_string(ttl, preset_mappings[i].name);
+            fprintf(ttl,
+                " ;\n"
+                "            rdf:value %d ;\n",
+                i
+            );
+            write_preset_annotations(ttl, stats ? &stats[i] : NULL, profiles ? &profiles[i] : NULL, "            ");
 
-        if (i < total_presets - 1) {
-            fprintf(ttl, "        ] , [\n");
+            if (i < total_presets - 1) {
+                fprintf(ttl, "        ] , [\n");
+            }
         }
+        fprintf(ttl, "        ]\n");
+    } else if (write_preset_files(output_dir, plugin_name, presets, stats, profiles, total_presets, log) != 0) {
+        fclose(ttl);
+        free(stats);
+        free(profiles);
+        free(preset_mappings);
+        free(presets);
+        return -1;
     }
 
     // Add control ports
     fprintf(ttl,
-        "        ]\n"
         "    ] , [\n"
         "        a lv2:InputPort, lv2:ControlPort ;\n"
         "        lv2:index 5 ;\n"
@@ -343,45 +1011,628 @@ int main(int argc, char** argv) {
         "        lv2:minimum 0.0 ;\n"
         "        lv2:maximum 1.0 ;\n"
         "        rdfs:comment \"Maps to MIDI CC 72 (Release Time)\" ;\n"
+        "    ] , [\n"
+        "        a lv2:InputPort, lv2:ControlPort ;\n"
+        "        lv2:index 11 ;\n"
+        "        lv2:symbol \"report\" ;\n"
+        "        lv2:name \"Report\" ;\n"
+        "        lv2:portProperty lv2:toggled, pprops:trigger ;\n"
+        "        lv2:default 0 ;\n"
+        "        lv2:minimum 0 ;\n"
+        "        lv2:maximum 1 ;\n"
+        "        rdfs:comment \"Writes the instance's reports to the host's log\" ;\n"
+        "    ] , [\n"
+        "        a lv2:OutputPort, lv2:ControlPort ;\n"
+        "        lv2:index 12 ;\n"
+        "        lv2:symbol \"memory\" ;\n"
+        "        lv2:name \"Memory\" ;\n"
+        "        units:unit units:mb ;\n"
+        "        lv2:minimum 0.0 ;\n"
+        "        lv2:maximum 1024.0 ;\n"
+        "        rdfs:comment \"Memory held by this instance\" ;\n"
         "    ] ;\n"
     );
 
+    // Add load meters, updated by every run()
+    fprintf(ttl,
+        "    lv2:port [\n"
+        "        a lv2:OutputPort, lv2:ControlPort ;\n"
+        "        lv2:index 13 ;\n"
+        "        lv2:symbol \"load\" ;\n"
+        "        lv2:name \"DSP Load\" ;\n"
+        "        units:unit units:pc ;\n"
+        "        lv2:minimum 0.0 ;\n"
+        "        lv2:maximum 100.0 ;\n"
+        "        rdfs:comment \"Time run() takes as a share of the block duration, smoothed\" ;\n"
+        "    ] , [\n"
+        "        a lv2:OutputPort, lv2:ControlPort ;\n"
+        "        lv2:index 14 ;\n"
+        "        lv2:symbol \"voices\" ;\n"
+        "        lv2:name \"Voices\" ;\n"
+        "        lv2:portProperty lv2:integer ;\n"
+        "        lv2:minimum 0 ;\n"
+        "        lv2:maximum %d ;\n"
+        "        rdfs:comment \"Voices sounding at the end of the block\" ;\n"
+        "    ] , [\n"
+        "        a lv2:OutputPort, lv2:ControlPort ;\n"
+        "        lv2:index 15 ;\n"
+        "        lv2:symbol \"peak_voices\" ;\n"
+        "        lv2:name \"Peak Voices\" ;\n"
+        "        lv2:portProperty lv2:integer ;\n"
+        "        lv2:minimum 0 ;\n"
+        "        lv2:maximum %d ;\n"
+        "        rdfs:comment \"Most voices sounding at once since the plugin was activated\" ;\n"
+        "    ] , [\n"
+        "        a lv2:OutputPort, lv2:ControlPort ;\n"
+        "        lv2:index 16 ;\n"
+        "        lv2:symbol \"full_polyphony_notes\" ;\n"
+        "        lv2:name \"Notes At Full Polyphony\" ;\n"
+        "        lv2:portProperty lv2:integer ;\n"
+        "        lv2:minimum 0 ;\n"
+        "        rdfs:comment \"Counts note-ons, not stolen voices: note-ons since the plugin was activated "
+        "that found every voice in use and left the voice count there. A note that ends several voices, "
+        "such as a layered note, counts once. Only grows until the next activation, so it has no maximum\" ;\n"
+        "    ] ;\n",
+        SYNTH_POLYPHONY, SYNTH_POLYPHONY
+    );
+
     // Write plugin metadata
+    fprintf(ttl, "    doap:name ");
+    write_ttl_string(ttl, plugin_name);
     fprintf(ttl,
-        "    doap:name \"%s\" ;\n"
+        " ;\n"
         "    doap:license \"MIT\" ;\n"
         "    doap:maintainer [\n"
         "        foaf:name \"Isla Instruments\" ;\n"
         "        foaf:homepage <https://www.islainstruments.com> ;\n"
         "    ] ;\n"
+    );
+
+    // Whole plugin budget: all sample data is resident, and any preset may be selected
+    if (stats) {
+        int max_zones = 0;
+        for (int i = 0; i < total_presets; i++) {
+            if (stats[i].max_zones > max_zones) max_zones = stats[i].max_zones;
+        }
+        fprintf(ttl,
+            "    sf2lv2:sampleBytes %lld ;\n"
+            "    sf2lv2:maxZonesPerNote %d ;\n",
+            (long long)sample_data_bytes, max_zones
+        );
+        free(stats);
+    }
+    free(profiles);
+
+    fprintf(ttl,
         "    rdfs:comment \"This plugin wraps the %s soundfont as an LV2 instrument.\\nBuilt using FluidSynth as the synthesizer engine.\" ;\n"
         "    lv2:minorVersion 2 ;\n"
         "    lv2:microVersion 0 .\n",
-        PLUGIN_NAME, display_name
+        display_name
+    );
+
+    // The SoundFont the plugin plays can be replaced with patch:Set
+    fprintf(ttl,
+        "\n"
+        "sf2lv2:soundfont\n"
+        "    a lv2:Parameter ;\n"
+        "    rdfs:label \"SoundFont\" ;\n"
+        "    rdfs:range atom:Path .\n"
     );
 
     fclose(ttl);
 
-    // Write manifest.ttl
-    FILE* manifest = fopen(manifest_path, "w");
-    if (manifest) {
-        fprintf(manifest,
-            "@prefix lv2: <http://lv2plug.in/ns/lv2core#> .\n"
-            "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n\n"
-            "<https://github.com/islainstruments/sf2lv2/%s>\n"
-            "    a lv2:Plugin ;\n"
-            "    lv2:binary <%s.so> ;\n"
-            "    rdfs:seeAlso <%s.ttl> .\n",
-            PLUGIN_NAME, PLUGIN_NAME, PLUGIN_NAME
-        );
-        fclose(manifest);
+    // Reference the SoundFont from the shared store next to the plugin binary
+    char sf2_dest[4096], object_path[4096], store[4096];
+    StoreMethod method;
+    store_dir(store, sizeof(store), options);
+    if (snprintf(sf2_dest, sizeof(sf2_dest), "%s/%s", output_dir, sf2_basename(sf2_path)) >= (int)sizeof(sf2_dest) ||
+        store_add(store, source_path, source_hash, object_path, sizeof(object_path), log) != 0 ||
+        store_place(object_path, sf2_dest, &method, log) != 0) {
+        fprintf(log, "Failed to place SoundFont into bundle\n");
+        free(preset_mappings);
+        free(presets);
+        return -1;
+    }
+
+    fprintf(log, "SoundFont placed from store (%s): %s\n", store_method_name(method), object_path);
+
+    // The bank gives the plugin the preset table without probing, and the lazy read-ahead its zones
+    if (options->bank &&
+        write_bundle_bank(source_path, presets, total_presets, output_dir, plugin_name, options, log) != 0) {
+        free(preset_mappings);
+        free(presets);
+        return -1;
+    }
+
+    // A plugin in its own bundle gets its own manifest, configuration and binary;
+    // for a combined bundle these are written once all plugins are done
+    if (!options->combined_name) {
+        BundlePlugin plugin = { plugin_name, sf2_basename(sf2_path), sf2_path, total_presets };
+        if (write_bundle_index(output_dir, plugin_name, &plugin, 1, options, log) != 0) {
+            free(preset_mappings);
+            free(presets);
+            return -1;
+        }
     }
 
     // Cleanup
-    delete_fluid_synth(synth);
-    delete_fluid_settings(settings);
     free(preset_mappings);
+    free(presets);
+
+    fprintf(log, "Successfully generated plugin in %s\n", output_dir);
+    return total_presets;
+}
+
+/* Path of a plugin's cache record; a combined bundle keeps one per plugin */
+static int cache_record_path(char* path, size_t size, const char* output_dir,
+                             const char* plugin_name, const GeneratorOptions* options) {
+    int length = options->combined_name
+        ? snprintf(path, size, "%s/%s.%s", output_dir, CACHE_RECORD_NAME, plugin_name)
+        : snprintf(path, size, "%s/%s", output_dir, CACHE_RECORD_NAME);
+    return length < (int)size ? 0 : -1;
+}
+
+/* Check that a file exists inside the bundle */
+static int bundle_has_file(const char* output_dir, const char* name, const char* suffix) {
+    char path[4096];
+    struct stat st;
+    if (snprintf(path, sizeof(path), "%s/%s%s", output_dir, name, suffix) >= (int)sizeof(path)) {
+        return 0;
+    }
+    return stat(path, &st) == 0;
+}
+
+/*
+ * Generate a bundle unless its cache record shows that none of its inputs
+ * changed. The SoundFont is only re-hashed when its size or modification
+ * time differ from the ones stored with the previous hash.
+ * Returns the number of presets in the bundle, or -1 on failure.
+ */
+static int generate_bundle(const char* sf2_path, const char* plugin_name,
+                           const GeneratorOptions* options, int* reused, FILE* log) {
+    *reused = 0;
+
+    char output_dir[4096], record_path[4096];
+    bundle_dir(output_dir, sizeof(output_dir), plugin_name, options);
+    if (cache_record_path(record_path, sizeof(record_path), output_dir, plugin_name, options) != 0) {
+        fprintf(log, "Path too long for cache record\n");
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(sf2_path, &st) != 0) {
+        log_errno(log, "Failed to open SoundFont", NULL);
+        return -1;
+    }
+
+    CacheRecord previous;
+    cache_record_read(record_path, &previous);
 
-    fprintf(stderr, "Successfully generated plugin in %s\n", output_dir);
+    // Hash the SoundFont, reusing the stored hash for an untouched file
+    CacheRecord record;
+    memset(&record, 0, sizeof(record));
+    record.valid = 1;
+    record.sf2_size = (long long)st.st_size;
+    record.sf2_mtime_s = (long long)st.st_mtim.tv_sec;
+    record.sf2_mtime_ns = st.st_mtim.tv_nsec;
+    if (previous.valid &&
+        previous.sf2_size == record.sf2_size &&
+        previous.sf2_mtime_s == record.sf2_mtime_s &&
+        previous.sf2_mtime_ns == record.sf2_mtime_ns) {
+        record.sf2_hash = previous.sf2_hash;
+    } else if (content_hash_file(sf2_path, &record.sf2_hash) != 0) {
+        log_errno(log, "Failed to hash SoundFont", NULL);
+        return -1;
+    }
+
+    // The bundle key covers the SoundFont, the build inputs and the bundle name
+    BundleKeyInputs inputs;
+    memset(&inputs, 0, sizeof(inputs));
+    inputs.sf2_hash = record.sf2_hash;
+    inputs.inputs_hash = options->inputs_hash;
+    inputs.binary_hash = options->binary_hash;
+    inputs.layout = (int)options->layout;
+    inputs.bank = options->bank;
+    inputs.lazy_samples = options->lazy_samples;
+    inputs.watch_soundfont = options->watch_soundfont;
+    char* source = options->watch_soundfont ? realpath(sf2_path, NULL) : NULL;
+    inputs.watch_source = source;
+    inputs.deadline = options->deadline;
+    inputs.recordings_dir = options->recordings_dir;
+    inputs.preset_filter = options->preset_filter;
+    inputs.reduce = options->reduce;
+    inputs.profile = options->profile;
+    inputs.profile_scale = options->profile_scale;
+    inputs.plugin_name = plugin_name;
+    record.key = bundle_cache_key(&inputs);
+    free(source);
+
+    if (!options->force && previous.valid && previous.key == record.key &&
+        bundle_has_file(output_dir, plugin_name, ".ttl") &&
+        bundle_has_file(output_dir, sf2_basename(sf2_path), "") &&
+        (options->layout != LAYOUT_PRESETS || bundle_has_file(output_dir, plugin_name, ".presets")) &&
+        (!options->bank || bundle_has_file(output_dir, plugin_name, SF2_BANK_EXT)) &&
+        (!options->profile || bundle_has_file(output_dir, plugin_name, ".profile.tsv")) &&
+        (options->combined_name ||
+         (bundle_has_file(output_dir, "manifest", ".ttl") &&
+          bundle_has_file(output_dir, BUNDLE_CONFIG_FILE, "") &&
+          (!options->binary_path || bundle_has_file(output_dir, plugin_name, ".so"))))) {
+        fprintf(log, "Inputs unchanged, reusing %s\n", output_dir);
+        *reused = 1;
+        return previous.preset_count;
+    }
+
+    record.preset_count = write_bundle(sf2_path, record.sf2_hash, plugin_name, options, log);
+    if (record.preset_count < 0) {
+        return -1;
+    }
+
+    cache_record_write(record_path, &record, log);
+    return record.preset_count;
+}
+
+/*
+ * Hash the build inputs shared by every bundle: the contents of the given
+ * source files and the build flags string.
+ * Returns 0 on success, -1 if a source file cannot be read.
+ */
+static int hash_build_inputs(char** depends, int depend_count, const char* flags, uint64_t* hash_out) {
+    ContentHash hash;
+    content_hash_init(&hash);
+
+    for (int i = 0; i < depend_count; i++) {
+        uint64_t file_hash;
+        if (content_hash_file(depends[i], &file_hash) != 0) {
+            fprintf(stderr, "Failed to hash build input: %s\n", depends[i]);
+            return -1;
+        }
+        content_hash_update(&hash, depends[i], strlen(depends[i]) + 1);
+        content_hash_update(&hash, &file_hash, sizeof(file_hash));
+    }
+    content_hash_update(&hash, flags, strlen(flags) + 1);
+
+    *hash_out = content_hash_final(&hash);
     return 0;
 }
+
+/* One SoundFont queued for batch conversion */
+typedef struct {
+    const char* sf2_path;   // Source SoundFont path from the command line
+    char plugin_name[256];  // Bundle name (file name without .sf2)
+    int preset_count;       // Presets written, -1 if the job failed
+    int reused;             // Non-zero if the existing bundle was up to date
+    double elapsed_ms;      // Wall clock time spent on this job
+} BatchJob;
+
+/* Shared state for the batch worker threads */
+typedef struct {
+    const GeneratorOptions* options;  // Options shared by all jobs
+    BatchJob* jobs;             // All queued jobs
+    int job_count;              // Number of queued jobs
+    int next_job;               // Index of the next job to hand out
+    pthread_mutex_t lock;       // Guards next_job and serializes log output
+} BatchQueue;
+
+/* Current monotonic time in milliseconds */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/*
+ * Batch worker thread.
+ * Each worker takes the next unprocessed SoundFont from the queue, generates
+ * its bundle into a private log buffer and prints the log in one piece.
+ * Memory use is bounded by the number of workers since each one only holds
+ * a single SoundFont's preset table at a time.
+ */
+static void* batch_worker(void* arg) {
+    BatchQueue* queue = (BatchQueue*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        int index = queue->next_job++;
+        pthread_mutex_unlock(&queue->lock);
+        if (index >= queue->job_count) {
+            break;
+        }
+
+        BatchJob* job = &queue->jobs[index];
+        char* log_buffer = NULL;
+        size_t log_size = 0;
+        FILE* log = open_memstream(&log_buffer, &log_size);
+
+        double start = now_ms();
+        job->preset_count = generate_bundle(job->sf2_path, job->plugin_name, queue->options,
+                                            &job->reused, log ? log : stderr);
+        job->elapsed_ms = now_ms() - start;
+
+        // Print the whole job log at once so tables from different jobs do not mix
+        pthread_mutex_lock(&queue->lock);
+        if (log) {
+            fclose(log);
+            fprintf(stderr, "\033[1;34mProcessing: %s -> %s\033[0m\n%s",
+                    job->sf2_path, job->plugin_name, log_buffer);
+            free(log_buffer);
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Convert many SoundFonts concurrently on a pool of worker threads.
+ * Plugin names are derived from the SoundFont file names, matching the
+ * makefile's batch naming; SoundFonts from different directories with the
+ * same file name are rejected before any job starts.
+ * Returns 0 if every job succeeded.
+ */
+static int run_batch(char** sf2_paths, int count, int thread_count, const GeneratorOptions* options) {
+    BatchQueue queue;
+    queue.options = options;
+    queue.jobs = (BatchJob*)calloc(count, sizeof(BatchJob));
+    if (!queue.jobs) {
+        fprintf(stderr, "Failed to allocate batch job table\n");
+        return 1;
+    }
+    queue.job_count = count;
+    queue.next_job = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    // Derive each plugin name from its file name without the extension
+    for (int i = 0; i < count; i++) {
+        BatchJob* job = &queue.jobs[i];
+        job->sf2_path = sf2_paths[i];
+        strncpy(job->plugin_name, sf2_basename(sf2_paths[i]), sizeof(job->plugin_name) - 1);
+        char* ext = strrchr(job->plugin_name, '.');
+        if (ext && !strcmp(ext, ".sf2")) *ext = '\0';
+    }
+
+    // Jobs with the same name would write the same bundle and cache record at once
+    int duplicates = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < i; j++) {
+            if (!strcmp(queue.jobs[i].plugin_name, queue.jobs[j].plugin_name)) {
+                fprintf(stderr, "Duplicate plugin name %s: '%s' and '%s'\n",
+                        queue.jobs[i].plugin_name, queue.jobs[j].sf2_path, queue.jobs[i].sf2_path);
+                duplicates++;
+                break;
+            }
+        }
+    }
+    if (duplicates > 0) {
+        fprintf(stderr, "Rename the SoundFonts so that every plugin gets its own bundle\n");
+        pthread_mutex_destroy(&queue.lock);
+        free(queue.jobs);
+        return 1;
+    }
+
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > count) thread_count = count;
+    fprintf(stderr, "Converting %d SoundFonts on %d threads\n", count, thread_count);
+
+    // Start the worker pool; the calling thread works too if a thread fails to start
+    pthread_t* threads = (pthread_t*)calloc(thread_count, sizeof(pthread_t));
+    int started = 0;
+    double start = now_ms();
+    for (int i = 0; threads && i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, batch_worker, &queue) != 0) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        batch_worker(&queue);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double total_ms = now_ms() - start;
+
+    // Per-file timing report
+    int failed = 0;
+    int reused = 0;
+    double busy_ms = 0.0;
+    fprintf(stderr, "\n\033[1;34m=== Batch summary ===\033[0m\n");
+    for (int i = 0; i < count; i++) {
+        BatchJob* job = &queue.jobs[i];
+        busy_ms += job->elapsed_ms;
+        if (job->preset_count < 0) {
+            failed++;
+            fprintf(stderr, "  \033[1;31mFAILED\033[0m %-32s %8.1f ms\n", job->plugin_name, job->elapsed_ms);
+        } else if (job->reused) {
+            reused++;
+            fprintf(stderr, "  \033[1;37mcached\033[0m %-32s %8.1f ms  (%d presets)\n",
+                    job->plugin_name, job->elapsed_ms, job->preset_count);
+        } else {
+            fprintf(stderr, "  \033[1;32mok\033[0m     %-32s %8.1f ms  (%d presets)\n",
+                    job->plugin_name, job->elapsed_ms, job->preset_count);
+        }
+    }
+    fprintf(stderr, "%d rebuilt, %d reused, %d failed in %.1f ms (%.1f ms of work on %d threads)\n",
+            count - failed - reused, reused, failed, total_ms, busy_ms, started > 0 ? started : 1);
+
+    // A combined bundle gets one manifest, configuration and binary for all plugins
+    if (options->combined_name) {
+        BundlePlugin* plugins = (BundlePlugin*)calloc(count, sizeof(BundlePlugin));
+        int plugin_count = 0;
+        for (int i = 0; plugins && i < count; i++) {
+            if (queue.jobs[i].preset_count >= 0) {
+                plugins[plugin_count].plugin_name = queue.jobs[i].plugin_name;
+                plugins[plugin_count].sf2_file = sf2_basename(queue.jobs[i].sf2_path);
+                plugins[plugin_count].source_path = queue.jobs[i].sf2_path;
+                plugins[plugin_count].preset_count = queue.jobs[i].preset_count;
+                plugin_count++;
+            }
+        }
+
+        char output_dir[4096];
+        bundle_dir(output_dir, sizeof(output_dir), NULL, options);
+        if (!plugins || plugin_count == 0 ||
+            write_bundle_index(output_dir, options->combined_name, plugins, plugin_count, options, stderr) != 0) {
+            fprintf(stderr, "Failed to write combined bundle %s\n", output_dir);
+            failed++;
+        } else {
+            fprintf(stderr, "Combined bundle %s serves %d plugins from one binary\n", output_dir, plugin_count);
+        }
+        free(plugins);
+    }
+
+    pthread_mutex_destroy(&queue.lock);
+    free(threads);
+    free(queue.jobs);
+    return failed ? 1 : 0;
+}
+
+/* Print command line usage */
+static void print_usage(const char* program) {
+    printf("Usage: %s [options] <soundfont.sf2>\n"
+           "       %s --batch [-j threads] [options] <soundfont.sf2>...\n"
+           "Options:\n"
+           "  --binary <file>   Generic plugin binary to link into every bundle\n"
+           "  --combined <name> Batch mode: put every plugin into one bundle named <name>\n"
+           "  --layout <inline|presets>\n"
+           "                    Describe presets as Program scale points (default) or as\n"
+           "                    LV2 preset files loaded only when the plugin is opened\n"
+           "  --output <dir>    Directory for bundles and the store (default: build)\n"
+           "  --bank            Also write the preset and zone tables of the SoundFont, which\n"
+           "                    the plugin reads instead of probing every preset; with\n"
+           "                    --lazy-samples a restored state also reads ahead its zones\n"
+           "  --lazy-samples    Plugins load samples only for presets in use, preloading the\n"
+           "                    presets their saved state lists; without it every sample is\n"
+           "                    loaded with the SoundFont and nothing is preloaded\n"
+           "  --watch           Plugins reload their SoundFont when the file is saved\n"
+           "  --deadline <f>    Plugins count run() calls longer than this fraction of the\n"
+           "                    block duration as deadline misses (default 1)\n"
+           "  --recordings <dir>\n"
+           "                    Plugins write the cycles around each deadline miss to CSV\n"
+           "                    files in <dir>\n"
+           "  --presets <filter>\n"
+           "                    Only keep matching presets and the samples they use; the filter\n"
+           "                    is a comma separated list of <bank>:<prog> items (numbers,\n"
+           "                    ranges a-b or *) and preset name patterns, e.g. \"0:0-7,*Pad*\"\n"
+           "  --trim-loops      Drop sample data after the loop of samples that always loop\n"
+           "  --drop-sm24       Ship 16 bit sample data only\n"
+           "  --rate <hz>       Resample samples above this rate (lossy)\n"
+           "  --dedup           Store samples with identical data once\n"
+           "  --dedup-report    Only report the sample data the given SoundFonts share\n"
+           "  --profile         Time a stress pattern through every preset; results go to\n"
+           "                    <plugin>.profile.tsv and the plugin metadata\n"
+           "  --profile-scale <factor>\n"
+           "                    How many times slower the target renders than this machine\n"
+           "  --depend <file>   Include a source file in the bundle cache key (repeatable)\n"
+           "  --flags <string>  Include build flags in the bundle cache key\n"
+           "  --force           Rebuild bundles even if their inputs are unchanged\n",
+           program, program);
+}
+
+int main(int argc, char** argv) {
+    fprintf(stderr, "Starting SF2LV2 generator...\n");
+
+    GeneratorOptions options;
+    memset(&options, 0, sizeof(options));
+    options.output_root = "build";
+    options.layout = LAYOUT_INLINE;
+    options.profile_scale = 1.0;
+    int batch = 0;
+    int dedup_report = 0;
+    int thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char* flags = "";
+    char** depends = (char**)calloc(argc, sizeof(char*));
+    int depend_count = 0;
+
+    // Parse options; everything after them is a SoundFont path
+    int first = 1;
+    while (first < argc && !strncmp(argv[first], "-", 1)) {
+        if (!strcmp(argv[first], "--batch")) {
+            batch = 1;
+        } else if (!strcmp(argv[first], "--force")) {
+            options.force = 1;
+        } else if (!strcmp(argv[first], "-j") && first + 1 < argc) {
+            thread_count = atoi(argv[++first]);
+        } else if (!strcmp(argv[first], "--depend") && first + 1 < argc && depends) {
+            depends[depend_count++] = argv[++first];
+        } else if (!strcmp(argv[first], "--layout") && first + 1 < argc) {
+            first++;
+            if (!strcmp(argv[first], "presets")) {
+                options.layout = LAYOUT_PRESETS;
+            } else if (strcmp(argv[first], "inline") != 0) {
+                print_usage(argv[0]);
+                free(depends);
+                return 1;
+            }
+        } else if (!strcmp(argv[first], "--presets") && first + 1 < argc) {
+            options.preset_filter = argv[++first];
+        } else if (!strcmp(argv[first], "--bank")) {
+            options.bank = 1;
+        } else if (!strcmp(argv[first], "--lazy-samples")) {
+            options.lazy_samples = 1;
+        } else if (!strcmp(argv[first], "--watch")) {
+            options.watch_soundfont = 1;
+        } else if (!strcmp(argv[first], "--deadline") && first + 1 < argc && atof(argv[first + 1]) > 0) {
+            options.deadline = atof(argv[++first]);
+        } else if (!strcmp(argv[first], "--recordings") && first + 1 < argc) {
+            options.recordings_dir = argv[++first];
+        } else if (!strcmp(argv[first], "--profile")) {
+            options.profile = 1;
+        } else if (!strcmp(argv[first], "--profile-scale") && first + 1 < argc && atof(argv[first + 1]) > 0) {
+            options.profile_scale = atof(argv[++first]);
+        } else if (!strcmp(argv[first], "--trim-loops")) {
+            options.reduce.trim_loop_tails = 1;
+        } else if (!strcmp(argv[first], "--drop-sm24")) {
+            options.reduce.drop_sm24 = 1;
+        } else if (!strcmp(argv[first], "--rate") && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            options.reduce.target_rate = (uint32_t)atoi(argv[++first]);
+        } else if (!strcmp(argv[first], "--dedup")) {
+            options.reduce.dedup_samples = 1;
+        } else if (!strcmp(argv[first], "--dedup-report")) {
+            dedup_report = 1;
+        } else if (!strcmp(argv[first], "--output") && first + 1 < argc) {
+            options.output_root = argv[++first];
+        } else if (!strcmp(argv[first], "--combined") && first + 1 < argc) {
+            options.combined_name = argv[++first];
+        } else if (!strcmp(argv[first], "--binary") && first + 1 < argc) {
+            options.binary_path = argv[++first];
+        } else if (!strcmp(argv[first], "--flags") && first + 1 < argc) {
+            flags = argv[++first];
+        } else {
+            print_usage(argv[0]);
+            free(depends);
+            return 1;
+        }
+        first++;
+    }
+
+    // The report reads the SoundFonts only and builds nothing
+    if (dedup_report && first < argc) {
+        free(depends);
+        return sf2_dedup_report(argv + first, argc - first, stdout) == 0 ? 0 : 1;
+    }
+
+    // Check command line arguments
+    if (first >= argc || (!batch && argc - first != 1) || (!batch && options.combined_name)) {
+        print_usage(argv[0]);
+        free(depends);
+        return 1;
+    }
+
+    int result = hash_build_inputs(depends, depend_count, flags, &options.inputs_hash);
+    free(depends);
+    if (result != 0) {
+        return 1;
+    }
+    if (options.binary_path && content_hash_file(options.binary_path, &options.binary_hash) != 0) {
+        fprintf(stderr, "Failed to read plugin binary: %s\n", options.binary_path);
+        return 1;
+    }
+
+    // Batch mode: every remaining argument is a SoundFont to convert
+    if (batch) {
+        return run_batch(argv + first, argc - first, thread_count, &options);
+    }
+
+    int reused;
+    return generate_bundle(argv[first], PLUGIN_NAME, &options, &reused, stderr) < 0 ? 1 : 0;
+}
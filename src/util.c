@@ -0,0 +1,48 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Shared Helpers (util.c)
+ */
+
+#include "util.h"
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char* format_bytes(int64_t bytes, char* text, size_t size) {
+    static const char* units[] = { "B", "KB", "MB", "GB" };
+    double value = (double)bytes;
+    int unit = 0;
+    while ((value >= 1024.0 || value <= -1024.0) && unit < 3) {
+        value /= 1024.0;
+        unit++;
+    }
+    snprintf(text, size, unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return text;
+}
+
+void log_errno(FILE* log, const char* message, const char* path) {
+    if (path) {
+        fprintf(log, "%s '%s': %s\n", message, path, strerror(errno));
+    } else {
+        fprintf(log, "%s: %s\n", message, strerror(errno));
+    }
+}
+
+void* map_file(const char* path, size_t* size_out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return MAP_FAILED;
+    }
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        *size_out = (size_t)st.st_size;
+        map = mmap(NULL, *size_out, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    return map;
+}
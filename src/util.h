@@ -0,0 +1,34 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Shared Helpers (util.h)
+ *
+ * Report formatting and file mapping used by the generator, the plugin and
+ * sf2lv2_top.
+ */
+
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Format a byte count with a binary unit (B, KB, MB or GB) into text.
+ * Returns text.
+ */
+const char* format_bytes(int64_t bytes, char* text, size_t size);
+
+/*
+ * Like perror(), but writes to the given log stream: the message, the path
+ * in quotes if it is not NULL, and the description of errno.
+ */
+void log_errno(FILE* log, const char* message, const char* path);
+
+/*
+ * Map a whole file read-only and store its size in size_out.
+ * Returns MAP_FAILED on failure, including for an empty file.
+ */
+void* map_file(const char* path, size_t* size_out);
+
+#endif
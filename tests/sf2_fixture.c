@@ -0,0 +1,250 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Test SoundFont (sf2_fixture.c)
+ *
+ * Builds the RIFF structure of the test SoundFont in memory, chunk by
+ * chunk, and writes it out in one go.
+ */
+
+#include "sf2_fixture.h"
+#include "sf2_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Large enough for the whole file
+#define FIXTURE_SIZE 4096
+
+/* A file being built */
+typedef struct {
+    uint8_t data[FIXTURE_SIZE];
+    size_t size;
+} Builder;
+
+static void put_bytes(Builder* b, const void* data, size_t size) {
+    if (b->size + size <= sizeof(b->data)) {
+        memcpy(b->data + b->size, data, size);
+    }
+    b->size += size;
+}
+
+static void put_u8(Builder* b, uint8_t value) {
+    put_bytes(b, &value, 1);
+}
+
+static void put_u16(Builder* b, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    put_bytes(b, bytes, 2);
+}
+
+static void put_u32(Builder* b, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    put_bytes(b, bytes, 4);
+}
+
+/* A zero padded 20 byte name */
+static void put_name(Builder* b, const char* name) {
+    char field[SF2_NAME_LEN] = {0};
+    memcpy(field, name, strnlen(name, sizeof(field)));
+    put_bytes(b, field, sizeof(field));
+}
+
+/* Start a chunk or list; returns the offset of its size field */
+static size_t open_chunk(Builder* b, const char* id, const char* type) {
+    put_bytes(b, id, 4);
+    size_t size_offset = b->size;
+    put_u32(b, 0);
+    if (type) {
+        put_bytes(b, type, 4);
+    }
+    return size_offset;
+}
+
+/* Fill in the size of a chunk started with open_chunk() */
+static void close_chunk(Builder* b, size_t size_offset) {
+    uint32_t size = (uint32_t)(b->size - size_offset - 4);
+    if (size_offset + 4 <= sizeof(b->data)) {
+        b->data[size_offset] = (uint8_t)size;
+        b->data[size_offset + 1] = (uint8_t)(size >> 8);
+        b->data[size_offset + 2] = (uint8_t)(size >> 16);
+        b->data[size_offset + 3] = (uint8_t)(size >> 24);
+    }
+}
+
+static void put_gen(Builder* b, uint16_t oper, uint16_t amount) {
+    put_u16(b, oper);
+    put_u16(b, amount);
+}
+
+static void put_range(Builder* b, uint16_t oper, uint8_t lo, uint8_t hi) {
+    put_u16(b, oper);
+    put_u8(b, lo);
+    put_u8(b, hi);
+}
+
+int16_t fixture_point(int sample, uint32_t point) {
+    // Low and High share their data
+    if (sample == FIXTURE_PIPE) {
+        return (int16_t)(point * 611 % 4000) - 2000;
+    }
+    return (int16_t)(point * 37 % 2000) - 1000;
+}
+
+uint32_t fixture_start(int sample) {
+    static const uint32_t starts[FIXTURE_SAMPLES] = {
+        0,
+        FIXTURE_KEYS_POINTS + SF2_SAMPLE_PADDING,
+        2 * (FIXTURE_KEYS_POINTS + SF2_SAMPLE_PADDING)
+    };
+    return starts[sample];
+}
+
+static uint32_t sample_points(int sample) {
+    return sample == FIXTURE_PIPE ? FIXTURE_PIPE_POINTS : FIXTURE_KEYS_POINTS;
+}
+
+int fixture_write(const char* path) {
+    static Builder b;
+    b.size = 0;
+
+    size_t riff = open_chunk(&b, "RIFF", "sfbk");
+
+    size_t info = open_chunk(&b, "LIST", "INFO");
+    size_t chunk = open_chunk(&b, "ifil", NULL);
+    put_u16(&b, 2);
+    put_u16(&b, 1);
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "isng", NULL);
+    put_bytes(&b, "EMU8000", 8);
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "INAM", NULL);
+    put_bytes(&b, "Fixture", 8);
+    close_chunk(&b, chunk);
+    close_chunk(&b, info);
+
+    size_t sdta = open_chunk(&b, "LIST", "sdta");
+    chunk = open_chunk(&b, "smpl", NULL);
+    for (int s = 0; s < FIXTURE_SAMPLES; s++) {
+        for (uint32_t i = 0; i < sample_points(s); i++) {
+            put_u16(&b, (uint16_t)fixture_point(s, i));
+        }
+        for (int i = 0; i < SF2_SAMPLE_PADDING; i++) {
+            put_u16(&b, 0);
+        }
+    }
+    close_chunk(&b, chunk);
+    close_chunk(&b, sdta);
+
+    size_t pdta = open_chunk(&b, "LIST", "pdta");
+
+    // Presets, one zone each
+    chunk = open_chunk(&b, "phdr", NULL);
+    const char* preset_names[] = { "Piano", "Organ", "EOP" };
+    for (int p = 0; p < 3; p++) {
+        put_name(&b, preset_names[p]);
+        put_u16(&b, (uint16_t)(p < 2 ? p : 0));
+        put_u16(&b, 0);
+        put_u16(&b, (uint16_t)p);
+        put_u32(&b, 0);
+        put_u32(&b, 0);
+        put_u32(&b, 0);
+    }
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "pbag", NULL);
+    for (int z = 0; z < 3; z++) {
+        put_u16(&b, (uint16_t)z);
+        put_u16(&b, 0);
+    }
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "pmod", NULL);
+    put_bytes(&b, (const uint8_t[SF2_MOD_SIZE]){0}, SF2_MOD_SIZE);
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "pgen", NULL);
+    put_gen(&b, SF2_GEN_INSTRUMENT, 0);
+    put_gen(&b, SF2_GEN_INSTRUMENT, 1);
+    put_gen(&b, 0, 0);
+    close_chunk(&b, chunk);
+
+    // Keys: global zone, Low, High; Pipe: one zone
+    chunk = open_chunk(&b, "inst", NULL);
+    put_name(&b, "Keys");
+    put_u16(&b, 0);
+    put_name(&b, "Pipe");
+    put_u16(&b, 3);
+    put_name(&b, "EOI");
+    put_u16(&b, 4);
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "ibag", NULL);
+    static const uint16_t zone_gens[] = { 0, 1, 3, 5, 7 };
+    for (int z = 0; z < 5; z++) {
+        put_u16(&b, zone_gens[z]);
+        put_u16(&b, 0);
+    }
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "imod", NULL);
+    put_bytes(&b, (const uint8_t[SF2_MOD_SIZE]){0}, SF2_MOD_SIZE);
+    close_chunk(&b, chunk);
+    chunk = open_chunk(&b, "igen", NULL);
+    put_gen(&b, SF2_GEN_SAMPLE_MODES, 1);
+    put_range(&b, SF2_GEN_KEY_RANGE, 0, 63);
+    put_gen(&b, SF2_GEN_SAMPLE_ID, FIXTURE_LOW);
+    put_range(&b, SF2_GEN_KEY_RANGE, 64, 127);
+    put_gen(&b, SF2_GEN_SAMPLE_ID, FIXTURE_HIGH);
+    put_gen(&b, SF2_GEN_SAMPLE_MODES, 3);
+    put_gen(&b, SF2_GEN_SAMPLE_ID, FIXTURE_PIPE);
+    put_gen(&b, 0, 0);
+    close_chunk(&b, chunk);
+
+    chunk = open_chunk(&b, "shdr", NULL);
+    const char* sample_names[] = { "Low", "High", "Pipe" };
+    for (int s = 0; s < FIXTURE_SAMPLES; s++) {
+        uint32_t start = fixture_start(s);
+        int pipe = s == FIXTURE_PIPE;
+        put_name(&b, sample_names[s]);
+        put_u32(&b, start);
+        put_u32(&b, start + sample_points(s));
+        put_u32(&b, start + (pipe ? FIXTURE_PIPE_LOOP_START : FIXTURE_KEYS_LOOP_START));
+        put_u32(&b, start + (pipe ? FIXTURE_PIPE_LOOP_END : FIXTURE_KEYS_LOOP_END));
+        put_u32(&b, FIXTURE_RATE);
+        put_u8(&b, 60);
+        put_u8(&b, 0);
+        put_u16(&b, 0);
+        put_u16(&b, 1);
+    }
+    put_bytes(&b, "EOS", 3);
+    put_bytes(&b, (const uint8_t[SF2_SHDR_SIZE - 3]){0}, SF2_SHDR_SIZE - 3);
+    close_chunk(&b, chunk);
+    close_chunk(&b, pdta);
+    close_chunk(&b, riff);
+
+    if (b.size > sizeof(b.data)) {
+        return -1;
+    }
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        return -1;
+    }
+    int status = fwrite(b.data, 1, b.size, out) == b.size ? 0 : -1;
+    if (fclose(out) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+uint8_t* fixture_read(const char* path, size_t* size_out) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        return NULL;
+    }
+    uint8_t* data = NULL;
+    long size = fseek(in, 0, SEEK_END) == 0 ? ftell(in) : -1;
+    if (size >= 0 && fseek(in, 0, SEEK_SET) == 0 && (data = (uint8_t*)malloc((size_t)size + 1)) &&
+        fread(data, 1, (size_t)size, in) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(in);
+    *size_out = data ? (size_t)size : 0;
+    return data;
+}
@@ -0,0 +1,59 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Test SoundFont (sf2_fixture.h)
+ *
+ * Writes a small SoundFont with a known layout for the parser, bank and
+ * writer tests:
+ *
+ *   preset 0:0 "Piano" -> instrument "Keys": a global zone looping
+ *                         continuously (sampleModes 1), "Low" on keys 0-63
+ *                         and "High" on keys 64-127
+ *   preset 0:1 "Organ" -> instrument "Pipe": "Pipe" looping until release
+ *                         (sampleModes 3)
+ *
+ * "Low" and "High" hold the same data under different names; "Pipe" holds
+ * different data. Every sample is followed by the 46 zero padding points.
+ */
+
+#ifndef SF2_FIXTURE_H
+#define SF2_FIXTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample indices in the shdr chunk
+#define FIXTURE_LOW 0
+#define FIXTURE_HIGH 1
+#define FIXTURE_PIPE 2
+#define FIXTURE_SAMPLES 3
+
+// Points of each sample and their loops
+#define FIXTURE_KEYS_POINTS 100
+#define FIXTURE_KEYS_LOOP_START 20
+#define FIXTURE_KEYS_LOOP_END 60
+#define FIXTURE_PIPE_POINTS 50
+#define FIXTURE_PIPE_LOOP_START 10
+#define FIXTURE_PIPE_LOOP_END 30
+
+#define FIXTURE_RATE 44100
+
+/* Value of one point of a fixture sample */
+int16_t fixture_point(int sample, uint32_t point);
+
+/* First point of a fixture sample in the smpl chunk */
+uint32_t fixture_start(int sample);
+
+/*
+ * Write the test SoundFont to path.
+ * Returns 0 on success, -1 on failure.
+ */
+int fixture_write(const char* path);
+
+/*
+ * Read a whole file into memory, e.g. a written SoundFont or bank.
+ * The returned buffer must be released with free().
+ * Returns NULL on failure.
+ */
+uint8_t* fixture_read(const char* path, size_t* size_out);
+
+#endif
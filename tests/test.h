@@ -0,0 +1,35 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Unit Test Checks (test.h)
+ *
+ * Each test program checks one module: failed checks are printed with
+ * their location and the program exits non-zero if there was any.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Failed checks so far in this test program
+static int test_failures;
+
+/* Check a condition, printing it if it does not hold */
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+/* Print the result of a test program; returns its exit status */
+static inline int test_result(const char* name) {
+    if (test_failures > 0) {
+        printf("\033[1;31m%s: %d checks failed\033[0m\n", name, test_failures);
+        return 1;
+    }
+    printf("\033[1;32m%s: passed\033[0m\n", name);
+    return 0;
+}
+
+#endif
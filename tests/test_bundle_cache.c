@@ -0,0 +1,115 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Bundle Cache Record Tests (test_bundle_cache.c)
+ *
+ * Checks:
+ * 1. That the key is stable and changes with every input of the bundle
+ * 2. That the watched source and the profile scale only count when used
+ * 3. That a record reads back as written, and a damaged one is not valid
+ *
+ * Usage: test_bundle_cache <scratch directory>
+ */
+
+#include "bundle_cache.h"
+#include "test.h"
+
+#include <string.h>
+
+/* Inputs of a plain bundle: SoundFont, sources, binary and name only */
+static BundleKeyInputs base_inputs(void) {
+    BundleKeyInputs inputs;
+    memset(&inputs, 0, sizeof(inputs));
+    inputs.sf2_hash = 0x1111;
+    inputs.inputs_hash = 0x2222;
+    inputs.binary_hash = 0x3333;
+    inputs.plugin_name = "Keys";
+    return inputs;
+}
+
+/* Check that the key of inputs differs from the base key */
+#define CHECK_CHANGES(change) do { \
+        BundleKeyInputs inputs = base_inputs(); \
+        change; \
+        CHECK(bundle_cache_key(&inputs) != base); \
+    } while (0)
+
+static void test_key(void) {
+    BundleKeyInputs inputs = base_inputs();
+    uint64_t base = bundle_cache_key(&inputs);
+    CHECK(bundle_cache_key(&inputs) == base);
+
+    // Every input that changes what is written changes the key
+    CHECK_CHANGES(inputs.sf2_hash ^= 1);
+    CHECK_CHANGES(inputs.inputs_hash ^= 1);
+    CHECK_CHANGES(inputs.binary_hash ^= 1);
+    CHECK_CHANGES(inputs.layout = 1);
+    CHECK_CHANGES(inputs.bank = 1);
+    CHECK_CHANGES(inputs.lazy_samples = 1);
+    CHECK_CHANGES(inputs.watch_soundfont = 1);
+    CHECK_CHANGES(inputs.deadline = 0.5);
+    CHECK_CHANGES(inputs.recordings_dir = "/tmp/recordings");
+    CHECK_CHANGES(inputs.preset_filter = "0:0-7");
+    CHECK_CHANGES(inputs.reduce.trim_loop_tails = 1);
+    CHECK_CHANGES(inputs.reduce.drop_sm24 = 1);
+    CHECK_CHANGES(inputs.reduce.target_rate = 32000);
+    CHECK_CHANGES(inputs.reduce.dedup_samples = 1);
+    CHECK_CHANGES(inputs.profile = 1);
+    CHECK_CHANGES(inputs.plugin_name = "Keys2");
+
+    // An empty filter still differs from no filter
+    CHECK_CHANGES(inputs.preset_filter = "");
+
+    // The watched source only counts when the SoundFont is watched
+    inputs = base_inputs();
+    inputs.watch_source = "/music/Keys.sf2";
+    CHECK(bundle_cache_key(&inputs) == base);
+    inputs.watch_soundfont = 1;
+    uint64_t watched = bundle_cache_key(&inputs);
+    inputs.watch_source = "/music/Other.sf2";
+    CHECK(bundle_cache_key(&inputs) != watched);
+
+    // The profile scale only counts when profiling
+    inputs = base_inputs();
+    inputs.profile_scale = 2.0;
+    CHECK(bundle_cache_key(&inputs) == base);
+    inputs.profile = 1;
+    uint64_t profiled = bundle_cache_key(&inputs);
+    inputs.profile_scale = 3.0;
+    CHECK(bundle_cache_key(&inputs) != profiled);
+}
+
+static void test_record(const char* dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/cache_record", dir);
+
+    CacheRecord written = { 1, 0xfedcba9876543210ULL, 0x0123456789abcdefULL, 123456789012LL,
+                            1700000000LL, 999999999L, 42 };
+    CHECK(cache_record_write(path, &written, stderr) == 0);
+    CacheRecord read;
+    cache_record_read(path, &read);
+    CHECK(read.valid == 1);
+    CHECK(read.key == written.key && read.sf2_hash == written.sf2_hash);
+    CHECK(read.sf2_size == written.sf2_size);
+    CHECK(read.sf2_mtime_s == written.sf2_mtime_s && read.sf2_mtime_ns == written.sf2_mtime_ns);
+    CHECK(read.preset_count == 42);
+
+    // A truncated record is not valid
+    FILE* f = fopen(path, "w");
+    if (f) {
+        fputs("key 0123456789abcdef\nsf2 0123456789abcdef 10 20\n", f);
+        fclose(f);
+    }
+    cache_record_read(path, &read);
+    CHECK(read.valid == 0 && read.key == 0);
+
+    // Neither is a missing one
+    remove(path);
+    cache_record_read(path, &read);
+    CHECK(read.valid == 0);
+}
+
+int main(int argc, char** argv) {
+    test_key();
+    test_record(argc > 1 ? argv[1] : ".");
+    return test_result("bundle_cache");
+}
@@ -0,0 +1,146 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Live Metrics Tests (test_live_metrics.c)
+ *
+ * Checks the seqlock reader of a slot:
+ * 1. Published counters and the name read back unchanged
+ * 2. Unused slots and slots stuck mid-write are not read
+ * 3. A reader racing a writer thread only ever sees whole updates
+ */
+
+#include "live_metrics.h"
+#include "test.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// Reads made while the writer thread publishes
+#define RACE_READS 200000
+
+/* Counters that are all derived from n, so a torn copy mixes two values of n */
+static LiveMetrics counters_for(uint64_t n) {
+    LiveMetrics values;
+    memset(&values, 0, sizeof(values));
+    values.cycles = n;
+    values.deadline_misses = n / 3;
+    values.memory = (int64_t)n * 4096;
+    values.updated_ns = (int64_t)n * 1000;
+    values.load = (float)(n % 1000) / 1000.0f;
+    values.voices = (uint32_t)(n % 256);
+    values.peak_voices = (uint32_t)(n % 256) + 1;
+    values.full_polyphony_notes = (uint32_t)(n / 7);
+    values.program = (int32_t)(n % 128);
+    return values;
+}
+
+static int consistent(const LiveMetrics* values) {
+    LiveMetrics expected = counters_for(values->cycles);
+    return !memcmp(&expected, values, sizeof(expected));
+}
+
+/* A slot as claimed by an instance, outside shared memory */
+static void init_slot(LiveMetricsSlot* slot, const char* name) {
+    memset(slot, 0, sizeof(*slot));
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    atomic_store(&slot->in_use, 1);
+}
+
+static void test_round_trip(void) {
+    static LiveMetricsSlot slot;
+    init_slot(&slot, "SF2LV2-Test");
+    char name[64];
+    LiveMetrics values;
+
+    LiveMetrics published = counters_for(12345);
+    live_metrics_publish(&slot, &published);
+    CHECK(atomic_load(&slot.seq) == 2);
+    CHECK(live_metrics_read(&slot, name, &values) == 0);
+    CHECK(!strcmp(name, "SF2LV2-Test"));
+    CHECK(!memcmp(&values, &published, sizeof(values)));
+
+    // A later update replaces the counters
+    published = counters_for(12346);
+    live_metrics_publish(&slot, &published);
+    CHECK(live_metrics_read(&slot, name, &values) == 0 && values.cycles == 12346);
+
+    // A name filling the whole field comes back terminated
+    memset(slot.name, 'x', sizeof(slot.name));
+    CHECK(live_metrics_read(&slot, name, &values) == 0 && strlen(name) == 63);
+}
+
+static void test_unreadable(void) {
+    static LiveMetricsSlot slot;
+    char name[64];
+    LiveMetrics values;
+
+    // A free slot is skipped, even with counters left in it
+    init_slot(&slot, "SF2LV2-Test");
+    LiveMetrics published = counters_for(7);
+    live_metrics_publish(&slot, &published);
+    atomic_store(&slot.in_use, 0);
+    CHECK(live_metrics_read(&slot, name, &values) == -1);
+
+    // A writer that stopped halfway (odd sequence) never yields a copy
+    atomic_store(&slot.in_use, 1);
+    atomic_store(&slot.seq, 3);
+    CHECK(live_metrics_read(&slot, name, &values) == -1);
+    atomic_store(&slot.seq, 4);
+    CHECK(live_metrics_read(&slot, name, &values) == 0);
+}
+
+/* Writer thread of the race: publishes increasing counters until stopped */
+typedef struct {
+    LiveMetricsSlot* slot;
+    atomic_int stop;
+} Writer;
+
+static void* writer_thread(void* arg) {
+    Writer* writer = (Writer*)arg;
+    for (uint64_t n = 1; !atomic_load_explicit(&writer->stop, memory_order_relaxed); n++) {
+        LiveMetrics values = counters_for(n);
+        live_metrics_publish(writer->slot, &values);
+    }
+    return NULL;
+}
+
+static void test_race(void) {
+    static LiveMetricsSlot slot;
+    init_slot(&slot, "SF2LV2-Race");
+    LiveMetrics first = counters_for(0);
+    live_metrics_publish(&slot, &first);
+
+    Writer writer = { &slot, 0 };
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, writer_thread, &writer) != 0) {
+        CHECK(!"writer thread could not be started");
+        return;
+    }
+
+    // Every copy must be one whole update, and updates never go backwards
+    int reads = 0, torn = 0, backwards = 0;
+    uint64_t last = 0;
+    for (int i = 0; i < RACE_READS; i++) {
+        char name[64];
+        LiveMetrics values;
+        if (live_metrics_read(&slot, name, &values) != 0) {
+            continue;
+        }
+        reads++;
+        if (!consistent(&values) || strcmp(name, "SF2LV2-Race") != 0) torn++;
+        if (values.cycles < last) backwards++;
+        last = values.cycles;
+    }
+    atomic_store(&writer.stop, 1);
+    pthread_join(thread, NULL);
+
+    CHECK(reads > 0);
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+}
+
+int main(void) {
+    test_round_trip();
+    test_unreadable();
+    test_race();
+    return test_result("live_metrics");
+}
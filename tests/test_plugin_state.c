@@ -0,0 +1,123 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Plugin State Encoding Tests (test_plugin_state.c)
+ *
+ * Encodes state values and decodes them again, and checks:
+ * 1. The most played programs, their order and the limit on them
+ * 2. Usage counts and preset triples through a round trip, including
+ *    a changed preset list and malformed restored values
+ * 3. The controller chunk and which controllers are restored
+ */
+
+#include "plugin_state.h"
+#include "test.h"
+
+#include <string.h>
+
+static void test_hot_programs(void) {
+    const uint32_t counts[6] = { 5, 0, 9, 5, 1, 7 };
+    int hot[4];
+    CHECK(state_hot_programs(counts, 6, hot, 4) == 4);
+    CHECK(hot[0] == 2 && hot[1] == 5);
+    CHECK(hot[2] == 0 && hot[3] == 3);     // Ties keep program order
+
+    // Past the limit the least played drop out
+    CHECK(state_hot_programs(counts, 6, hot, 2) == 2);
+    CHECK(hot[0] == 2 && hot[1] == 5);
+
+    // Programs never played are not listed
+    const uint32_t unplayed[3] = { 0, 0, 0 };
+    CHECK(state_hot_programs(unplayed, 3, hot, 4) == 0);
+}
+
+static void test_counts(void) {
+    uint32_t counts[8] = { 0, 1, 2, 65535, 40, 0, 7, 3 };
+    int32_t values[8];
+    state_encode_counts(counts, 8, values);
+
+    uint32_t restored[8];
+    memset(restored, 0, sizeof(restored));
+    state_decode_counts(values, 8, restored, 8);
+    CHECK(!memcmp(restored, counts, sizeof(counts)));
+
+    // Negative elements count as 0; extra elements are ignored, missing ones leave the count
+    const int32_t odd[4] = { -3, 12, 4, 99 };
+    uint32_t few[3] = { 8, 8, 8 };
+    state_decode_counts(odd, 4, few, 3);
+    CHECK(few[0] == 0 && few[1] == 12 && few[2] == 4);
+    state_decode_counts(odd, 1, few, 3);
+    CHECK(few[0] == 0 && few[1] == 12 && few[2] == 4);
+    state_decode_counts(NULL, 0, few, 3);
+    CHECK(few[1] == 12);
+}
+
+static void test_presets(void) {
+    const BankProgram programs[4] = { { 0, 0 }, { 0, 1 }, { 8, 4 }, { 128, 0 } };
+    const uint32_t counts[4] = { 3, 0, 10, 6 };
+    int hot[4];
+    int hot_count = state_hot_programs(counts, 4, hot, 4);
+    int32_t values[12];
+    CHECK(state_encode_presets(programs, counts, hot, hot_count, values) == 9);
+    CHECK(values[0] == 8 && values[1] == 4 && values[2] == 10);
+    CHECK(values[3] == 128 && values[4] == 0 && values[5] == 6);
+
+    int restored[4];
+    uint32_t restored_counts[4];
+    CHECK(state_decode_presets(values, 9, programs, 4, restored, restored_counts, 4) == 3);
+    CHECK(restored[0] == 2 && restored_counts[0] == 10);
+    CHECK(restored[1] == 3 && restored_counts[1] == 6);
+    CHECK(restored[2] == 0 && restored_counts[2] == 3);
+
+    // Presets are found by bank and program after the list changed; a removed one is skipped
+    const BankProgram changed[3] = { { 128, 0 }, { 0, 0 }, { 0, 1 } };
+    CHECK(state_decode_presets(values, 9, changed, 3, restored, restored_counts, 4) == 2);
+    CHECK(restored[0] == 0 && restored_counts[0] == 6);
+    CHECK(restored[1] == 1 && restored_counts[1] == 3);
+
+    // The limit holds, an incomplete triple is skipped and a negative count is 0
+    CHECK(state_decode_presets(values, 9, programs, 4, restored, restored_counts, 1) == 1);
+    CHECK(state_decode_presets(values, 8, programs, 4, restored, restored_counts, 4) == 2);
+    const int32_t negative[3] = { 0, 1, -5 };
+    CHECK(state_decode_presets(negative, 3, programs, 4, restored, restored_counts, 4) == 1);
+    CHECK(restored[0] == 1 && restored_counts[0] == 0);
+    CHECK(state_decode_presets(NULL, 0, programs, 4, restored, restored_counts, 4) == 0);
+}
+
+static void test_controllers(void) {
+    int values[STATE_CONTROLLERS];
+    for (int cc = 0; cc < STATE_CONTROLLERS; cc++) {
+        values[cc] = cc == 7 ? 100 : cc * 3;
+    }
+    uint8_t chunk[STATE_CONTROLLERS];
+    state_encode_controllers(values, chunk);
+    CHECK(chunk[7] == 100 && chunk[10] == 30);
+    CHECK(chunk[50] == (150 & 0x7F));   // Only 7 bits are kept
+
+    uint8_t restored[STATE_CONTROLLERS];
+    memset(restored, 0xFF, sizeof(restored));
+    CHECK(state_decode_controllers(chunk, sizeof(chunk), restored) == 1);
+    CHECK(!memcmp(restored, chunk, sizeof(chunk)));
+
+    // A chunk of any other size, such as one per channel, is not taken
+    uint8_t channels[16 * STATE_CONTROLLERS] = {0};
+    CHECK(state_decode_controllers(channels, sizeof(channels), restored) == 0);
+    CHECK(state_decode_controllers(chunk, sizeof(chunk) - 1, restored) == 0);
+    CHECK(state_decode_controllers(NULL, sizeof(chunk), restored) == 0);
+    CHECK(!memcmp(restored, chunk, sizeof(chunk)));
+
+    // Controllers that act when sent are not restored
+    CHECK(state_controller_restorable(7) && state_controller_restorable(74) && state_controller_restorable(64));
+    CHECK(!state_controller_restorable(0) && !state_controller_restorable(32));
+    CHECK(!state_controller_restorable(6) && !state_controller_restorable(38));
+    CHECK(!state_controller_restorable(96) && !state_controller_restorable(101));
+    CHECK(state_controller_restorable(102) && state_controller_restorable(119));
+    CHECK(!state_controller_restorable(120) && !state_controller_restorable(127));
+}
+
+int main(void) {
+    test_hot_programs();
+    test_counts();
+    test_presets();
+    test_controllers();
+    return test_result("plugin_state");
+}
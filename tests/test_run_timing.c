@@ -0,0 +1,136 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * run() Timing Histogram Tests (test_run_timing.c)
+ *
+ * Records known cycle times and checks:
+ * 1. Which bucket each time lands in, at the bucket edges
+ * 2. The maxima, cycle count and deadline misses
+ * 3. The percentiles written by the report
+ */
+
+#include "run_timing.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Record one cycle whose phases all took ns, with a deadline of deadline_ns */
+static void record(RunTiming* timing, int64_t ns, int64_t deadline_ns) {
+    int64_t phase_ns[RUN_PHASES];
+    for (int phase = 0; phase < RUN_PHASES; phase++) {
+        phase_ns[phase] = ns;
+    }
+    run_timing_record(timing, phase_ns, deadline_ns);
+}
+
+/* Bucket a single time lands in, or -1 if it did not land in exactly one */
+static int bucket_of_time(int64_t ns) {
+    RunTiming* timing = (RunTiming*)calloc(1, sizeof(RunTiming));
+    if (!timing) {
+        return -1;
+    }
+    record(timing, ns, INT64_MAX);
+    int found = -1, hits = 0;
+    for (int bucket = 0; bucket < RUN_TIMING_BUCKETS; bucket++) {
+        if (atomic_load(&timing->counts[RUN_PHASE_TOTAL][bucket]) > 0) {
+            found = bucket;
+            hits++;
+        }
+    }
+    free(timing);
+    return hits == 1 ? found : -1;
+}
+
+/* Buckets: below 1024 ns, then four per power of two; the last one takes the rest */
+static void test_buckets(void) {
+    CHECK(bucket_of_time(0) == 0);
+    CHECK(bucket_of_time(-5) == 0);
+    CHECK(bucket_of_time(1023) == 0);
+    CHECK(bucket_of_time(1024) == 1);
+    CHECK(bucket_of_time(1279) == 1);
+    CHECK(bucket_of_time(1280) == 2);
+    CHECK(bucket_of_time(1536) == 3);
+    CHECK(bucket_of_time(2047) == 4);
+    CHECK(bucket_of_time(2048) == 5);
+    CHECK(bucket_of_time(50000) == 1 + 5 * RUN_TIMING_STEPS + 2);
+    CHECK(bucket_of_time(((int64_t)1 << 30) - 1) == RUN_TIMING_BUCKETS - 1);
+    CHECK(bucket_of_time((int64_t)1 << 30) == RUN_TIMING_BUCKETS - 1);
+    CHECK(bucket_of_time((int64_t)5000000000) == RUN_TIMING_BUCKETS - 1);
+}
+
+/* Counters: every phase keeps its own maximum; misses are cycles whose total exceeds the deadline */
+static void test_counters(RunTiming* timing) {
+    int64_t phase_ns[RUN_PHASES] = { 100, 2000, 30000, 400, 40000 };
+    run_timing_record(timing, phase_ns, 40000);
+    phase_ns[RUN_PHASE_RENDER] = 10;
+    phase_ns[RUN_PHASE_TOTAL] = 40001;
+    run_timing_record(timing, phase_ns, 40000);
+
+    CHECK(atomic_load(&timing->cycles) == 2);
+    CHECK(atomic_load(&timing->misses) == 1);
+    CHECK(atomic_load(&timing->max[RUN_PHASE_CONTROLS]) == 100);
+    CHECK(atomic_load(&timing->max[RUN_PHASE_RENDER]) == 30000);
+    CHECK(atomic_load(&timing->max[RUN_PHASE_TOTAL]) == 40001);
+    CHECK(atomic_load(&timing->counts[RUN_PHASE_RENDER][0]) == 1);
+}
+
+/*
+ * Report: 90 cycles of 2 us, 9 of 50 us and one of 2 ms. Percentiles are
+ * the upper limits of their buckets (2.048 us, 57.344 us), capped at the
+ * longest time recorded (2000 us).
+ */
+static void test_report(void) {
+    RunTiming* timing = (RunTiming*)calloc(1, sizeof(RunTiming));
+    FILE* out = tmpfile();
+    if (!timing || !out) {
+        CHECK(timing && out);
+        free(timing);
+        if (out) fclose(out);
+        return;
+    }
+    for (int i = 0; i < 90; i++) record(timing, 2000, 1000000);
+    for (int i = 0; i < 9; i++) record(timing, 50000, 1000000);
+    record(timing, 2000000, 1000000);
+    run_timing_report(timing, 0.5, out);
+
+    char text[2048] = {0};
+    rewind(out);
+    size_t length = fread(text, 1, sizeof(text) - 1, out);
+    text[length] = '\0';
+    fclose(out);
+
+    char expected[256];
+    CHECK(strstr(text, "  100 cycles, 1 over 50% of the block duration\n") == text);
+    CHECK(strstr(text, "p99.9") != NULL);
+    snprintf(expected, sizeof(expected), "  %-10s %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+             "total", 2.0, 57.3, 2000.0, 2000.0, 2000.0);
+    CHECK(strstr(text, expected) != NULL);
+    snprintf(expected, sizeof(expected), "  %-10s %9.1f", "controls", 2.0);
+    CHECK(strstr(text, expected) != NULL);
+    free(timing);
+
+    // An empty histogram reports no percentiles
+    timing = (RunTiming*)calloc(1, sizeof(RunTiming));
+    out = tmpfile();
+    if (timing && out) {
+        run_timing_report(timing, 1.0, out);
+        memset(text, 0, sizeof(text));
+        rewind(out);
+        length = fread(text, 1, sizeof(text) - 1, out);
+        CHECK(!strcmp(text, "  0 cycles, 0 over 100% of the block duration\n"));
+    }
+    if (out) fclose(out);
+    free(timing);
+}
+
+int main(void) {
+    RunTiming* timing = (RunTiming*)calloc(1, sizeof(RunTiming));
+    if (!timing) {
+        return 1;
+    }
+    test_buckets();
+    test_counters(timing);
+    test_report();
+    free(timing);
+    return test_result("run_timing");
+}
@@ -0,0 +1,124 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Sample Bank Tests (test_sf2_bank.c)
+ *
+ * Writes a bank for the test SoundFont and checks:
+ * 1. The preset and zone tables read back from the validated bank
+ * 2. That a damaged bank fails validation
+ * 3. That the bank stops matching when the SoundFont's size or preset
+ *    data change, but not when only its sample data does
+ *
+ * Usage: test_sf2_bank <scratch directory>
+ */
+
+#include "sf2_bank.h"
+#include "sf2_bank_writer.h"
+#include "sf2_fixture.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Check the tables of a validated bank against the fixture layout */
+static void check_tables(const SF2BankHeader* header, const SF2File* sf) {
+    CHECK(header->preset_count == 2);
+    CHECK(header->zone_count == 3);
+    CHECK(header->sample_count == FIXTURE_SAMPLES);
+    CHECK(header->flags == 0);
+    CHECK(header->source_size == (uint64_t)sf->file_size);
+    CHECK(header->sample_data_size == sf->smpl.size);
+    CHECK(header->preset_offset % SF2_BANK_ALIGN == 0 && header->zone_offset % SF2_BANK_ALIGN == 0);
+
+    const SF2BankPreset* presets = sf2_bank_presets(header);
+    CHECK(presets[0].bank == 0 && presets[0].prog == 0 && !strcmp(presets[0].name, "Piano"));
+    CHECK(presets[0].zone_start == 0 && presets[0].zone_count == 2);
+    CHECK(presets[1].bank == 0 && presets[1].prog == 1 && !strcmp(presets[1].name, "Organ"));
+    CHECK(presets[1].zone_start == 2 && presets[1].zone_count == 1);
+
+    // Zones carry the key ranges, the global loop mode and the byte ranges of the sample data
+    const SF2BankZone* zones = sf2_bank_zones(header);
+    CHECK(zones[0].sample == FIXTURE_LOW && zones[0].key_lo == 0 && zones[0].key_hi == 63);
+    CHECK(zones[1].sample == FIXTURE_HIGH && zones[1].key_lo == 64 && zones[1].key_hi == 127);
+    CHECK(zones[0].loop_mode == 1 && zones[1].loop_mode == 1);
+    CHECK(zones[2].sample == FIXTURE_PIPE && zones[2].loop_mode == 3);
+    CHECK(zones[2].vel_lo == 0 && zones[2].vel_hi == 127);
+    for (int z = 0; z < 3; z++) {
+        int points = zones[z].sample == FIXTURE_PIPE ? FIXTURE_PIPE_POINTS : FIXTURE_KEYS_POINTS;
+        CHECK(zones[z].data_offset == (uint64_t)sf->smpl.offset + fixture_start((int)zones[z].sample) * 2);
+        CHECK(zones[z].data_size == (uint32_t)points * 2);
+    }
+}
+
+/* A copy of the bank with one byte changed must fail validation */
+static void check_damaged(const uint8_t* bank, size_t size, size_t offset) {
+    uint8_t* copy = (uint8_t*)malloc(size);
+    if (!copy) {
+        CHECK(copy != NULL);
+        return;
+    }
+    memcpy(copy, bank, size);
+    copy[offset] ^= 0x10;
+    CHECK(sf2_bank_validate(copy, size) == NULL);
+    free(copy);
+}
+
+int main(int argc, char** argv) {
+    const char* dir = argc > 1 ? argv[1] : ".";
+    char sf2_path[4096], bank_path[4096];
+    snprintf(sf2_path, sizeof(sf2_path), "%s/bank_fixture.sf2", dir);
+    snprintf(bank_path, sizeof(bank_path), "%s/bank_fixture" SF2_BANK_EXT, dir);
+
+    SF2File sf;
+    SF2Preset* presets = NULL;
+    if (fixture_write(sf2_path) != 0 || sf2_open(&sf, sf2_path) != 0) {
+        fprintf(stderr, "Failed to write the test SoundFont '%s'\n", sf2_path);
+        return 1;
+    }
+    int preset_count = sf2_read_presets(&sf, &presets);
+    CHECK(preset_count == 2);
+    CHECK(sf2_bank_write(&sf, presets, preset_count, bank_path, stderr) == 3);
+
+    size_t bank_size = 0, sf2_size = 0;
+    uint8_t* bank = fixture_read(bank_path, &bank_size);
+    uint8_t* soundfont = fixture_read(sf2_path, &sf2_size);
+    const SF2BankHeader* header = bank ? sf2_bank_validate(bank, bank_size) : NULL;
+    CHECK(header != NULL);
+    if (header && soundfont) {
+        check_tables(header, &sf);
+
+        // Damage in the header or either table is caught, as is a short file
+        check_damaged(bank, bank_size, offsetof(SF2BankHeader, zone_count));
+        check_damaged(bank, bank_size, (size_t)header->preset_offset + offsetof(SF2BankPreset, prog));
+        check_damaged(bank, bank_size, (size_t)header->zone_offset + offsetof(SF2BankZone, key_hi));
+        check_damaged(bank, bank_size, 0);
+        CHECK(sf2_bank_validate(bank, bank_size - 1) == NULL);
+        CHECK(sf2_bank_validate(bank, sizeof(SF2BankHeader) - 1) == NULL);
+
+        // The bank matches its own SoundFont, and a SoundFont of another size does not
+        CHECK(sf2_bank_matches(header, soundfont, sf2_size) == 1);
+        CHECK(sf2_bank_matches(header, soundfont, sf2_size - 2) == 0);
+
+        // Sample data is not covered, so the bank survives edits to it
+        soundfont[sf.smpl.offset + 10] ^= 0x01;
+        CHECK(sf2_bank_matches(header, soundfont, sf2_size) == 1);
+
+        // A changed sample header (the rate of Pipe) is a different SoundFont
+        size_t rate = (size_t)sf.shdr.offset + FIXTURE_PIPE * SF2_SHDR_SIZE + 36;
+        CHECK(rate >= header->pdta_offset && rate < header->pdta_offset + header->pdta_size);
+        soundfont[rate] ^= 0x01;
+        CHECK(sf2_bank_matches(header, soundfont, sf2_size) == 0);
+        soundfont[rate] ^= 0x01;
+
+        // So is a changed preset number
+        soundfont[sf.phdr.offset + SF2_NAME_LEN] ^= 0x02;
+        CHECK(sf2_bank_matches(header, soundfont, sf2_size) == 0);
+    }
+
+    free(bank);
+    free(soundfont);
+    free(presets);
+    sf2_close(&sf);
+    remove(bank_path);
+    remove(sf2_path);
+    return test_result("sf2_bank");
+}
@@ -0,0 +1,278 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont Writer Tests (test_sf2_writer.c)
+ *
+ * Writes subsets of the test SoundFont and parses the result again to
+ * check which presets and samples were kept, where their data went and
+ * what the write report says about them.
+ *
+ * Usage: test_sf2_writer <scratch directory>
+ */
+
+#include "sf2_writer.h"
+#include "sf2_fixture.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Scratch files
+static char source_path[4096];
+static char output_path[4096];
+
+/* A written SoundFont, parsed again */
+typedef struct {
+    SF2File sf;
+    SF2Preset* presets;
+    int preset_count;
+    SF2Sample* samples;
+    int sample_count;
+    uint8_t* smpl;
+} Written;
+
+/* Write the given presets of the source with options and parse the result */
+static int write_subset(const int* preset_indices, int count, const SF2WriteOptions* options,
+                        SF2WriteReport* report, Written* written) {
+    memset(written, 0, sizeof(*written));
+    memset(report, 0, sizeof(*report));
+    SF2File source;
+    SF2Preset* presets = NULL;
+    if (sf2_open(&source, source_path) != 0) {
+        return -1;
+    }
+    int status = -1;
+    SF2Preset subset[4];
+    if (sf2_read_presets(&source, &presets) == 2 && count <= 4) {
+        for (int i = 0; i < count; i++) {
+            subset[i] = presets[preset_indices[i]];
+        }
+        status = sf2_write_subset(&source, subset, count, options, output_path, report, stderr);
+    }
+    free(presets);
+    sf2_close(&source);
+
+    if (status != 0 || sf2_open(&written->sf, output_path) != 0) {
+        return -1;
+    }
+    written->preset_count = sf2_read_presets(&written->sf, &written->presets);
+    written->sample_count = sf2_read_samples(&written->sf, &written->samples);
+    written->smpl = sf2_read_chunk(&written->sf, &written->sf.smpl, "smpl");
+    if (written->preset_count < 0 || written->sample_count < 0 || !written->smpl) {
+        return -1;
+    }
+    return 0;
+}
+
+static void free_written(Written* written, SF2WriteReport* report) {
+    free(written->presets);
+    free(written->samples);
+    free(written->smpl);
+    if (written->sf.file) {
+        sf2_close(&written->sf);
+    }
+    free(report->samples);
+    report->samples = NULL;
+}
+
+/* Check that a written sample holds the first points of a fixture sample */
+static int same_points(const Written* written, const SF2Sample* sample, int fixture_sample, uint32_t points) {
+    if (sample->end - sample->start != points || (uint64_t)sample->end * 2 > written->sf.smpl.size) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < points; i++) {
+        const uint8_t* p = written->smpl + (size_t)(sample->start + i) * 2;
+        if ((int16_t)(p[0] | p[1] << 8) != fixture_point(fixture_sample, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Only the Organ preset: its instrument and sample are kept, renumbered */
+static void test_subset_one(void) {
+    static const int organ[] = { 1 };
+    SF2WriteReport report;
+    Written written;
+    CHECK(write_subset(organ, 1, NULL, &report, &written) == 0);
+    CHECK(report.preset_count == 1 && report.instrument_count == 1 && report.sample_count == 1);
+    CHECK(report.source_sample_count == FIXTURE_SAMPLES && report.distinct_sample_count == 1);
+
+    // Chunk sizes, padding included
+    CHECK(report.sample_bytes == (FIXTURE_PIPE_POINTS + SF2_SAMPLE_PADDING) * 2);
+    CHECK(report.source_sample_bytes == (int64_t)(fixture_start(FIXTURE_PIPE) + FIXTURE_PIPE_POINTS + SF2_SAMPLE_PADDING) * 2);
+
+    if (written.preset_count == 1 && written.sample_count == 1) {
+        CHECK(report.samples[0].source_bytes == FIXTURE_PIPE_POINTS * 2);
+        CHECK(report.samples[0].bytes == FIXTURE_PIPE_POINTS * 2);
+        CHECK(written.presets[0].bank == 0 && written.presets[0].prog == 1);
+        CHECK(!strcmp(written.presets[0].name, "Organ"));
+
+        const SF2Sample* pipe = &written.samples[0];
+        CHECK(!strcmp(pipe->name, "Pipe") && !strcmp(report.samples[0].name, "Pipe"));
+        CHECK(pipe->start == 0 && pipe->rate == FIXTURE_RATE);
+        CHECK(pipe->loop_start == FIXTURE_PIPE_LOOP_START && pipe->loop_end == FIXTURE_PIPE_LOOP_END);
+        CHECK(same_points(&written, pipe, FIXTURE_PIPE, FIXTURE_PIPE_POINTS));
+        CHECK(written.sf.smpl.size == (FIXTURE_PIPE_POINTS + SF2_SAMPLE_PADDING) * 2);
+
+        // The zone points at the renumbered sample and keeps its loop mode
+        SF2Zone* zones = NULL;
+        CHECK(sf2_read_zones(&written.sf, written.presets, 1, &zones) == 1);
+        CHECK(zones && zones[0].sample == 0 && zones[0].loop_mode == 3);
+        free(zones);
+    } else {
+        CHECK(written.preset_count == 1 && written.sample_count == 1);
+    }
+    free_written(&written, &report);
+}
+
+/* Only the Piano preset: both of its samples, unchanged, each with its own data */
+static void test_subset_keys(void) {
+    static const int piano[] = { 0 };
+    SF2WriteReport report;
+    Written written;
+    CHECK(write_subset(piano, 1, NULL, &report, &written) == 0);
+    CHECK(report.preset_count == 1 && report.instrument_count == 1 && report.sample_count == 2);
+    CHECK(report.distinct_sample_count == 2 && report.shared_bytes == 0);
+
+    if (written.sample_count == 2) {
+        const SF2Sample* low = &written.samples[0];
+        const SF2Sample* high = &written.samples[1];
+        CHECK(!strcmp(low->name, "Low") && !strcmp(high->name, "High"));
+        CHECK(low->start == 0 && high->start == FIXTURE_KEYS_POINTS + SF2_SAMPLE_PADDING);
+        CHECK(high->loop_start == high->start + FIXTURE_KEYS_LOOP_START);
+        CHECK(high->loop_end == high->start + FIXTURE_KEYS_LOOP_END);
+        CHECK(same_points(&written, low, FIXTURE_LOW, FIXTURE_KEYS_POINTS));
+        CHECK(same_points(&written, high, FIXTURE_HIGH, FIXTURE_KEYS_POINTS));
+        for (int s = 0; s < 2; s++) {
+            CHECK(report.samples[s].shared_with == -1 && report.samples[s].trimmed_points == 0);
+            CHECK(report.samples[s].bytes == FIXTURE_KEYS_POINTS * 2 && !report.samples[s].lossy);
+        }
+    } else {
+        CHECK(written.sample_count == 2);
+    }
+    free_written(&written, &report);
+}
+
+/* Trimming drops the data after the loop of Low and High, not of Pipe, which leaves its loop */
+static void test_trim(void) {
+    static const int both[] = { 0, 1 };
+    static const SF2WriteOptions trim = { 1, 0, 0, 0 };
+    SF2WriteReport report;
+    Written written;
+    CHECK(write_subset(both, 2, &trim, &report, &written) == 0);
+
+    // The loop end plus the guard points the specification asks for are kept
+    uint32_t kept = FIXTURE_KEYS_LOOP_END + 8;
+    if (written.sample_count == FIXTURE_SAMPLES) {
+        for (int s = 0; s < 2; s++) {
+            const SF2Sample* sample = &written.samples[s];
+            CHECK(report.samples[s].trimmed_points == FIXTURE_KEYS_POINTS - kept);
+            CHECK(report.samples[s].bytes == (int64_t)kept * 2 && !report.samples[s].lossy);
+            CHECK(sample->start == (uint32_t)s * (kept + SF2_SAMPLE_PADDING));
+            CHECK(sample->loop_start == sample->start + FIXTURE_KEYS_LOOP_START);
+            CHECK(sample->loop_end == sample->start + FIXTURE_KEYS_LOOP_END);
+            CHECK(same_points(&written, sample, s, kept));
+        }
+        const SF2Sample* pipe = &written.samples[FIXTURE_PIPE];
+        CHECK(report.samples[FIXTURE_PIPE].trimmed_points == 0);
+        CHECK(same_points(&written, pipe, FIXTURE_PIPE, FIXTURE_PIPE_POINTS));
+        CHECK(written.sf.smpl.size == (2 * kept + FIXTURE_PIPE_POINTS + 3 * SF2_SAMPLE_PADDING) * 2);
+    } else {
+        CHECK(written.sample_count == FIXTURE_SAMPLES);
+    }
+    free_written(&written, &report);
+}
+
+/* Resampling to half the rate halves the points and the loop positions, and is reported as lossy */
+static void test_rate(void) {
+    static const int organ[] = { 1 };
+    static const SF2WriteOptions half_rate = { 0, 0, FIXTURE_RATE / 2, 0 };
+    SF2WriteReport report;
+    Written written;
+    CHECK(write_subset(organ, 1, &half_rate, &report, &written) == 0);
+
+    if (written.sample_count == 1) {
+        const SF2Sample* pipe = &written.samples[0];
+        CHECK(pipe->rate == FIXTURE_RATE / 2);
+        CHECK(pipe->start == 0 && pipe->end == FIXTURE_PIPE_POINTS / 2);
+        CHECK(pipe->loop_start == FIXTURE_PIPE_LOOP_START / 2 && pipe->loop_end == FIXTURE_PIPE_LOOP_END / 2);
+        CHECK(report.samples[0].source_rate == FIXTURE_RATE && report.samples[0].rate == FIXTURE_RATE / 2);
+        CHECK(report.samples[0].lossy && report.samples[0].error_db < 0.0);
+        CHECK(report.samples[0].bytes == FIXTURE_PIPE_POINTS);
+    } else {
+        CHECK(written.sample_count == 1);
+    }
+    free_written(&written, &report);
+
+    // Samples at or below the target rate are copied unchanged
+    static const SF2WriteOptions same_rate = { 0, 0, FIXTURE_RATE, 0 };
+    CHECK(write_subset(organ, 1, &same_rate, &report, &written) == 0);
+    if (written.sample_count == 1) {
+        CHECK(written.samples[0].rate == FIXTURE_RATE && !report.samples[0].lossy);
+        CHECK(same_points(&written, &written.samples[0], FIXTURE_PIPE, FIXTURE_PIPE_POINTS));
+    }
+    free_written(&written, &report);
+}
+
+/* High holds the same data as Low, so with deduplication it points at Low's copy */
+static void test_dedup(void) {
+    static const int both[] = { 0, 1 };
+    static const SF2WriteOptions dedup = { 0, 0, 0, 1 };
+    SF2WriteReport report;
+    Written written;
+    CHECK(write_subset(both, 2, &dedup, &report, &written) == 0);
+    CHECK(report.sample_count == FIXTURE_SAMPLES && report.distinct_sample_count == 2);
+    CHECK(report.shared_bytes == FIXTURE_KEYS_POINTS * 2);
+
+    if (written.sample_count == FIXTURE_SAMPLES) {
+        const SF2Sample* low = &written.samples[FIXTURE_LOW];
+        const SF2Sample* high = &written.samples[FIXTURE_HIGH];
+        const SF2Sample* pipe = &written.samples[FIXTURE_PIPE];
+        CHECK(report.samples[FIXTURE_LOW].shared_with == -1);
+        CHECK(report.samples[FIXTURE_HIGH].shared_with == FIXTURE_LOW && report.samples[FIXTURE_HIGH].bytes == 0);
+        CHECK(report.samples[FIXTURE_PIPE].shared_with == -1);
+
+        // Each header keeps its own name and loop, over the one copy of the data
+        CHECK(!strcmp(high->name, "High"));
+        CHECK(high->start == low->start && high->end == low->end);
+        CHECK(high->loop_start == low->loop_start && high->loop_end == low->loop_end);
+        CHECK(same_points(&written, high, FIXTURE_HIGH, FIXTURE_KEYS_POINTS));
+        CHECK(pipe->start == FIXTURE_KEYS_POINTS + SF2_SAMPLE_PADDING);
+        CHECK(same_points(&written, pipe, FIXTURE_PIPE, FIXTURE_PIPE_POINTS));
+        CHECK(written.sf.smpl.size == (FIXTURE_KEYS_POINTS + FIXTURE_PIPE_POINTS + 2 * SF2_SAMPLE_PADDING) * 2);
+    } else {
+        CHECK(written.sample_count == FIXTURE_SAMPLES);
+    }
+    free_written(&written, &report);
+
+    // Both are trimmed the same way, so they still share once trimmed
+    static const SF2WriteOptions trim_dedup = { 1, 0, 0, 1 };
+    CHECK(write_subset(both, 2, &trim_dedup, &report, &written) == 0);
+    CHECK(report.distinct_sample_count == 2);
+    if (written.sample_count == FIXTURE_SAMPLES) {
+        CHECK(report.samples[FIXTURE_HIGH].shared_with == FIXTURE_LOW);
+        CHECK(written.samples[FIXTURE_HIGH].start == written.samples[FIXTURE_LOW].start);
+        CHECK(written.samples[FIXTURE_HIGH].end == FIXTURE_KEYS_LOOP_END + 8);
+    }
+    free_written(&written, &report);
+}
+
+int main(int argc, char** argv) {
+    const char* dir = argc > 1 ? argv[1] : ".";
+    snprintf(source_path, sizeof(source_path), "%s/writer_fixture.sf2", dir);
+    snprintf(output_path, sizeof(output_path), "%s/writer_output.sf2", dir);
+    if (fixture_write(source_path) != 0) {
+        fprintf(stderr, "Failed to write the test SoundFont '%s'\n", source_path);
+        return 1;
+    }
+
+    test_subset_one();
+    test_subset_keys();
+    test_trim();
+    test_rate();
+    test_dedup();
+
+    remove(output_path);
+    remove(source_path);
+    return test_result("sf2_writer");
+}